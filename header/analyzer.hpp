@@ -0,0 +1,110 @@
+#ifndef ANALYZER_HPP
+#define ANALYZER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "gameArchive.hpp"
+#include "move.hpp"
+
+struct AnalyzerConfig {
+  int workers = 1;               // concurrent analyses
+  int depth = 8;                 // search depth per position
+  int multiPV = 3;               // best lines kept per position (<= MAX_PV)
+  size_t queueCapacity = 256;    // waiting games; submit() fails beyond it
+  size_t cacheEntries = 1 << 16; // positions remembered across games
+  size_t keptResults = 1024;     // finished analyses kept for /analysis
+};
+
+// Engine view of one position; scores are centipawns for the side to move,
+// or +-(MATE_SCORE - plies) for mates.
+struct PositionAnalysis {
+  static constexpr int MAX_PV = 4;
+  struct Line {
+    Move move;
+    int16_t score = 0;
+  };
+  Line lines[MAX_PV];
+  uint8_t count = 0;   // 0: no legal move, score says mate or stalemate
+  int16_t score = 0;   // lines[0].score, or the game result when count is 0
+};
+
+enum MoveMark : uint8_t { MARK_NONE, MARK_INACCURACY, MARK_MISTAKE, MARK_BLUNDER };
+
+struct MoveAnnotation {
+  Move played;
+  PositionAnalysis before;   // the position the move was played in
+  int scorePlayed = 0;       // the played move, same side's view
+  int loss = 0;              // centipawns given away against the best line
+  MoveMark mark = MARK_NONE;
+};
+
+struct GameAnalysis {
+  uint64_t gameId = 0;
+  int depth = 0;
+  std::vector<MoveAnnotation> moves;
+  PositionAnalysis last;     // the position after the last move
+};
+
+// Annotates archived games in the background. Games wait in a bounded FIFO;
+// config.workers threads take them one at a time and run SCHED_IDLE (nice
+// 19 where that is not allowed), so they only get CPU no live game wants.
+// Each position is searched to config.depth for its config.multiPV best
+// lines (the second line is a search with the first move excluded, and so
+// on); results go into a direct-mapped cache keyed by position hash, so an
+// opening shared by many games is searched once.
+class Analyzer {
+  public:
+    enum State { UNKNOWN, QUEUED, RUNNING, DONE, FAILED };
+  private:
+    struct CacheEntry {
+      uint64_t key = 0;
+      uint8_t depth = 0;
+      uint8_t multiPV = 0;
+      PositionAnalysis analysis;
+    };
+    struct Job {
+      State state = QUEUED;
+      std::shared_ptr<const GameAnalysis> result;
+    };
+
+    const GameArchive& archive;
+    AnalyzerConfig config;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<uint64_t> queue;
+    std::unordered_map<uint64_t, Job> jobs;
+    std::deque<uint64_t> finished;   // oldest first, trimmed to keptResults
+    bool stopping = false;
+    std::mutex cacheMutex;
+    std::vector<CacheEntry> cache;
+    std::vector<std::thread> workers;
+
+    void workerLoop();
+    void finish(uint64_t id, State state, std::shared_ptr<const GameAnalysis> result);
+  public:
+    Analyzer(const GameArchive& archive, AnalyzerConfig config = AnalyzerConfig());
+    ~Analyzer();
+    Analyzer(const Analyzer&) = delete;
+    Analyzer& operator=(const Analyzer&) = delete;
+
+    // Queues an archived game; true if it is queued or has been analyzed
+    // already (or failed: the id is not in the archive), false if the queue
+    // is full.
+    bool submit(uint64_t gameId);
+    // fills result when DONE
+    State status(uint64_t gameId, std::shared_ptr<const GameAnalysis>& result);
+    size_t queued();
+
+    // Analyzes one game on the calling thread, sharing the position cache;
+    // false if it is not in the archive. Used by the workers.
+    bool analyze(uint64_t gameId, GameAnalysis& out);
+};
+
+#endif // ANALYZER_HPP
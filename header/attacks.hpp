@@ -0,0 +1,125 @@
+#ifndef ATTACKS_HPP
+#define ATTACKS_HPP
+
+#include "bitboard.hpp"
+
+// Attack tables computed by the compiler and emitted as read-only data, so
+// there is no initialization at startup. Sliders use per-direction rays cut
+// at the first blocker.
+namespace attacks {
+
+enum Direction {
+  NORTH, EAST, NORTH_EAST, NORTH_WEST, // towards higher square indices
+  SOUTH, WEST, SOUTH_WEST, SOUTH_EAST,
+  DIRECTIONS
+};
+
+constexpr int DIR_ROW[DIRECTIONS] = {1, 0, 1, 1, -1, 0, -1, -1};
+constexpr int DIR_COL[DIRECTIONS] = {0, 1, 1, -1, 0, -1, -1, 1};
+
+constexpr bool onBoard(int row, int col) {
+  return row >= 0 && row < 8 && col >= 0 && col < 8;
+}
+
+struct Tables {
+  Bitboard knight[64];
+  Bitboard king[64];
+  Bitboard pawn[2][64];              // [color][square], diagonal captures
+  Bitboard ray[DIRECTIONS][64];
+  Bitboard between[64][64];          // strictly between two aligned squares
+};
+
+constexpr Bitboard steps(int sq, const int (&deltas)[8][2]) {
+  Bitboard b = 0;
+  for (const auto& d : deltas)
+    if (onBoard(sq / 8 + d[0], sq % 8 + d[1]))
+      b |= squareBB(squareOf(sq / 8 + d[0], sq % 8 + d[1]));
+  return b;
+}
+
+constexpr Tables makeTables() {
+  constexpr int knightDeltas[8][2] = {{2, 1}, {1, 2}, {-1, 2}, {-2, 1}, {-2, -1}, {-1, -2}, {1, -2}, {2, -1}};
+  constexpr int kingDeltas[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+  Tables t{};
+  for (int sq = 0; sq < 64; sq++) {
+    int row = sq / 8, col = sq % 8;
+    t.knight[sq] = steps(sq, knightDeltas);
+    t.king[sq] = steps(sq, kingDeltas);
+    for (int side = 0; side < 2; side++) {
+      int r = row + (side == WHITE ? 1 : -1);
+      for (int dc = -1; dc <= 1; dc += 2)
+        if (onBoard(r, col + dc))
+          t.pawn[side][sq] |= squareBB(squareOf(r, col + dc));
+    }
+    for (int d = 0; d < DIRECTIONS; d++) {
+      Bitboard seen = 0;
+      for (int r = row + DIR_ROW[d], c = col + DIR_COL[d]; onBoard(r, c); r += DIR_ROW[d], c += DIR_COL[d]) {
+        t.between[sq][squareOf(r, c)] = seen;
+        seen |= squareBB(squareOf(r, c));
+      }
+      t.ray[d][sq] = seen;
+    }
+  }
+  return t;
+}
+
+inline constexpr Tables TABLES = makeTables();
+
+template <Direction D>
+inline Bitboard rayAttacks(int sq, Bitboard occupied) {
+  Bitboard ray = TABLES.ray[D][sq];
+  Bitboard blockers = ray & occupied;
+  if (blockers) {
+    int first = (D < SOUTH) ? lsb(blockers) : msb(blockers);
+    ray ^= TABLES.ray[D][first];
+  }
+  return ray;
+}
+
+} // namespace attacks
+
+inline Bitboard knightAttacks(int sq) {
+  return attacks::TABLES.knight[sq];
+}
+
+inline Bitboard kingAttacks(int sq) {
+  return attacks::TABLES.king[sq];
+}
+
+// diagonal captures of a pawn of the given color
+inline Bitboard pawnAttacks(PieceColor color, int sq) {
+  return attacks::TABLES.pawn[color][sq];
+}
+
+inline Bitboard bishopAttacks(int sq, Bitboard occupied) {
+  using namespace attacks;
+  return rayAttacks<NORTH_EAST>(sq, occupied) | rayAttacks<NORTH_WEST>(sq, occupied)
+       | rayAttacks<SOUTH_EAST>(sq, occupied) | rayAttacks<SOUTH_WEST>(sq, occupied);
+}
+
+inline Bitboard rookAttacks(int sq, Bitboard occupied) {
+  using namespace attacks;
+  return rayAttacks<NORTH>(sq, occupied) | rayAttacks<SOUTH>(sq, occupied)
+       | rayAttacks<EAST>(sq, occupied) | rayAttacks<WEST>(sq, occupied);
+}
+
+// squares strictly between a and b if they share a line, otherwise empty
+inline Bitboard betweenBB(int a, int b) {
+  return attacks::TABLES.between[a][b];
+}
+
+template <PieceType Pt>
+inline Bitboard attacksFrom(int sq, Bitboard occupied) {
+  if constexpr (Pt == KNIGHT)
+    return knightAttacks(sq);
+  else if constexpr (Pt == BISHOP)
+    return bishopAttacks(sq, occupied);
+  else if constexpr (Pt == ROOK)
+    return rookAttacks(sq, occupied);
+  else if constexpr (Pt == QUEEN)
+    return bishopAttacks(sq, occupied) | rookAttacks(sq, occupied);
+  else
+    return kingAttacks(sq);
+}
+
+#endif // ATTACKS_HPP
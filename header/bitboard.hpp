@@ -0,0 +1,51 @@
+#ifndef BITBOARD_HPP
+#define BITBOARD_HPP
+
+#include <cstdint>
+
+#include "piece.hpp"
+
+// One bit per square, square index = row * 8 + col (row 0 is White's back rank).
+using Bitboard = uint64_t;
+
+constexpr Bitboard FILE_A = 0x0101010101010101ULL; // col 0
+constexpr Bitboard FILE_H = FILE_A << 7;           // col 7
+
+constexpr int squareOf(int row, int col) {
+  return row * 8 + col;
+}
+
+constexpr Bitboard squareBB(int sq) {
+  return Bitboard(1) << sq;
+}
+
+// shifts every square by delta (row * 8 + col offset), dropping bits that
+// leave the board vertically; callers mask files for sideways steps
+template <int Delta>
+constexpr Bitboard shift(Bitboard b) {
+  return Delta > 0 ? b << Delta : b >> -Delta;
+}
+
+inline int lsb(Bitboard b) {
+  return __builtin_ctzll(b);
+}
+
+inline int msb(Bitboard b) {
+  return 63 ^ __builtin_clzll(b);
+}
+
+inline int popLsb(Bitboard& b) {
+  int sq = lsb(b);
+  b &= b - 1;
+  return sq;
+}
+
+inline int popCount(Bitboard b) {
+  return __builtin_popcountll(b);
+}
+
+constexpr bool moreThanOne(Bitboard b) {
+  return b & (b - 1);
+}
+
+#endif // BITBOARD_HPP
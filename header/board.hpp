@@ -3,7 +3,9 @@
 
 #include <vector>
 #include <algorithm>
+#include <cstdint>
 #include "piece.hpp"
+#include "bitboard.hpp"
 #include "bishop.hpp"
 #include "king.hpp"
 #include "knight.hpp"
@@ -11,14 +13,64 @@
 #include "queen.hpp"
 #include "rook.hpp"
 #include "power.hpp"
+#include "variant.hpp"
+#include "move.hpp"
 
+// Receives piece placement events so incremental state (e.g. an NNUE
+// accumulator) can follow the board without rescanning it.
+// hidden is true for RevealBoard pieces whose real type is still unknown.
+class BoardListener {
+  public:
+    virtual ~BoardListener() = default;
+    virtual void pieceAdded(PieceColor color, PieceType type, bool hidden, int row, int col) = 0;
+    virtual void pieceRemoved(PieceColor color, PieceType type, bool hidden, int row, int col) = 0;
+    // fromHidden means the move also reveals the piece
+    virtual void pieceMoved(PieceColor color, PieceType type, bool fromHidden,
+                            int srcRow, int srcCol, int dstRow, int dstCol) = 0;
+};
 
+// What Board::doMove changed, so undoMove can restore it exactly.
+// The captured piece stays alive (detached) until the move is undone.
+struct MoveUndo {
+  Piece* captured = nullptr;
+  bool moverUnmoved = false;
+  int rookFrom = -1;   // castling rook squares, -1 if not castling
+  int rookTo = -1;
+  bool rookUnmoved = false;
+};
+
+// Variant rules come from a compile-time policy (variant.hpp) chosen when the
+// board is built; nothing here is virtual. The *As<Variant> mutators let
+// callers that already know the variant (the engine search) skip the
+// dispatch, the plain ones pick the policy from the stored variant id.
 class Board {
   protected:
     // first row, second column
     Piece* chessBoard[8][8] = {nullptr}; 
+    BoardListener* listener = nullptr;
+    VariantId variant = STANDARD_VARIANT;
+    // derived from chessBoard, maintained incrementally by every placement change
+    struct Summary {
+      uint64_t hash = 0;
+      int pieceCounts[2][6] = {};
+      int bishopsOnSquareColor[2] = {}; // [dark, light], both sides together
+      Bitboard byColor[2] = {};
+      Bitboard byType[6] = {};          // by the type the piece moves as
+      Bitboard unmoved = 0;
+      Bitboard hidden = 0;
+      uint8_t movementType[64] = {};    // cached policy result per square
+    } summary;
+
+    template <class Variant> void trackAdd(int row, int col);
+    template <class Variant> void trackRemove(int row, int col);
+    template <class Variant> Piece* detach(int row, int col);
+    template <class Variant> void attach(Piece* piece, int row, int col);
+    // moves a piece back to an empty square, restoring its moved flag
+    template <class Variant> void moveBack(int row, int col, int toRow, int toCol, bool unmoved);
   public:
     Board();
+    // empty board following the given variant's rules
+    explicit Board(VariantId variant);
     Board(const Board& rhs);
     ~Board();
 
@@ -27,12 +79,24 @@ class Board {
 
     bool isOccupied(int row, int col) const;
     PieceColor getColor(int row, int col) const;
-    virtual PieceType getPieceType(int row, int col) const;
-    virtual Board* clone() const;
+    // the type the piece moves as under the board's variant
+    PieceType getPieceType(int row, int col) const;
+    Board* clone() const;
+    // true if the piece's real type is not yet visible to the players
+    bool isHidden(int row, int col) const;
+    VariantId getVariant() const;
     std::vector<Position> validMoves(int row, int col);
     std::vector<Position> generateMoves(int row, int col);
     void clearBoard();
     void addPiece(PieceType type, PieceColor color, int row, int col);
+    void removePiece(int row, int col);
+    template <class Variant> void addPieceAs(PieceType type, PieceColor color, int row, int col);
+    template <class Variant> void removePieceAs(int row, int col);
+    template <class Variant> void movePieceAs(int srcRow, int srcCol, int dstRow, int dstCol);
+    // Make/unmake for the engine search: a legal move (castling moves the
+    // rook too) that is taken back exactly, with no allocation either way.
+    template <class Variant> void doMove(Move move, MoveUndo& undo);
+    template <class Variant> void undoMove(Move move, const MoveUndo& undo);
     Piece* getPiece(int row, int col) const;
     Piece* makeNewPiece(PieceType type, PieceColor color);
     bool pieceMoved(int row, int col) const;
@@ -42,6 +106,22 @@ class Board {
     Position findKing(PieceColor color);
     // returns the PieceType for initial Board
     PieceType getInitialPieceType(int row, int col) const;
+    // Zobrist hash of the placement (side to move not included)
+    uint64_t hash() const;
+    // counts real piece types, including unrevealed ones
+    int pieceCount(PieceColor color, PieceType type) const;
+    // true if neither side can ever deliver mate (K v K, K+minor v K,
+    // or only bishops all on one square color)
+    bool insufficientMaterial() const;
+    // bitboards for the move generator; types are as returned by getPieceType
+    Bitboard pieces(PieceColor color) const;
+    Bitboard pieces(PieceColor color, PieceType type) const;
+    Bitboard occupied() const;
+    Bitboard unmovedPieces() const;
+    Bitboard hiddenPieces() const;
+    // listener is not owned and is not copied by clone()
+    void setListener(BoardListener* l);
+    BoardListener* getListener() const;
 };
 
 #endif // BOARD_HPP
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef BROADCASTER_HPP
+#define BROADCASTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// An immutable serialized message. Built once per state change and shared by
+// every connection it is queued on; nothing is copied per subscriber.
+using Frame = std::shared_ptr<const std::string>;
+
+inline Frame makeFrame(std::string bytes) {
+  return std::make_shared<const std::string>(std::move(bytes));
+}
+
+// Fans frames out to long-lived non-blocking sockets (Server-Sent Events).
+// A subscriber holds at most two frames: the one partly written to its
+// socket and the newest one published since. Anything in between is skipped,
+// so a slow reader sees fewer updates instead of growing memory, and a
+// publish costs one send() per subscriber regardless of their backlog.
+// Subscribers join one channel (e.g. a game room) and a publish reaches only
+// that channel.
+//
+// Single threaded: call from the thread running the event loop. Sockets are
+// expected to be registered edge-triggered for EPOLLOUT once; flush() is the
+// writable handler.
+class Broadcaster {
+  private:
+    struct Subscriber {
+      Frame current;
+      size_t offset = 0;
+      Frame next;
+      uint32_t channel = 0;
+      int slot = -1;   // index in its channel's fds, -1 when unused
+    };
+    std::vector<Subscriber> byFd;
+    std::unordered_map<uint32_t, std::vector<int>> channels;
+    size_t count = 0;
+
+    // false if the socket failed and was dropped
+    bool write(int fd, Subscriber& sub);
+  public:
+    // fd must already be non-blocking; it is owned (and closed) from now on
+    void subscribe(int fd, Frame initial, uint32_t channel = 0);
+    void unsubscribe(int fd);
+    bool has(int fd) const;
+    void publish(const Frame& frame, uint32_t channel = 0);
+    // socket became writable again
+    void flush(int fd);
+    size_t size() const;
+};
+
+#endif // BROADCASTER_HPP
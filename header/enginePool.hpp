@@ -0,0 +1,91 @@
+#ifndef ENGINEPOOL_HPP
+#define ENGINEPOOL_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "move.hpp"
+#include "search.hpp"
+
+struct Room;
+
+struct EngineConfig {
+  int threads = 2;          // engine moves and pondering share these
+  int ponderSlots = 1;      // threads that may ponder at once, fewer than threads
+  int ponderFactor = 4;     // a room ponders at most this many times its movetime...
+  int maxPonderMs = 10000;  // ...and never longer than this per human turn
+  int hashMegabytes = 8;    // transposition table per engine room
+  int nice = 5;             // for the pool's threads
+};
+
+// The engine side of a single player room. One search at a time; the table
+// lives as long as the room, so every search starts from what the previous
+// ones (pondering included) found.
+struct EngineSeat {
+  const PieceColor color;
+  const int movetime;       // ms per engine move
+  const int hashMegabytes;
+  std::mutex searchMutex;
+  Search search;
+  // guarded by searchMutex
+  Move predicted;           // the human reply the last search expects
+  uint64_t ponderedKey = 0; // position (Game::positionKey) the last ponder searched
+  std::vector<Move> ponderedPv;
+  int64_t ponderedMs = 0;
+
+  EngineSeat(PieceColor color, int movetime, int hashMegabytes)
+    : color(color), movetime(movetime), hashMegabytes(hashMegabytes), search(hashMegabytes) {}
+};
+
+// Plays the engine side of rooms with a seat. After an engine move the room
+// ponders on the human's time: it searches the position after the reply
+// its PV predicts or, without a prediction, the current position.
+// When the human moves, the ponder search is stopped and the engine move
+// is searched with the table it left:
+//  - on a predicted reply, the time already pondered counts against
+//    movetime, so the answer is often immediate;
+//  - otherwise the TT still holds the subtree of the move played.
+// CPU is capped twice: a room ponders at most ponderFactor * movetime
+// (maxPonderMs) per turn, and at most ponderSlots rooms ponder at once;
+// engine moves always go before pondering.
+class EnginePool {
+  public:
+    // called with the room locked after the engine moved
+    using Moved = std::function<void(Room&)>;
+  private:
+    struct Task {
+      std::shared_ptr<Room> room;
+      uint64_t revision;   // room.game's when queued; stale tasks are dropped
+    };
+    EngineConfig config;
+    Moved moved;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Task> moves;
+    std::deque<Task> ponders;
+    int pondering = 0;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+
+    void threadLoop();
+    void play(const Task& task);
+    void ponder(const Task& task);
+  public:
+    EnginePool(Moved moved, EngineConfig config = EngineConfig());
+    // waits for running searches (a ponder ends within maxPonderMs)
+    ~EnginePool();
+    EnginePool(const EnginePool&) = delete;
+    EnginePool& operator=(const EnginePool&) = delete;
+
+    // The engine is to move in room (with room.mutex held by the caller):
+    // stops the room's ponder search and queues the move.
+    void engineToMove(const std::shared_ptr<Room>& room);
+};
+
+#endif // ENGINEPOOL_HPP
@@ -0,0 +1,17 @@
+#ifndef EVAL_HPP
+#define EVAL_HPP
+
+#include "board.hpp"
+#include "evalWeights.hpp"
+#include "nnue.hpp"
+
+// Centipawn values for move ordering; the evaluation uses the tuned
+// EVAL_WEIGHTS of the board's variant.
+constexpr int PIECE_VALUE[6] = {100, 320, 330, 500, 900, 0};
+
+// Static evaluation in centipawns from side's point of view. Uses the NNUE
+// accumulator when a network is loaded and plain material otherwise.
+int evaluate(const Board& board, const nnue::Accumulator& acc, PieceColor side);
+int materialEvaluate(const Board& board, PieceColor side);
+
+#endif // EVAL_HPP
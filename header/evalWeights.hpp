@@ -0,0 +1,23 @@
+#ifndef EVALWEIGHTS_HPP
+#define EVALWEIGHTS_HPP
+
+// Material evaluation weights per variant (VariantId), in centipawns.
+// Written by eval_tuner tune, which rewrites the variant it tuned and
+// keeps the other.
+struct EvalWeights {
+  int piece[6];   // by PieceType, revealed pieces
+  int hidden;     // an unrevealed RevealBoard piece
+};
+
+constexpr EvalWeights EVAL_WEIGHTS[2] = {
+  {{100, 320, 330, 500, 900, 0}, 267},
+  {{100, 320, 330, 500, 900, 0}, 267},
+};
+
+// where each variant's weights came from
+constexpr const char* EVAL_WEIGHTS_SOURCE[2] = {
+  "hand-set",
+  "hand-set; hidden is the average of the 15 piece pool",
+};
+
+#endif // EVALWEIGHTS_HPP
@@ -0,0 +1,21 @@
+#ifndef FEN_HPP
+#define FEN_HPP
+
+#include <string>
+
+#include "board.hpp"
+
+constexpr const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// FEN piece letters are real types. FEN has no moved flags, so they are
+// derived: under the standard variant pawns on their start rank are unmoved
+// and kings/rooks are unmoved when a castling right needs them; under the
+// reveal variant every piece on its side's two home rows is unmoved (still
+// hidden), which lets a layout be passed as a FEN, and the castling field is
+// ignored. En passant does not exist here, that field is ignored too.
+// Returns nullptr with error set if the FEN is malformed.
+Board* boardFromFen(const std::string& fen, VariantId variant, PieceColor& turn,
+                    int& halfmoveClock, std::string& error);
+std::string boardToFen(const Board& board, PieceColor turn, int halfmoveClock, int fullmove);
+
+#endif // FEN_HPP
@@ -1,10 +1,13 @@
 #ifndef GAME_HPP
 #define GAME_HPP
 
+#include <cstdint>
 #include <vector>
 
+#include "move.hpp"
 #include "piece.hpp"
 #include "revealBoard.hpp"
+#include "positionHistory.hpp"
 
 enum GameState {
   INPROGRESS,
@@ -13,18 +16,89 @@ enum GameState {
   DRAW,
 };
 
+enum DrawReason {
+  NO_DRAW,
+  STALEMATE,
+  REPETITION,
+  FIFTY_MOVES,
+  INSUFFICIENT_MATERIAL,
+};
+
+// Played moves are kept as undo records (the move, what Board::doMove
+// changed, the position key and the game status around it), so taking a
+// move back or replaying it is one undoMove/doMove with no board copy.
+// A captured piece is owned by its record while the move is on the board.
 class Game {
   private:
+    struct Status {
+      GameState state;
+      DrawReason drawReason;
+      // plies since the last capture or pawn move
+      int halfmoveClock;
+    };
+    struct PlyRecord {
+      Move move;
+      MoveUndo undo;
+      uint64_t key;     // positionKey() after the move
+      Status before;
+      Status after;
+    };
     Board* board = nullptr;
     PieceColor currTurn;
     GameState state;
+    DrawReason drawReason = NO_DRAW;
+    int halfmoveClock = 0;
+    PositionHistory history;
+    uint64_t startKey;
+    std::vector<PlyRecord> records;   // [0, ply) played, [ply, size) undone
+    int ply = 0;
+    // moves before the position the game resumed from; counted, not undoable
+    std::vector<Move> earlier;
+    uint64_t revision = 0;
+
+    Status status() const;
+    void restore(const Status& s);
+    // drops the undone records, e.g. when a different move is played
+    void truncate();
+    // refills the repetition history from the records after undos emptied it
+    void refillHistory();
   public:
     Game(Board* board);
+    // resume a position set up elsewhere (e.g. from FEN)
+    Game(Board* board, PieceColor turn, int halfmoveClock);
+    // Resume a hibernated game (see PositionSnapshot): earlier are the moves
+    // that led to the position. A draw by repetition cannot be seen in the
+    // position, so drawReason carries it; other reasons are re-evaluated.
+    Game(Board* board, PieceColor turn, int halfmoveClock, std::vector<Move> earlier, DrawReason drawReason);
+    ~Game();
+    Game(const Game&) = delete;
+    Game& operator=(const Game&) = delete;
     PieceColor getCurrentTurn() const;
     Board* getBoard();
     GameState getGameState() const;
+    DrawReason getDrawReason() const;
+    bool isGameOver() const;
+    int getHalfmoveClock() const;
+    // hash of the board plus side to move
+    uint64_t positionKey() const;
+    // shared with the engine search so it sees repetitions of played positions
+    PositionHistory& getHistory();
     bool isMoveLegal(int srcRow, int srcCol, int dstRow, int dstCol);
     bool makeMove(int srcRow, int srcCol, int dstRow, int dstCol);
+    // Takes back / replays one ply, O(1); false at either end. A move made
+    // after undo() drops the plies that could have been redone.
+    bool undo();
+    bool redo();
+    // goes to the position after the given number of plies, up to getLength()
+    // and back to where the game resumed (0 unless it did)
+    bool jumpTo(int ply);
+    int getPly() const;
+    // plies recorded, including the ones redo() can replay
+    int getLength() const;
+    // the moves leading to the current position
+    std::vector<Move> getMoves() const;
+    // changes with every move, undo and redo
+    uint64_t getRevision() const;
     bool isCurrentPlayerPiece(int row, int col) const;
     void switchTurn();
     void evaluateGameState();
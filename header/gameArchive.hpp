@@ -0,0 +1,86 @@
+#ifndef GAMEARCHIVE_HPP
+#define GAMEARCHIVE_HPP
+
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "move.hpp"
+#include "revealBoard.hpp"
+#include "userStore.hpp"
+
+struct ArchivedGame {
+  std::string white;
+  std::string black;
+  int64_t finishedAt = 0;   // unix seconds
+  GameOutcome outcome = DRAWN;
+  RevealLayout layout;
+  std::vector<Move> moves;
+};
+
+// Finished games, compressed. A game is stored as its layout (each side's
+// arrangement index) and one symbol per ply: the played move's index in
+// the legal moves of the position, sorted by (from, to). Every symbol is
+// range coded against the exact number of choices, so a ply costs
+// log2(legal moves) bits (about 5) and a 1-move reply costs nothing.
+// Decoding replays the game with the legal move generator.
+//
+// File: append-only sequence of
+//   varint length, then: varint+bytes white, varint+bytes black,
+//   varint zigzag finishedAt, byte outcome, varint plies, range coded body
+// Game ids are positions in the file (0, 1, ...). open() reads only the
+// headers to rebuild the offset table and the per-user posting lists
+// (delta-coded game ids); read() costs one pread plus the replay. Only a
+// record cut short at the end of the file is truncated, its bytes kept in
+// "<path>.tail"; a corrupt one in the middle is reported and keeps its id,
+// but cannot be read.
+class GameArchive {
+  public:
+    struct Summary {
+      uint64_t id = 0;
+      std::string white;
+      std::string black;
+      int64_t finishedAt = 0;
+      GameOutcome outcome = DRAWN;
+      uint32_t plies = 0;
+    };
+  private:
+    struct Postings {
+      std::string deltas;   // varint gaps between ascending game ids
+      uint64_t last = 0;
+      uint32_t count = 0;
+    };
+    std::string path;
+    int fd = -1;
+    mutable std::shared_mutex mutex;
+    std::vector<uint64_t> offsets;   // by game id, then the end of the file
+    std::unordered_map<std::string, Postings> byUser;
+
+    void index(uint64_t id, const std::string& white, const std::string& black);
+    bool readRecord(uint64_t id, std::string& record) const;
+  public:
+    explicit GameArchive(std::string path);
+    ~GameArchive();
+    GameArchive(const GameArchive&) = delete;
+    GameArchive& operator=(const GameArchive&) = delete;
+
+    bool open(std::string& error);
+    // Checks the moves are legal from the layout, stores the game and
+    // returns its id; -1 if a move is illegal or the write failed.
+    int64_t append(const ArchivedGame& game);
+    bool read(uint64_t id, ArchivedGame& out) const;
+    bool summary(uint64_t id, Summary& out) const;
+    // the user's game ids below before, newest first
+    std::vector<uint64_t> gamesOf(std::string_view user, size_t count,
+                                  uint64_t before = UINT64_MAX) const;
+    size_t size() const;
+
+    // the codec, usable without a file
+    static bool encode(const ArchivedGame& game, std::string& record);
+    static bool decode(std::string_view record, ArchivedGame& out);
+};
+
+#endif // GAMEARCHIVE_HPP
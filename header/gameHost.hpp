@@ -0,0 +1,129 @@
+#ifndef GAMEHOST_HPP
+#define GAMEHOST_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "broadcaster.hpp"
+#include "enginePool.hpp"
+#include "game.hpp"
+#include "positionSnapshot.hpp"
+#include "revealBoard.hpp"
+
+// One game in progress. Everything but id, the player names, engine and
+// lastUsed is guarded by mutex.
+struct Room : std::enable_shared_from_this<Room> {
+  const uint32_t id;
+  // both "" in open rooms, where anyone may move for either side; in single
+  // player rooms the human's name ("" for a guest) and "engine"
+  const std::string white;
+  const std::string black;
+  // single player rooms only
+  const std::shared_ptr<EngineSeat> engine;
+  std::mutex mutex;
+  RevealBoard board;
+  Game game{&board};
+  Frame state;              // serialized board, shared with every stream
+  bool resultRecorded = false;
+  // steady clock ms of the last GameHost::find, for hibernation
+  std::atomic<int64_t> lastUsed{0};
+
+  Room(uint32_t id, std::string white, std::string black, std::shared_ptr<EngineSeat> engine = nullptr)
+    : id(id), white(std::move(white)), black(std::move(black)), engine(std::move(engine)) {}
+  // a hibernated room woken up: earlier are the moves that led to position
+  Room(uint32_t id, std::string white, std::string black, std::shared_ptr<EngineSeat> engine,
+       const RevealLayout& layout, const PositionSnapshot& position, std::vector<Move> earlier)
+    : id(id), white(std::move(white)), black(std::move(black)), engine(std::move(engine)),
+      board(layout, position),
+      game(&board, position.turn(), position.halfmoveClock, std::move(earlier), position.drawReason()) {}
+  bool open() const { return !engine && white.empty(); }
+};
+
+// All rooms of the process, by id. Lookups lock one of SHARDS maps, so
+// requests for different rooms rarely contend; a room is shared_ptr owned,
+// so a handler keeps using it even if it is removed meanwhile.
+//
+// When several processes serve the game (HttpServerConfig::shards), each
+// room belongs to the process shardOf its id names, and each process only
+// makes ids it owns, so ids stay unique across them.
+//
+// Rooms nobody has looked up for a while can be hibernated: the board and
+// game shrink to a PositionSnapshot plus the move list (2 bytes a ply, for
+// the archive), the engine seat's table is freed, and find() rebuilds the
+// room on its next request. Takebacks then reach back to that point only.
+// A room is only hibernated while nothing but the host holds it, so a
+// handler or an engine search never sees it change under it.
+class GameHost {
+  public:
+    // serializes a room's state; called with the room locked (or not yet shared)
+    using Renderer = std::function<Frame(Room&)>;
+  private:
+    static constexpr int SHARDS = 16;
+    struct Hibernated {
+      PositionSnapshot position;
+      uint64_t layout;              // RevealLayout::index()
+      std::vector<Move> moves;      // leading to position
+      std::string white;
+      std::string black;
+      // single player rooms: the seat to rebuild, with an empty table
+      bool engine;
+      PieceColor engineColor;
+      int movetime;
+      int hashMegabytes;
+      bool resultRecorded;
+    };
+    struct Shard {
+      std::mutex mutex;
+      std::unordered_map<uint32_t, std::shared_ptr<Room>> rooms;
+      std::unordered_map<uint32_t, Hibernated> hibernated;
+    };
+    Renderer render;
+    Shard shards[SHARDS];
+    const uint32_t processShard;
+    const uint32_t processShards;
+    std::atomic<uint32_t> nextId{0};
+    std::atomic<size_t> count{0};
+    std::mutex sweepMutex;
+    std::condition_variable sweepWake;
+    bool stopping = false;
+    std::thread sweeper;
+
+    static int64_t nowMs();
+    static Hibernated hibernate(Room& room);
+    std::shared_ptr<Room> wake(uint32_t id, Hibernated& h) const;
+  public:
+    explicit GameHost(Renderer render, uint32_t shard = 0, uint32_t shards = 1);
+    ~GameHost();
+    GameHost(const GameHost&) = delete;
+    GameHost& operator=(const GameHost&) = delete;
+
+    // the process (of shards) that owns room id
+    static uint32_t shardOf(uint32_t id, uint32_t shards);
+
+    // new room with a fresh board and its state already rendered; ids count
+    // up from 0, skipping those other processes own
+    std::shared_ptr<Room> create(std::string white = "", std::string black = "",
+                                 std::shared_ptr<EngineSeat> engine = nullptr);
+    // wakes the room if it was hibernated
+    std::shared_ptr<Room> find(uint32_t id);
+    bool remove(uint32_t id);
+    // rooms, hibernated ones included
+    size_t size() const;
+    // hibernates the rooms not found for idle; returns how many
+    size_t hibernateIdle(std::chrono::milliseconds idle);
+    // from now on does that on a thread every idle / 4
+    void hibernateAfter(std::chrono::milliseconds idle);
+    // after a move: re-render room.state (room must be locked)
+    void refresh(Room& room) const;
+};
+
+#endif // GAMEHOST_HPP
@@ -0,0 +1,108 @@
+#ifndef HTTPREQUEST_HPP
+#define HTTPREQUEST_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct HttpHeader {
+  std::string_view name;
+  std::string_view value;
+};
+
+// Incremental, allocation-free HTTP/1.x request parser. Every field is a
+// string_view into the caller's buffer, so the buffer must outlive the
+// request. Call parse() each time more bytes arrive, always with the same
+// buffer (grown, not moved) until it stops returning INCOMPLETE.
+//
+// Bodies may be sized by Content-Length or sent chunked; chunked bodies are
+// decoded in place, so the bytes behind the headers are rewritten. Requests
+// with both, with a malformed length or with more than MAX_HEADERS headers
+// are INVALID.
+class HttpRequest {
+  public:
+    static constexpr int MAX_HEADERS = 32;
+    enum Status {
+      INCOMPLETE,
+      COMPLETE,
+      INVALID,
+    };
+
+    std::string_view method;
+    std::string_view target;   // path plus "?query"
+    std::string_view path;
+    std::string_view query;    // without the '?', still percent-encoded
+    int minorVersion = 1;
+    HttpHeader headers[MAX_HEADERS];
+    int headerCount = 0;
+    std::string_view body;
+
+    Status parse(char* buffer, size_t length);
+    // first header with this name (case-insensitive), "" if absent
+    std::string_view header(std::string_view name) const;
+    // bytes of the buffer this request used, valid once COMPLETE
+    size_t consumed() const;
+    void reset();
+  private:
+    enum Stage {
+      HEAD,
+      FIXED_BODY,
+      CHUNK_SIZE,
+      CHUNK_DATA,
+      CHUNK_END,
+      TRAILERS,
+      DONE,
+    };
+    Stage stage = HEAD;
+    size_t scanned = 0;       // how far the blank line search got
+    size_t readPos = 0;       // next unparsed byte
+    size_t bodyStart = 0;
+    size_t bodyLength = 0;    // decoded so far
+    size_t contentLength = 0;
+    size_t chunkLeft = 0;
+
+    Status parseHead(char* buffer, size_t headEnd);
+    Status parseChunked(char* buffer, size_t length);
+};
+
+// Integer query parameter, decoded without allocating. False if key is
+// missing or its value is not a whole decimal int.
+bool queryInt(std::string_view query, std::string_view key, int& value);
+// raw (still encoded) value of key, "" if missing
+std::string_view queryValue(std::string_view query, std::string_view key);
+// percent and '+' decoded value of key, "" if missing; also reads
+// application/x-www-form-urlencoded bodies
+std::string queryText(std::string_view query, std::string_view key);
+
+// Method + path lookup over a handful of routes; a linear scan of
+// string_views is faster than hashing at this size and never allocates.
+// Paths match exactly, except that a trailing '*' matches any rest
+// ("/analysis/*"); routes are tried in the order they were added.
+template <class Handler>
+class Router {
+  private:
+    struct Route {
+      std::string_view method;
+      std::string_view path;
+      Handler handler;
+    };
+    std::vector<Route> routes;
+  public:
+    // method and path must outlive the router (string literals)
+    void add(std::string_view method, std::string_view path, Handler handler) {
+      routes.push_back(Route{method, path, handler});
+    }
+    const Handler* find(std::string_view method, std::string_view path) const {
+      for (const Route& r : routes) {
+        bool match = r.path == path ||
+          (!r.path.empty() && r.path.back() == '*' &&
+           path.substr(0, r.path.size() - 1) == r.path.substr(0, r.path.size() - 1));
+        if (match && r.method == method)
+          return &r.handler;
+      }
+      return nullptr;
+    }
+};
+
+#endif // HTTPREQUEST_HPP
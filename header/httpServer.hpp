@@ -0,0 +1,157 @@
+#ifndef HTTPSERVER_HPP
+#define HTTPSERVER_HPP
+
+#include <arpa/inet.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "broadcaster.hpp"
+#include "httpRequest.hpp"
+#include "metrics.hpp"
+#include "requestQueue.hpp"
+
+// Which thread runs a route's handler.
+enum Lane {
+  LANE_LOOP,     // the event loop itself; must not block (stream setup)
+  LANE_NORMAL,   // worker pool for ordinary requests
+  LANE_ENGINE,   // separate, lower priority workers for engine searches
+};
+
+struct HttpServerConfig {
+  int port = 8080;
+  int workers = 4;
+  int engineWorkers = 1;
+  size_t queueCapacity = 128;       // per worker
+  int latencyBudgetMs = 200;        // shed when the expected wait is longer
+  int engineLatencyBudgetMs = 5000;
+  // service time guesses used before the first requests complete
+  int expectedServiceMs = 1;
+  int engineExpectedServiceMs = 500;
+  int peerInFlight = 8;             // concurrent requests per client address
+  size_t requestBufferSize = 32768;
+  // Several processes may serve one port: shards of them, this being number
+  // shard (0 <= shard < shards). See HttpServer::placement.
+  int shard = 0;
+  int shards = 1;
+};
+
+// Event loop plus worker pools with admission control.
+//
+// The loop accepts and reads requests on non-blocking sockets, parsing as
+// bytes arrive, so slow clients cost nothing. A complete request is removed
+// from epoll (one request in flight per connection; the client's further
+// bytes wait in the kernel) and queued on the least loaded worker of its
+// lane. If no worker's expected wait fits the lane's latency budget, the
+// queue is full, or the client address already has peerInFlight requests
+// queued or running, it is answered 503 with Retry-After at once instead of
+// queueing into a timeout. Handlers run with a blocking socket.
+//
+// With shards > 1 every process listens with SO_REUSEPORT, so the kernel
+// spreads connections over them, and binds a Unix datagram socket in the
+// abstract namespace named after the port and its shard. A parsed request
+// that placement says belongs to another shard goes to that shard's socket,
+// raw bytes and connection fd (SCM_RIGHTS) together; the owner parses it
+// again and serves it as if it had accepted it. The socket has no file
+// permissions, so the owner checks each datagram's SO_PASSCRED credentials
+// and drops any not sent by its own uid. The owner's socket queue is
+// net.unix.max_dgram_qlen datagrams deep; when it is full, or the owner is
+// not running, the request is answered 503 with Retry-After.
+class HttpServer {
+  public:
+    // true if the handler kept the socket (e.g. made it a stream); the server
+    // closes it otherwise
+    using Handler = std::function<bool(int fd, const HttpRequest& request)>;
+    // the shard that must serve a request, or -1 for whichever has it; runs
+    // on the loop thread, so it must not block
+    using Placement = std::function<int(const HttpRequest& request)>;
+  private:
+    struct Route {
+      Lane lane;
+      Handler handler;
+      metrics::Histogram latency;
+    };
+    // a parsed request waiting for a worker; owns the bytes it points into
+    struct Job {
+      int fd = -1;
+      std::unique_ptr<char[]> buffer;
+      HttpRequest request;
+      const Route* route = nullptr;
+      uint32_t peer = 0;
+    };
+    struct Connection {
+      std::unique_ptr<char[]> buffer;
+      size_t length = 0;
+      HttpRequest request;
+      uint32_t peer = 0;
+    };
+    struct Worker {
+      RequestQueue<Job> queue;
+      std::thread thread;
+      const metrics::Gauge* depth = nullptr;
+      Worker(size_t capacity, std::chrono::microseconds expectedService)
+        : queue(capacity, expectedService) {}
+    };
+    static constexpr int PEER_SLOTS = 4096;
+
+    HttpServerConfig config;
+    Router<Route> routes;
+    std::unique_ptr<Route> fallbackRoute;
+    int ep = -1;
+    int listenFd = -1;
+    int wakeFd = -1;
+    int shardFd = -1;
+    Placement place;
+    std::vector<std::unique_ptr<Connection>> connections;   // by fd
+    Broadcaster spectators;
+    std::vector<std::unique_ptr<Worker>> normalWorkers;
+    std::vector<std::unique_ptr<Worker>> engineWorkers;
+    // hashed client address -> requests in flight; collisions only make the
+    // limit stricter
+    std::atomic<int> peerLoad[PEER_SLOTS] = {};
+    std::mutex postMutex;
+    std::vector<std::function<void()>> posted;
+
+    void startWorkers(std::vector<std::unique_ptr<Worker>>& pool, int count, int expectedServiceMs,
+                      bool lowPriority, const metrics::Gauge& depth);
+    void workerLoop(Worker& worker, bool lowPriority);
+    void acceptAll();
+    void readConnection(int fd);
+    void closeConnection(int fd);
+    bool bindShardSocket();
+    void handOver(int fd, Connection& conn, int owner);
+    void receiveHandovers();
+    void dispatch(int fd, Connection& conn, const Route& route);
+    void runPosted();
+    static int peerSlot(uint32_t peer);
+  public:
+    explicit HttpServer(const HttpServerConfig& config);
+    ~HttpServer();
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    // method and path must outlive the server (string literals)
+    void route(std::string_view method, std::string_view path, Lane lane, Handler handler);
+    // runs on LANE_NORMAL for requests no route matched; answers them itself
+    void fallback(Handler handler);
+    // with shards > 1: where each request is served (default: where it lands)
+    void placement(Placement placement);
+    // loop thread only: keeps fd open as an event stream on channel, starting
+    // with initial
+    void subscribe(int fd, Frame initial, uint32_t channel = 0);
+    // any thread: queues frame to every stream of channel, in call order
+    void publish(Frame frame, uint32_t channel = 0);
+    // any thread: runs fn on the loop thread soon
+    void post(std::function<void()> fn);
+    // binds and serves until the process ends; returns non-zero on setup failure
+    int run();
+};
+
+#endif // HTTPSERVER_HPP
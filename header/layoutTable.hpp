@@ -0,0 +1,68 @@
+#ifndef LAYOUTTABLE_HPP
+#define LAYOUTTABLE_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "revealBoard.hpp"
+
+// Fairness score of every one-side RevealLayout arrangement, indexed by
+// RevealLayout::rank: centipawns for White after a fixed-depth search of
+// the arrangement as White against sampled Black arrangements (see
+// layout_tool). The file is a 64 byte header ("LAYOUTTB", depth, opponents)
+// and an int16 per arrangement, 8 MB. It is also the scoring run's
+// checkpoint: entries not scored yet hold UNSCORED.
+//
+// Scores are read relative to the median, which carries White's tempo, so
+// one table judges an arrangement for either color (Black's squares are
+// White's mirrored).
+class LayoutTable {
+  public:
+    static constexpr int16_t UNSCORED = INT16_MIN;
+  private:
+    uint8_t* base = nullptr;
+    size_t length = 0;
+    int16_t* scores = nullptr;
+    int depth = 0;
+    int opponents = 0;
+    int center = 0;
+    int limit = 0;
+
+    bool map(const std::string& path, bool writable, std::string& error);
+  public:
+    LayoutTable() = default;
+    ~LayoutTable();
+    LayoutTable(const LayoutTable&) = delete;
+    LayoutTable& operator=(const LayoutTable&) = delete;
+
+    // read-only; every arrangement is fair until setLimit
+    bool open(const std::string& path, std::string& error);
+    // For layout_tool: maps the file writable, creating it all UNSCORED if
+    // it is missing. Fails if it was started with other settings.
+    bool openForScoring(const std::string& path, int depth, int opponents, std::string& error);
+    // flushes scores to disk, the checkpoint
+    bool sync();
+
+    int searchDepth() const { return depth; }
+    int opponentsPerLayout() const { return opponents; }
+    int16_t score(uint32_t rank) const { return scores[rank]; }
+    void set(uint32_t rank, int16_t score) { scores[rank] = score; }
+    // median of the scored arrangements, computed by open()
+    int median() const { return center; }
+
+    // Arrangements scoring more than maxCp from the median are unfair;
+    // 0 accepts all. Unscored ones are always accepted.
+    void setLimit(int maxCp) { limit = maxCp; }
+    bool fair(const PieceType side[RevealLayout::SQUARES]) const {
+      if (limit <= 0)
+        return true;
+      int s = scores[RevealLayout::rank(side)];
+      return s == UNSCORED || (s - center <= limit && center - s <= limit);
+    }
+
+    // the k-th sampled opponent of an arrangement, fixed so runs resume
+    // and repeat exactly
+    static uint32_t opponent(uint32_t rank, int k);
+};
+
+#endif // LAYOUTTABLE_HPP
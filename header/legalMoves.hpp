@@ -0,0 +1,27 @@
+#ifndef LEGALMOVES_HPP
+#define LEGALMOVES_HPP
+
+#include "board.hpp"
+#include "move.hpp"
+#include "moveGen.hpp"
+
+// Legal-only move generation for a side picked at runtime. Checkers, the
+// check evasion mask and pinned pieces are computed once in the constructor,
+// after which every emitted move is legal without making it on a board.
+// Piece types are the ones the board reports (an unmoved RevealBoard piece
+// moves as its initial square). Dispatches to generate<Color, GenType>.
+class LegalMoves {
+  private:
+    const Board& board;
+    PieceColor us;
+    CheckInfo info;
+  public:
+    LegalMoves(const Board& board, PieceColor side);
+    bool inCheck() const;
+    void generate(MoveList& list, GenType type = ALL) const;
+    // legal moves of the side's piece on sq
+    void generateFrom(int sq, MoveList& list) const;
+    bool hasLegalMove() const;
+};
+
+#endif // LEGALMOVES_HPP
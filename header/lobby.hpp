@@ -0,0 +1,108 @@
+#ifndef LOBBY_HPP
+#define LOBBY_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "piece.hpp"
+
+struct LobbyConfig {
+  int bucketWidth = 100;      // rating points per bucket
+  int buckets = 32;           // ratings past the last bucket share it
+  int initialWindow = 50;     // accepted rating difference on joining
+  int widenPerSecond = 25;    // window growth while waiting
+  int maxWindow = 400;
+  int sweepMs = 250;          // how often waiting players are re-matched
+};
+
+struct LobbyMatch {
+  uint32_t room = 0;
+  PieceColor color = WHITE;
+  std::string opponent;
+};
+
+// Matchmaking queue. Waiting players sit in rating buckets, each an ordered
+// map behind its own mutex. Joining locks only the buckets the window
+// covers (one or two), takes the nearest compatible player in O(log n) or
+// waits in its bucket. Every sweepMs a background thread pairs waiting
+// players whose windows have widened enough, one bucket neighbourhood at a
+// time; no lock spans the whole queue. Two players are compatible when
+// their difference fits both of their current windows.
+//
+// Matches are handed to the pair callback (which creates the room) outside
+// every bucket lock; the player who waited longer gets white.
+class Lobby {
+  public:
+    // creates a room for the pair and returns its id
+    using Pair = std::function<uint32_t(const std::string& white, const std::string& black)>;
+    enum State { IDLE, WAITING, MATCHED };
+  private:
+    using Clock = std::chrono::steady_clock;
+    struct Ticket {
+      std::string user;
+      int rating;
+      Clock::time_point since;
+    };
+    using Queue = std::multimap<int, Ticket>;
+    struct Bucket {
+      std::mutex mutex;
+      Queue byRating;
+    };
+    // where a waiting user's ticket is; bucket -1 while join() is running
+    struct Place {
+      int bucket = -1;
+      Queue::iterator ticket;
+    };
+    struct Found {
+      int bucket = -1;
+      Queue::iterator ticket;
+      int difference = 0;
+    };
+
+    LobbyConfig config;
+    Pair pair;
+    std::unique_ptr<Bucket[]> buckets;
+    std::mutex placesMutex;   // taken after bucket locks, never before
+    std::unordered_map<std::string, Place> places;
+    std::mutex matchesMutex;
+    std::unordered_map<std::string, LobbyMatch> matches;
+    std::mutex sweepMutex;
+    std::condition_variable sweepWake;
+    bool stopping = false;
+    std::thread sweeper;
+
+    int bucketOf(int rating) const;
+    int window(const Ticket& ticket, Clock::time_point now) const;
+    std::vector<std::unique_lock<std::mutex>> lockRange(int first, int last);
+    // nearest compatible ticket in buckets [first, last] (locked), skipping skip
+    Found nearest(int first, int last, const Ticket& ticket, int window, Clock::time_point now,
+                  const Ticket* skip);
+    void finish(const Ticket& a, const Ticket& b);
+    void sweepLoop();
+  public:
+    explicit Lobby(Pair pair, LobbyConfig config = LobbyConfig());
+    ~Lobby();
+    Lobby(const Lobby&) = delete;
+    Lobby& operator=(const Lobby&) = delete;
+
+    // false if user is already waiting
+    bool join(const std::string& user, int rating);
+    // false if user was not waiting
+    bool leave(const std::string& user);
+    // the user's last match stays readable until they join again
+    State poll(const std::string& user, LobbyMatch& match);
+    size_t waiting();
+    // one re-matching pass; normally run by the background thread
+    void sweep();
+};
+
+#endif // LOBBY_HPP
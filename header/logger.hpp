@@ -0,0 +1,14 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+// Asynchronous line logger for request paths. logLine() formats into a
+// stack buffer and appends it to an in-memory buffer under a short lock; a
+// background thread writes the buffer to stderr every few milliseconds, so
+// callers never wait on the terminal or a pipe. If the writer falls behind
+// by more than a megabyte, new lines are dropped (and counted) rather than
+// blocking. Lines longer than 1 KiB are truncated.
+void logLine(const char* format, ...) __attribute__((format(printf, 1, 2)));
+// blocks until everything logged so far is written
+void flushLog();
+
+#endif // LOGGER_HPP
@@ -0,0 +1,71 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Process wide metrics in Prometheus text format.
+//
+// Counters and histograms are sharded per thread: every thread writes only
+// its own shard with relaxed atomic stores (no locked instructions, no shared
+// cache lines), and render() sums the shards when /metrics is scraped.
+// Histograms are HDR style log-linear: 8 buckets per power of two, so any
+// recorded value is known to within 12.5% from 1 ns to hours.
+// Gauges are plain shared atomics; they change rarely.
+//
+// Metric objects are cheap handles meant to be created once (statics or
+// long-lived members). Each (name, labels) pair must be unique.
+namespace metrics {
+
+constexpr int MAX_COUNTERS = 64;
+constexpr int MAX_HISTOGRAMS = 64;
+constexpr int MAX_GAUGES = 32;
+
+class Counter {
+  private:
+    int id;
+  public:
+    // labels in Prometheus syntax without braces, e.g. "route=\"/move\""
+    Counter(const char* name, const char* help, const char* labels = "");
+    void add(uint64_t n = 1) const;
+};
+
+class Gauge {
+  private:
+    std::atomic<int64_t>* value;
+  public:
+    Gauge(const char* name, const char* help, const char* labels = "");
+    void set(int64_t v) const { value->store(v, std::memory_order_relaxed); }
+    void add(int64_t n) const { value->fetch_add(n, std::memory_order_relaxed); }
+};
+
+class Histogram {
+  private:
+    int id;
+  public:
+    Histogram(const char* name, const char* help, const char* labels = "");
+    void record(uint64_t nanos) const;
+};
+
+// records the lifetime of the scope into a histogram
+class ScopedTimer {
+  private:
+    const Histogram& histogram;
+    std::chrono::steady_clock::time_point start;
+  public:
+    explicit ScopedTimer(const Histogram& histogram)
+      : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+      histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    }
+};
+
+// text exposition of every registered metric
+std::string render();
+
+} // namespace metrics
+
+#endif // METRICS_HPP
@@ -0,0 +1,51 @@
+#ifndef MOVE_HPP
+#define MOVE_HPP
+
+#include <cstdint>
+
+#include "piece.hpp"
+
+// A move as from/to square indices (row * 8 + col). Castling is the king's
+// two square move, exactly as Game::makeMove receives it.
+struct Move {
+  uint8_t from = 0;
+  uint8_t to = 0;
+
+  Move() = default;
+  Move(int from, int to) : from(uint8_t(from)), to(uint8_t(to)) {}
+
+  Position src() const { return Position(from / 8, from % 8); }
+  Position dst() const { return Position(to / 8, to % 8); }
+
+  bool operator==(const Move& rhs) const {
+    return from == rhs.from && to == rhs.to;
+  }
+
+  bool operator!=(const Move& rhs) const {
+    return !(*this == rhs);
+  }
+};
+
+// Fixed capacity move buffer, no heap allocation.
+struct MoveList {
+  static constexpr int CAPACITY = 256;
+  Move moves[CAPACITY];
+  int count = 0;
+
+  void add(int from, int to) { moves[count++] = Move(from, to); }
+  int size() const { return count; }
+  bool empty() const { return count == 0; }
+  Move* begin() { return moves; }
+  Move* end() { return moves + count; }
+  const Move* begin() const { return moves; }
+  const Move* end() const { return moves + count; }
+  const Move& operator[](int i) const { return moves[i]; }
+  bool contains(const Move& m) const {
+    for (int i = 0; i < count; i++)
+      if (moves[i] == m)
+        return true;
+    return false;
+  }
+};
+
+#endif // MOVE_HPP
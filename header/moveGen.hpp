@@ -0,0 +1,52 @@
+#ifndef MOVEGEN_HPP
+#define MOVEGEN_HPP
+
+#include "attacks.hpp"
+#include "board.hpp"
+#include "move.hpp"
+
+// Compile-time specialized legal move generation. Instantiated per side and
+// generation type so side dependent constants (push direction, capture
+// shifts, file masks) fold into the code.
+enum GenType {
+  CAPTURES,  // legal captures
+  QUIETS,    // legal non-captures, castling included
+  EVASIONS,  // legal moves while in check (nothing when not in check)
+  ALL,       // every legal move
+};
+
+// Everything about the side to move's king, computed once per position.
+struct CheckInfo {
+  int kingSq = -1;
+  Bitboard checkers = 0;
+  // squares a non-king move must land on (all squares when not in check)
+  Bitboard checkMask = ~Bitboard(0);
+  Bitboard pinned = 0;
+  // squares attacked by the opponent, with our king lifted off the board
+  Bitboard enemyAttacks = 0;
+  // for each pinned piece, the line it may still move along
+  Bitboard pinLine[64];
+};
+
+template <PieceColor Us>
+CheckInfo computeCheckInfo(const Board& board);
+
+template <PieceColor Us, GenType Type>
+void generate(const Board& board, const CheckInfo& info, MoveList& list);
+
+// every legal move of Us's piece on sq, and nothing else
+template <PieceColor Us>
+void generateFrom(const Board& board, const CheckInfo& info, int sq, MoveList& list);
+
+// pieces of color by that attack sq given the occupancy occ
+inline Bitboard attackersTo(const Board& board, int sq, PieceColor by, Bitboard occ) {
+  PieceColor other = (by == WHITE) ? BLACK : WHITE;
+  Bitboard queens = board.pieces(by, QUEEN);
+  return (pawnAttacks(other, sq) & board.pieces(by, PAWN))
+       | (knightAttacks(sq) & board.pieces(by, KNIGHT))
+       | (kingAttacks(sq) & board.pieces(by, KING))
+       | (bishopAttacks(sq, occ) & (board.pieces(by, BISHOP) | queens))
+       | (rookAttacks(sq, occ) & (board.pieces(by, ROOK) | queens));
+}
+
+#endif // MOVEGEN_HPP
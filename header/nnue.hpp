@@ -0,0 +1,61 @@
+#ifndef NNUE_HPP
+#define NNUE_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "board.hpp"
+
+// Efficiently updatable neural network evaluation.
+//
+// Architecture: (2 x 896 features) -> 2 x 256 accumulator -> clipped ReLU -> 1.
+// A feature is (own/their piece, kind, square) seen from one side's
+// perspective; kind is the piece type, or HIDDEN_KIND for RevealBoard pieces
+// that have not moved yet. Black's perspective mirrors the board vertically.
+//
+// Weight file layout (little endian):
+//   char[4] "RVNN", uint32 version, uint32 features, uint32 hidden
+//   int16 ftBias[hidden], int16 ftWeights[features][hidden]
+//   int8 outWeights[2 * hidden], int32 outBias
+namespace nnue {
+
+constexpr int HIDDEN_KIND = 6;
+constexpr int KINDS = 7;
+constexpr int FEATURES = 2 * KINDS * 64;
+constexpr int HIDDEN = 256;
+constexpr uint32_t FILE_VERSION = 1;
+
+// quantization: accumulator is clipped to [0, ACTIVATION_MAX], output weights
+// are scaled by WEIGHT_SCALE and the result maps to centipawns by EVAL_SCALE
+constexpr int ACTIVATION_MAX = 127;
+constexpr int WEIGHT_SCALE = 64;
+constexpr int EVAL_SCALE = 400;
+
+int featureIndex(PieceColor perspective, PieceColor color, int kind, int row, int col);
+
+// Loads weights into the process wide network. Returns false and keeps the
+// previous network if the file is missing or malformed.
+bool loadNetwork(const std::string& path);
+bool networkLoaded();
+// name of the kernel set picked for this CPU ("avx2", "sse2" or "scalar")
+const char* simdName();
+
+class Accumulator : public BoardListener {
+  private:
+    // indexed by perspective
+    alignas(64) int16_t values[2][HIDDEN];
+  public:
+    Accumulator();
+    // recompute from scratch, used when attaching to a board
+    void refresh(const Board& board);
+    void pieceAdded(PieceColor color, PieceType type, bool hidden, int row, int col) override;
+    void pieceRemoved(PieceColor color, PieceType type, bool hidden, int row, int col) override;
+    void pieceMoved(PieceColor color, PieceType type, bool fromHidden,
+                    int srcRow, int srcCol, int dstRow, int dstCol) override;
+    // centipawns from side's point of view
+    int evaluate(PieceColor side) const;
+};
+
+} // namespace nnue
+
+#endif // NNUE_HPP
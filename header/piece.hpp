@@ -1,6 +1,7 @@
 #ifndef PIECE_HPP
 #define PIECE_HPP
 
+#include <cstddef>
 #include <vector>
 
 class Board;
@@ -45,10 +46,17 @@ class Piece {
     Piece(PieceType type, PieceColor color);
     Piece(PieceType type, PieceColor color, bool moved);
     virtual ~Piece() = default;
+    // Every piece type has the same size, so freed pieces are kept on a
+    // per-thread free list and reused: boards are built and cloned without
+    // touching the heap once a thread has freed a board's worth.
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p, std::size_t size);
     PieceType getType() const;
     PieceColor getColor() const;
     bool getMoved() const;
     void setMoved();
+    // only for taking a move back
+    void resetMoved();
     bool getAlive() const;
     void setAlive();
     //Position getPosition() const;
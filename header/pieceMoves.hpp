@@ -10,13 +10,16 @@ class PieceMoves {
     Board* board;
   public:
   PieceMoves(Board* board);
-  // generate valid moves
+  // generate valid moves (legal only, see LegalMoves)
   std::vector<Position> validMoves(int row, int col);
   // generate moves according to the coordinate
   std::vector<Position> generateMoves(int row, int col);
-  // Removes all moves from moves causing the king to be in check
+  // Removes all moves from moves causing the king to be in check.
+  // Slow make/test reference for LegalMoves, not used on the hot path.
   void validateMoves(int row, int col, std::vector<Position>& moves);
 
+  // Pseudo-legal moves from the attack tables. The hot path uses
+  // generate<Color, GenType> (moveGen.hpp) instead.
   std::vector<Position> bishopMoves(int row, int col);
   std::vector<Position> kingMoves(int row, int col);
   std::vector<Position> knightMoves(int row, int col);
@@ -24,9 +27,7 @@ class PieceMoves {
   std::vector<Position> queenMoves(int row, int col);
   std::vector<Position> rookMoves(int row, int col);
 
-  // If return true, this move involves capturing piece. 
-  // Otherwise, just check if the position is available to move.
-  bool checkMove(int row, int col, PieceColor color, std::vector<Position>& moves); 
+  static std::vector<Position> toPositions(Bitboard targets);
 };
 
 
@@ -0,0 +1,43 @@
+#ifndef POSITIONHISTORY_HPP
+#define POSITIONHISTORY_HPP
+
+#include <cstdint>
+
+// Ring buffer of the most recent position hashes plus an occurrence count
+// per hash, so pushing a position and asking how often it occurred are both
+// O(1). Game records every played position here and the engine search pushes
+// and pops its own line on top of the same object.
+//
+// Positions before a capture, pawn move or a piece's first move can never
+// recur (the hash covers material and unmoved pieces), so nothing has to be
+// cleared on irreversible moves; the ring only needs to cover the fifty move
+// window plus the deepest search line.
+class PositionHistory {
+  public:
+    static constexpr int CAPACITY = 256;
+  private:
+    static constexpr int TABLE_SIZE = 1024;
+    struct Slot {
+      uint64_t key;
+      uint32_t count;
+    };
+    uint64_t ring[CAPACITY];
+    int head = 0;   // index of the next write
+    int size = 0;
+    Slot table[TABLE_SIZE] = {};
+
+    int findSlot(uint64_t key) const;
+    void increment(uint64_t key);
+    void decrement(uint64_t key);
+  public:
+    PositionHistory();
+    void clear();
+    // records key and returns how many times it has now occurred
+    int push(uint64_t key);
+    // forgets the most recent push
+    void pop();
+    int count(uint64_t key) const;
+    int length() const;
+};
+
+#endif // POSITIONHISTORY_HPP
@@ -0,0 +1,38 @@
+#ifndef POSITIONSNAPSHOT_HPP
+#define POSITIONSNAPSHOT_HPP
+
+#include <cstdint>
+
+#include "board.hpp"
+#include "game.hpp"
+
+// A game's current position in 40 bytes, for rooms GameHost hibernates:
+// placement, which pieces are still unmoved (in a RevealBoard, the hidden
+// ones and the kings that may castle), side to move, clocks and the
+// position key to check the rebuilt board against. Undo records and the
+// repetition history are not kept.
+struct PositionSnapshot {
+  Bitboard occupied = 0;
+  uint64_t key = 0;            // Game::positionKey()
+  // 4 bits per occupied square in square order: color << 3 | real type
+  uint8_t pieces[16] = {};
+  // over the 32 start squares (rows 0, 1, 6 and 7); no other square can
+  // hold an unmoved piece
+  uint32_t unmoved = 0;
+  uint16_t ply = 0;
+  uint8_t halfmoveClock = 0;
+  uint8_t flags = 0;
+
+  static constexpr uint8_t BLACK_TO_MOVE = 1;
+  static constexpr uint8_t REPETITION_DRAW = 2;
+
+  static PositionSnapshot capture(const Board& board, const Game& game);
+  // places the pieces on board, which must be empty
+  void restore(Board& board) const;
+  PieceColor turn() const { return (flags & BLACK_TO_MOVE) ? BLACK : WHITE; }
+  DrawReason drawReason() const { return (flags & REPETITION_DRAW) ? REPETITION : NO_DRAW; }
+};
+
+static_assert(sizeof(PositionSnapshot) == 40, "PositionSnapshot is meant to be 40 bytes");
+
+#endif // POSITIONSNAPSHOT_HPP
@@ -0,0 +1,68 @@
+#ifndef PUZZLEDB_HPP
+#define PUZZLEDB_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "board.hpp"
+#include "move.hpp"
+
+// One puzzle as a fixed-size record, usable straight from the mapped file.
+// The side to move plays solution[0], [2], ...; the opponent's replies are
+// the odd plies. mateIn > 0: the line mates in that many moves.
+struct PuzzleRecord {
+  static constexpr int MAX_PLIES = 9;
+  enum Flags : uint8_t { WHITE_TO_MOVE = 1, REVEAL = 2 };
+
+  uint8_t squares[32];      // a nibble per square, even squares low: 0 empty, 1 + type, +8 white
+  uint64_t unmoved;         // Board::unmovedPieces()
+  uint16_t rating;
+  uint8_t flags;
+  uint8_t mateIn;
+  uint8_t plies;
+  uint8_t reserved;
+  Move solution[MAX_PLIES];
+
+  PieceColor turn() const { return (flags & WHITE_TO_MOVE) ? WHITE : BLACK; }
+  VariantId variant() const { return (flags & REVEAL) ? REVEAL_VARIANT : STANDARD_VARIANT; }
+  // a new board in the puzzle's starting position
+  Board* board() const;
+  static PuzzleRecord fromBoard(const Board& board, PieceColor turn);
+};
+static_assert(sizeof(PuzzleRecord) == 64, "puzzle records are one cache line");
+static_assert(std::is_trivially_copyable<PuzzleRecord>::value, "puzzle records are read in place");
+
+// Parses a Lichess puzzle CSV line
+//   PuzzleId,FEN,Moves,Rating,RatingDeviation,Popularity,NbPlays,Themes,...
+// where the first move is the opponent's and the puzzle starts after it.
+// Fails for lines these rules cannot play (promotions, en passant) or whose
+// solution is longer than MAX_PLIES.
+bool puzzleFromCsv(const std::string& line, PuzzleRecord& out, std::string& error);
+
+// Read-only puzzle file, mapped once: a 64 byte header ("PUZZLEDB", record
+// size, count) followed by the records. Lookups are pointer arithmetic, so
+// serving a puzzle never parses text.
+class PuzzleDb {
+  private:
+    const uint8_t* base = nullptr;
+    size_t length = 0;
+    const PuzzleRecord* records = nullptr;
+    size_t count = 0;
+  public:
+    PuzzleDb() = default;
+    ~PuzzleDb();
+    PuzzleDb(const PuzzleDb&) = delete;
+    PuzzleDb& operator=(const PuzzleDb&) = delete;
+
+    bool open(const std::string& path, std::string& error);
+    size_t size() const { return count; }
+    const PuzzleRecord& operator[](size_t i) const { return records[i]; }
+
+    static bool write(const std::string& path, const std::vector<PuzzleRecord>& puzzles,
+                      std::string& error);
+};
+
+#endif // PUZZLEDB_HPP
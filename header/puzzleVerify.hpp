@@ -0,0 +1,29 @@
+#ifndef PUZZLEVERIFY_HPP
+#define PUZZLEVERIFY_HPP
+
+#include <string>
+
+#include "board.hpp"
+#include "move.hpp"
+#include "puzzleDb.hpp"
+#include "search.hpp"
+
+// Legal moves for side that force mate within n moves (n >= 1), counted up
+// to limit. An exact AND/OR proof over every reply, so it is meant for the
+// short mates puzzles have; board is left as it was.
+int countMatingMoves(Board& board, PieceColor side, int n, int limit, MoveList* found = nullptr);
+
+// Replays the solution and checks that the puzzle is sound:
+//  - every move is legal and the line ends on the solver's move;
+//  - mateIn > 0: the line is 2 * mateIn - 1 plies, it ends in mate, and at
+//    every solver ply but the last the played move is the only one that
+//    mates in time (any mate is accepted on the last ply);
+//  - mateIn == 0: a depth-limited search picks the played move at every
+//    solver ply.
+// On failure why says which ply and why.
+bool verifyPuzzle(const PuzzleRecord& puzzle, Search& search, int depth, std::string& why);
+
+// true if move is an acceptable answer at ply (an even ply) of the solution
+bool acceptsMove(const PuzzleRecord& puzzle, int ply, Move move);
+
+#endif // PUZZLEVERIFY_HPP
@@ -0,0 +1,77 @@
+#ifndef REQUESTQUEUE_HPP
+#define REQUESTQUEUE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// Bounded FIFO between the event loop and one worker, with an estimate of
+// how long a newly queued item would wait: queued items times a moving
+// average of the service time. The producer uses the estimate to shed load
+// before the queue turns into latency.
+template <class T>
+class RequestQueue {
+  private:
+    mutable std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+    // exponentially weighted service time, microseconds
+    double serviceMicros;
+  public:
+    // expectedService seeds the estimate until real samples come in
+    RequestQueue(size_t capacity, std::chrono::microseconds expectedService)
+      : capacity(capacity), serviceMicros(double(expectedService.count())) {}
+
+    // false if full or closed; item is left untouched then
+    bool tryPush(T& item) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed || items.size() >= capacity)
+          return false;
+        items.push_back(std::move(item));
+      }
+      ready.notify_one();
+      return true;
+    }
+
+    // blocks; false once closed and drained
+    bool pop(T& out) {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [this] { return closed || !items.empty(); });
+      if (items.empty())
+        return false;
+      out = std::move(items.front());
+      items.pop_front();
+      return true;
+    }
+
+    void recordService(std::chrono::microseconds took) {
+      std::lock_guard<std::mutex> lock(mutex);
+      serviceMicros += (double(took.count()) - serviceMicros) / 4;
+    }
+
+    // expected queueing delay for an item pushed now (the one in service included)
+    std::chrono::microseconds estimatedWait() const {
+      std::lock_guard<std::mutex> lock(mutex);
+      return std::chrono::microseconds(int64_t(serviceMicros * (items.size() + 1)));
+    }
+
+    size_t size() const {
+      std::lock_guard<std::mutex> lock(mutex);
+      return items.size();
+    }
+
+    void close() {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+      }
+      ready.notify_all();
+    }
+};
+
+#endif // REQUESTQUEUE_HPP
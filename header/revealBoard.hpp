@@ -1,14 +1,61 @@
 #ifndef REVEALBOARD_HPP
 #define REVEALBOARD_HPP
 
+#include <cstdint>
+
 #include "../header/board.hpp"
 
+class LayoutTable;
+struct PositionSnapshot;
+
+// The shuffled back two rows of both sides, kings excluded (they stay on
+// e1/e8). Squares in order a1..h1 (skipping e1), a2..h2 for white and
+// a8..h8 (skipping e8), a7..h7 for black.
+struct RevealLayout {
+  static constexpr int SQUARES = 15;
+  PieceType white[SQUARES];
+  PieceType black[SQUARES];
+
+  // Index of one side's arrangement among the 4,054,050 distinct ones
+  // (permutations of Q R R B B N N + 8 pawns), and back.
+  static uint32_t rank(const PieceType side[SQUARES]);
+  static void unrank(uint32_t index, PieceType side[SQUARES]);
+  static constexpr uint32_t ARRANGEMENTS = 4054050;
+
+  // Both sides as one integer (white rank * ARRANGEMENTS + black rank), for
+  // logs and replays, and back; index must be below LAYOUTS.
+  static constexpr uint64_t LAYOUTS = uint64_t(ARRANGEMENTS) * ARRANGEMENTS;
+  uint64_t index() const;
+  static RevealLayout fromIndex(uint64_t index);
+  // Fisher-Yates over both sides with Xoshiro256(seed); no allocation.
+  static RevealLayout fromSeed(uint64_t seed);
+  // the same, reshuffling a side the table finds unfair (up to 64 times)
+  static RevealLayout fromSeed(uint64_t seed, const LayoutTable& fair);
+  // a seed from a per-thread generator seeded once from the OS
+  static uint64_t randomSeed();
+};
+
+// Board following RevealVariant rules with a shuffled back two rows. The
+// rules travel with the variant id, so clone() gives a plain Board. Hold a
+// RevealBoard by value; ~Board is not virtual, so owning one through a
+// Board* must go through clone().
 class RevealBoard : public Board {
+  private:
+    RevealLayout initial;
+    void place();
   public:
+    // random layout, RevealLayout::fromSeed(RevealLayout::randomSeed()),
+    // limited to the fair ones once a table is installed
     RevealBoard();
-    PieceType getPieceType(int row, int col) const override;
-    Board* clone() const override;
+    explicit RevealBoard(uint64_t seed);
+    explicit RevealBoard(const RevealLayout& layout);
+    // a game from layout resumed at position (defined with PositionSnapshot)
+    RevealBoard(const RevealLayout& layout, const PositionSnapshot& position);
+    // the layout the game started from
+    const RevealLayout& layout() const { return initial; }
+    // for RevealBoard(); not owned, must outlive every later construction
+    static void setLayoutTable(const LayoutTable* fair);
 };
 
 
-#endif // REVEALBOARD_HPP
\ No newline at end of file
+#endif // REVEALBOARD_HPP
@@ -0,0 +1,104 @@
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "board.hpp"
+#include "move.hpp"
+#include "moveGen.hpp"
+#include "nnue.hpp"
+#include "positionHistory.hpp"
+
+constexpr int MATE_SCORE = 32000;
+constexpr int MAX_PLY = 64;
+
+// What the caller allows the search to spend. Zero means "no limit" for every
+// field; with nothing set the search runs until stop().
+struct SearchLimits {
+  int depth = 0;
+  uint64_t nodes = 0;
+  int movetime = 0;       // ms for this move
+  int time[2] = {0, 0};   // remaining clock in ms, by color
+  int inc[2] = {0, 0};
+  int movesToGo = 0;
+  bool infinite = false;
+  // root moves not to search; with the best move excluded the result is the
+  // second best line, and so on (multi-PV)
+  std::vector<Move> excluded;
+};
+
+// Sent after every completed iteration.
+struct SearchReport {
+  int depth = 0;
+  int score = 0;          // centipawns, or +-(MATE_SCORE - plies) for mates
+  uint64_t nodes = 0;
+  int64_t ms = 0;
+  std::vector<Move> pv;
+};
+
+// Iterative deepening alpha-beta: principal variation search with null move
+// pruning and late move reductions, quiescence search on captures, a
+// transposition table and killer/history move ordering. Runs on the caller's
+// board through Board::doMove/undoMove, specialised per variant and side, and
+// leaves board and history exactly as it found them.
+// One search at a time; stop() may be called from any thread.
+class Search {
+  private:
+    struct TTEntry {
+      uint64_t key = 0;
+      int16_t score = 0;
+      Move move;
+      int8_t depth = 0;
+      uint8_t bound = 0;
+    };
+    std::vector<TTEntry> table;
+    uint64_t tableMask = 0;
+    std::atomic<bool> stopFlag{false};
+    std::atomic<uint64_t> nodeCount{0};
+
+    // state of the running search
+    Board* board = nullptr;
+    PositionHistory* history = nullptr;
+    nnue::Accumulator acc;
+    uint64_t nodes = 0;
+    uint64_t nodeLimit = 0;
+    int64_t hardLimitMs = 0;
+    std::chrono::steady_clock::time_point startTime;
+    bool stopped = false;
+    Move pv[MAX_PLY + 1][MAX_PLY + 1];
+    int pvLength[MAX_PLY + 1];
+    Move killers[MAX_PLY + 1][2];
+    int historyScore[64][64];
+    int clock[MAX_PLY + 2];   // halfmove clock per ply
+    MoveList excluded;
+
+    int64_t elapsedMs() const;
+    bool checkStop();
+    template <PieceColor Us> uint64_t positionKey() const;
+    template <PieceColor Us> void scoreMoves(const MoveList& list, int* scores, Move ttMove, int ply) const;
+    template <class Variant, PieceColor Us> int negamax(int depth, int alpha, int beta, int ply, bool allowNull);
+    template <class Variant, PieceColor Us> int quiesce(int alpha, int beta, int ply);
+    template <class Variant, PieceColor Us> int iterate(int depth, int alpha, int beta);
+  public:
+    explicit Search(int hashMegabytes = 16);
+    // drops the table contents
+    void resize(int hashMegabytes);
+    void clear();
+    // Blocking; report is called from the searching thread. Returns the best
+    // move found, or a null Move (from == to) if side has no legal move that
+    // is not excluded.
+    Move run(Board& board, PieceColor side, int halfmoveClock, PositionHistory& history,
+             const SearchLimits& limits, const std::function<void(const SearchReport&)>& report);
+    void stop();
+    // Re-arms after a stop(). Call from the controlling thread before handing
+    // run() to a worker, so a stop() that races the worker's start is kept.
+    void clearStop();
+    // nodes of the current or last search, readable while it runs
+    uint64_t nodesSearched() const;
+};
+
+#endif // SEARCH_HPP
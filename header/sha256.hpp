@@ -0,0 +1,21 @@
+#ifndef SHA256_HPP
+#define SHA256_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// SHA-256 (FIPS 180-4), for what must not be stored in the clear, such as
+// session tokens. Not constant time in the message length.
+namespace sha256 {
+
+void digest(std::string_view data, uint8_t out[32]);
+// PBKDF2-HMAC-SHA256 (RFC 8018), one 32-byte block; slow on purpose, for
+// passwords. Costs two compressions per iteration.
+void pbkdf2(std::string_view password, std::string_view salt, uint32_t iterations, uint8_t out[32]);
+// lowercase hex, 64 characters
+std::string hex(std::string_view data);
+
+}
+
+#endif // SHA256_HPP
@@ -0,0 +1,50 @@
+#ifndef STATICFILES_HPP
+#define STATICFILES_HPP
+
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+
+// Serves a directory tree (web/public) straight from the kernel page cache.
+// Everything is indexed once at startup: each file keeps an open descriptor,
+// its MIME type and a strong ETag (content hash). Compressible files also
+// get a gzip variant, taken from a "<name>.gz" sibling if one exists or
+// compressed once into an anonymous memory file otherwise (zlib builds), so
+// both variants go out with sendfile() and no per-request copying. Files
+// named "name.<hash>.ext" are cached by browsers for a year, everything else
+// is revalidated on each use.
+// Files changed on disk are picked up on restart.
+class StaticFiles {
+  private:
+    struct Variant {
+      int fd = -1;
+      size_t size = 0;
+      std::string etag;
+    };
+    struct Entry {
+      const char* mime = "application/octet-stream";
+      bool immutable = false;   // the name carries a content hash
+      Variant plain;
+      Variant gzip;   // fd -1 if none
+    };
+    std::map<std::string, Entry, std::less<>> files;
+
+    void addFile(const std::string& urlPath, const std::string& diskPath);
+  public:
+    StaticFiles() = default;
+    StaticFiles(const StaticFiles&) = delete;
+    StaticFiles& operator=(const StaticFiles&) = delete;
+    ~StaticFiles();
+
+    // indexes root recursively; returns the number of files found
+    size_t load(const std::string& root);
+    bool has(std::string_view urlPath) const;
+    // Writes a full response (200 or 304) for a GET/HEAD of urlPath to the
+    // blocking socket sock. acceptEncoding and ifNoneMatch are the request
+    // header values ("" if absent). Returns false if urlPath is unknown.
+    bool serve(int sock, std::string_view urlPath, bool head,
+               std::string_view acceptEncoding, std::string_view ifNoneMatch) const;
+};
+
+#endif // STATICFILES_HPP
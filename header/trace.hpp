@@ -0,0 +1,57 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstdint>
+#include <string>
+
+// Scoped trace spans, compiled in with -DENABLE_TRACE=ON.
+//
+//   void Game::makeMove(...) { TRACE_SCOPE("Game::makeMove"); ... }
+//
+// A span records its name (a string literal) and start/end time into a
+// ring buffer owned by the calling thread, so recording takes no lock and
+// touches no shared cache line. Old spans are overwritten once a ring wraps.
+// chromeJson() collects the spans that ended in the last few milliseconds
+// from every thread, in the Chrome trace-event format (load it in
+// chrome://tracing or ui.perfetto.dev).
+//
+// Without ENABLE_TRACE, TRACE_SCOPE expands to nothing.
+namespace trace {
+
+#ifdef ENABLE_TRACE
+constexpr bool ENABLED = true;
+#else
+constexpr bool ENABLED = false;
+#endif
+
+// spans kept per thread
+constexpr int RING_SIZE = 1 << 14;
+
+uint64_t nowNanos();
+void record(const char* name, uint64_t start, uint64_t end);
+
+class Span {
+  private:
+    const char* name;
+    uint64_t start;
+  public:
+    explicit Span(const char* name) : name(name), start(nowNanos()) {}
+    ~Span() { record(name, start, nowNanos()); }
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+};
+
+// spans that ended within the last windowMs milliseconds
+std::string chromeJson(int windowMs);
+
+} // namespace trace
+
+#ifdef ENABLE_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) trace::Span TRACE_CONCAT(traceSpan, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
+
+#endif // TRACE_HPP
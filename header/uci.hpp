@@ -0,0 +1,24 @@
+#ifndef UCI_HPP
+#define UCI_HPP
+
+#include <iostream>
+#include <string>
+
+// Universal Chess Interface front end for the console app. Commands are read
+// from in on the calling thread while a search runs on a worker thread, so
+// "stop" and "isready" are answered during a search.
+//
+// Supported: uci, isready, ucinewgame, setoption (Hash, UCI_Variant,
+// EvalFile), position startpos|fen <fen> [moves ...], go [depth|nodes|
+// movetime|wtime|btime|winc|binc|movestogo|infinite], stop, quit, plus the
+// non-standard bench [depth] and d (print the board and its FEN).
+// Moves use coordinate notation ("e2e4", castling "e1g1"); there are no
+// promotions in this game. With UCI_Variant reveal, "position startpos" deals
+// a random RevealBoard layout and a FEN gives a layout explicitly (see fen.hpp).
+int uciLoop(std::istream& in, std::ostream& out);
+
+// runs the bench command (depth <= 0 picks the default) and returns, for
+// "app bench" on the command line
+void uciBench(std::ostream& out, int depth);
+
+#endif // UCI_HPP
@@ -0,0 +1,133 @@
+#ifndef USERSTORE_HPP
+#define USERSTORE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum GameOutcome { WHITE_WINS, BLACK_WINS, DRAWN };
+
+struct UserStats {
+  std::string name;
+  std::string avatar;
+  uint32_t wins = 0;
+  uint32_t losses = 0;
+  uint32_t draws = 0;
+  uint32_t rank = 0;   // 1-based leaderboard position, 0 before the first game
+  int rating = 1500;
+};
+
+struct GameResult {
+  std::string white;
+  std::string black;
+  GameOutcome outcome = DRAWN;
+  uint32_t plies = 0;
+  int64_t finishedAt = 0;   // unix seconds
+};
+
+// Users, their win/loss/draw counters and finished games.
+//
+// Everything lives in memory behind a hash index (name -> user); the file is
+// an append-only log of tab separated records, one per line, replayed once
+// by open():
+//   U name hash avatar            new user
+//   P name hash                   password change
+//   A name avatar                 avatar change
+//   R white black outcome plies finishedAt
+// Each change is appended and fdatasync'ed before it is applied, so a crash
+// loses at most a torn last line, which open() cuts off; a complete line
+// that does not replay is logged and skipped. Superseded P/A records and
+// skipped lines are dead bytes, dropped by compact(), which rewrites the log
+// to a temporary file, renames it over the old one and syncs the directory.
+// It runs automatically, on open and after a change, once the dead bytes
+// pass 64 KiB and outweigh the live ones.
+//
+// Ratings are Elo (start 1500, K 32), recomputed from the results on
+// replay. The leaderboard is an order-statistics tree keyed by rating, then
+// games played, then age: top-N costs O(log n + N) and a user's rank
+// O(log n). Names are 1-32 of [A-Za-z0-9_.-]; passwords and
+// avatars may not contain tabs or line breaks. Passwords are stored as
+// salted PBKDF2-HMAC-SHA256 ("pbkdf2-sha256$iterations$salt$hash"), hashed
+// outside the lock and compared in constant time; plaintext ones in an
+// older log (or users.csv on import) are hashed on the way in. All methods
+// are thread safe.
+class UserStore {
+  public:
+    enum Status { OK, EXISTS, NOT_FOUND, BAD_PASSWORD, INVALID, IO_ERROR };
+  private:
+    struct User {
+      std::string name;
+      std::string password;   // hashed
+      std::string avatar;
+      uint32_t wins = 0;
+      uint32_t losses = 0;
+      uint32_t draws = 0;
+      double rating = 1500;
+      std::vector<uint32_t> games;   // indices into results, oldest first
+
+      User(std::string name, std::string password, std::string avatar)
+          : name(std::move(name)), password(std::move(password)), avatar(std::move(avatar)) {}
+    };
+    struct StoredResult {
+      uint32_t white;
+      uint32_t black;
+      GameOutcome outcome;
+      uint32_t plies;
+      int64_t finishedAt;
+    };
+    struct Ranking;
+
+    std::string path;
+    int fd = -1;
+    uint64_t logBytes = 0;
+    mutable std::shared_mutex mutex;
+    std::deque<User> users;   // stable addresses: byName points into it
+    std::unordered_map<std::string_view, uint32_t> byName;
+    std::vector<StoredResult> results;
+    std::unique_ptr<Ranking> ranking;
+    uint64_t liveBytes = 0;   // what the log would be after a compaction
+
+    Status append(const std::string& record);
+    bool replay(std::string_view line);
+    const User* find(std::string_view name) const;
+    uint32_t rankOf(uint32_t id) const;
+    UserStats statsOf(uint32_t id) const;
+    void applyResult(const StoredResult& result);
+    bool compactLocked();
+    void compactIfWorthIt();
+  public:
+    explicit UserStore(std::string path);
+    ~UserStore();
+    UserStore(const UserStore&) = delete;
+    UserStore& operator=(const UserStore&) = delete;
+
+    // Loads the log, creating it if missing. False (with error set) if it
+    // cannot be read or opened for appending.
+    bool open(std::string& error);
+
+    Status addUser(std::string_view name, std::string_view password, std::string_view avatar);
+    Status checkPassword(std::string_view name, std::string_view password) const;
+    Status setPassword(std::string_view name, std::string_view password);
+    Status setAvatar(std::string_view name, std::string_view avatar);
+    Status recordResult(std::string_view white, std::string_view black, GameOutcome outcome,
+                        uint32_t plies, int64_t finishedAt);
+
+    bool stats(std::string_view name, UserStats& out) const;
+    // best first; users without finished games are not ranked
+    std::vector<UserStats> leaderboard(size_t count, size_t offset = 0) const;
+    // newest first
+    std::vector<GameResult> recentGames(std::string_view name, size_t count) const;
+    size_t userCount() const;
+
+    // Adds the users of a "username,password,avatar" CSV (with header line)
+    // that are not known yet. Returns how many were added.
+    size_t importUsersCsv(const std::string& csvPath);
+    bool compact();
+};
+
+#endif // USERSTORE_HPP
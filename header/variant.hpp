@@ -0,0 +1,75 @@
+#ifndef VARIANT_HPP
+#define VARIANT_HPP
+
+#include "piece.hpp"
+
+// Board variants as compile-time policies. A policy decides how a piece
+// moves and whether its type is visible; Board applies it whenever a piece is
+// placed or moves and caches the result, so type queries never branch on the
+// variant. Adding a variant (e.g. Chess960) means adding a policy here and a
+// case to withVariant.
+enum VariantId {
+  STANDARD_VARIANT,
+  REVEAL_VARIANT,
+};
+
+// piece type a square holds in the standard starting position
+constexpr PieceType initialPieceType(int row, int col) {
+  if (row == 1 || row == 6)
+    return PAWN;
+  switch (col) {
+  case 0:
+  case 7:
+    return ROOK;
+  case 1:
+  case 6:
+    return KNIGHT;
+  case 2:
+  case 5:
+    return BISHOP;
+  case 3:
+    return QUEEN;
+  default:
+    return KING;
+  }
+}
+
+struct StandardVariant {
+  static constexpr VariantId ID = STANDARD_VARIANT;
+  static constexpr const char* NAME = "standard";
+  static constexpr bool HIDES_PIECES = false;
+
+  static constexpr PieceType movementType(PieceType real, bool /*moved*/, int /*row*/, int /*col*/) {
+    return real;
+  }
+  static constexpr bool hidden(PieceType /*real*/, bool /*moved*/) {
+    return false;
+  }
+};
+
+// Every non-king piece starts on a random square of its side's first two
+// rows and moves as the standard piece of that square until its first move,
+// which reveals its real type.
+struct RevealVariant {
+  static constexpr VariantId ID = REVEAL_VARIANT;
+  static constexpr const char* NAME = "reveal";
+  static constexpr bool HIDES_PIECES = true;
+
+  static constexpr PieceType movementType(PieceType real, bool moved, int row, int col) {
+    return moved ? real : initialPieceType(row, col);
+  }
+  static constexpr bool hidden(PieceType real, bool moved) {
+    return !moved && real != KING;
+  }
+};
+
+// Runs f with the policy matching id; the one place a runtime variant choice
+// turns into a compile-time one.
+template <typename F>
+decltype(auto) withVariant(VariantId id, F&& f) {
+  if (id == REVEAL_VARIANT)
+    return f(RevealVariant{});
+  return f(StandardVariant{});
+}
+
+#endif // VARIANT_HPP
@@ -0,0 +1,42 @@
+#ifndef XOSHIRO_HPP
+#define XOSHIRO_HPP
+
+#include <cstdint>
+
+#include "zobrist.hpp"
+
+// xoshiro256** (Blackman and Vigna): 32 bytes of state, a few ns per draw.
+// The state is expanded from one 64-bit seed with splitmix64, so equal
+// seeds give equal sequences on every platform.
+class Xoshiro256 {
+  private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+      return (x << k) | (x >> (64 - k));
+    }
+  public:
+    explicit Xoshiro256(uint64_t seed) {
+      for (uint64_t& word : s)
+        word = zobrist::splitmix64(seed);
+    }
+
+    uint64_t next() {
+      uint64_t result = rotl(s[1] * 5, 7) * 9;
+      uint64_t t = s[1] << 17;
+      s[2] ^= s[0];
+      s[3] ^= s[1];
+      s[1] ^= s[2];
+      s[0] ^= s[3];
+      s[2] ^= t;
+      s[3] = rotl(s[3], 45);
+      return result;
+    }
+
+    // in [0, n) by multiply-shift, biased by at most n / 2^32
+    uint32_t below(uint32_t n) {
+      return uint32_t(((next() >> 32) * n) >> 32);
+    }
+};
+
+#endif // XOSHIRO_HPP
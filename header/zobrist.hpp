@@ -0,0 +1,48 @@
+#ifndef ZOBRIST_HPP
+#define ZOBRIST_HPP
+
+#include <cstdint>
+
+#include "piece.hpp"
+
+// Zobrist keys for position hashing, generated at compile time.
+// A position is keyed by every piece's (color, real type, square), an extra
+// key per square holding a piece that has never moved (covers castling,
+// double pushes and RevealBoard hidden state) and the side to move.
+namespace zobrist {
+
+struct Keys {
+  uint64_t piece[2][6][64];
+  uint64_t unmoved[64];
+  uint64_t side;
+};
+
+constexpr uint64_t splitmix64(uint64_t& state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+constexpr Keys makeKeys() {
+  Keys keys{};
+  uint64_t state = 0x5EED0C0FFEEULL;
+  for (int c = 0; c < 2; c++)
+    for (int t = 0; t < 6; t++)
+      for (int sq = 0; sq < 64; sq++)
+        keys.piece[c][t][sq] = splitmix64(state);
+  for (int sq = 0; sq < 64; sq++)
+    keys.unmoved[sq] = splitmix64(state);
+  keys.side = splitmix64(state);
+  return keys;
+}
+
+inline constexpr Keys KEYS = makeKeys();
+
+inline uint64_t pieceKey(PieceColor color, PieceType type, int row, int col) {
+  return KEYS.piece[color][type][row * 8 + col];
+}
+
+} // namespace zobrist
+
+#endif // ZOBRIST_HPP
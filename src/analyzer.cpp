@@ -0,0 +1,205 @@
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "../header/analyzer.hpp"
+#include "../header/legalMoves.hpp"
+#include "../header/metrics.hpp"
+#include "../header/search.hpp"
+#include "../header/zobrist.hpp"
+
+namespace {
+
+const metrics::Counter positionsCached("analysis_positions_total", "Positions annotated by the analyzer.",
+                                       "source=\"cache\"");
+const metrics::Counter positionsSearched("analysis_positions_total", "Positions annotated by the analyzer.",
+                                         "source=\"search\"");
+const metrics::Counter gamesAnalyzed("analysis_games_total", "Games the analyzer finished.");
+const metrics::Gauge queueDepth("analysis_queue_depth", "Games waiting for analysis.");
+
+constexpr int IDLE_NICE = 19;
+// centipawn loss thresholds for the marks
+constexpr int INACCURACY = 50;
+constexpr int MISTAKE = 100;
+constexpr int BLUNDER = 300;
+// mates count as this much when measuring a loss
+constexpr int MATE_VALUE = 1000;
+
+int clampScore(int score) {
+  return std::max(-MATE_VALUE, std::min(score, MATE_VALUE));
+}
+
+void searchPosition(Search& search, Board& board, PieceColor side, int depth, int multiPV,
+                    PositionAnalysis& out) {
+  out = PositionAnalysis();
+  PositionHistory history;
+  SearchLimits limits;
+  limits.depth = depth;
+  for (int k = 0; k < multiPV; k++) {
+    int score = 0;
+    history.clear();
+    Move best = search.run(board, side, 0, history, limits, [&](const SearchReport& r) { score = r.score; });
+    if (best.from == best.to)
+      break;
+    out.lines[out.count].move = best;
+    out.lines[out.count].score = int16_t(score);
+    out.count++;
+    limits.excluded.push_back(best);
+  }
+  if (out.count) {
+    out.score = out.lines[0].score;
+  } else {
+    LegalMoves legal(board, side);
+    out.score = int16_t(legal.inCheck() ? -MATE_SCORE : 0);
+  }
+}
+
+}
+
+Analyzer::Analyzer(const GameArchive& archive, AnalyzerConfig config)
+  : archive(archive), config(config), cache(std::max<size_t>(1, config.cacheEntries)) {
+  this->config.multiPV = std::max(1, std::min(config.multiPV, PositionAnalysis::MAX_PV));
+  for (int i = 0; i < std::max(1, config.workers); i++)
+    workers.emplace_back([this] { workerLoop(); });
+}
+
+Analyzer::~Analyzer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread& w : workers)
+    w.join();
+}
+
+bool Analyzer::submit(uint64_t gameId) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (jobs.count(gameId))
+      return true;
+    if (queue.size() >= config.queueCapacity)
+      return false;
+    jobs[gameId] = Job();
+    queue.push_back(gameId);
+    queueDepth.set(int64_t(queue.size()));
+  }
+  wake.notify_one();
+  return true;
+}
+
+Analyzer::State Analyzer::status(uint64_t gameId, std::shared_ptr<const GameAnalysis>& result) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = jobs.find(gameId);
+  if (it == jobs.end())
+    return UNKNOWN;
+  result = it->second.result;
+  return it->second.state;
+}
+
+size_t Analyzer::queued() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return queue.size();
+}
+
+void Analyzer::finish(uint64_t id, State state, std::shared_ptr<const GameAnalysis> result) {
+  std::lock_guard<std::mutex> lock(mutex);
+  Job& job = jobs[id];
+  job.state = state;
+  job.result = std::move(result);
+  finished.push_back(id);
+  while (finished.size() > config.keptResults) {
+    jobs.erase(finished.front());
+    finished.pop_front();
+  }
+}
+
+void Analyzer::workerLoop() {
+  pthread_setname_np(pthread_self(), "analysis");
+  // both apply to the calling thread on Linux
+  sched_param param{};
+  if (sched_setscheduler(0, SCHED_IDLE, &param) != 0)
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), IDLE_NICE);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    wake.wait(lock, [this] { return stopping || !queue.empty(); });
+    if (stopping)
+      return;
+    uint64_t id = queue.front();
+    queue.pop_front();
+    queueDepth.set(int64_t(queue.size()));
+    jobs[id].state = RUNNING;
+    lock.unlock();
+
+    auto result = std::make_shared<GameAnalysis>();
+    bool ok = analyze(id, *result);
+    if (ok)
+      gamesAnalyzed.add();
+    finish(id, ok ? DONE : FAILED, ok ? std::move(result) : nullptr);
+    lock.lock();
+  }
+}
+
+bool Analyzer::analyze(uint64_t gameId, GameAnalysis& out) {
+  ArchivedGame game;
+  if (!archive.read(gameId, game))
+    return false;
+  static thread_local Search search(16);
+
+  // every position of the game, then the annotations from consecutive pairs
+  std::vector<PositionAnalysis> positions(game.moves.size() + 1);
+  RevealBoard board(game.layout);
+  PieceColor side = WHITE;
+  for (size_t ply = 0; ply <= game.moves.size(); ply++) {
+    uint64_t key = board.hash() ^ (side == BLACK ? zobrist::KEYS.side : 0);
+    PositionAnalysis& p = positions[ply];
+    bool hit = false;
+    {
+      std::lock_guard<std::mutex> lock(cacheMutex);
+      const CacheEntry& e = cache[key % cache.size()];
+      if (e.key == key && e.depth >= config.depth && e.multiPV >= config.multiPV) {
+        p = e.analysis;
+        hit = true;
+      }
+    }
+    if (hit) {
+      positionsCached.add();
+    } else {
+      searchPosition(search, board, side, config.depth, config.multiPV, p);
+      positionsSearched.add();
+      std::lock_guard<std::mutex> lock(cacheMutex);
+      cache[key % cache.size()] = CacheEntry{key, uint8_t(config.depth), uint8_t(config.multiPV), p};
+    }
+    if (ply == game.moves.size())
+      break;
+    MoveUndo undo;
+    board.doMove<RevealVariant>(game.moves[ply], undo);
+    delete undo.captured;
+    side = (side == WHITE) ? BLACK : WHITE;
+  }
+
+  out.gameId = gameId;
+  out.depth = config.depth;
+  out.moves.resize(game.moves.size());
+  for (size_t ply = 0; ply < game.moves.size(); ply++) {
+    MoveAnnotation& a = out.moves[ply];
+    a.played = game.moves[ply];
+    a.before = positions[ply];
+    // when the played move is one of the lines, its score comes from the same
+    // search as the best one, which compares better
+    a.scorePlayed = -positions[ply + 1].score;
+    for (int k = 0; k < a.before.count; k++)
+      if (a.before.lines[k].move == a.played)
+        a.scorePlayed = a.before.lines[k].score;
+    a.loss = std::max(0, clampScore(a.before.score) - clampScore(a.scorePlayed));
+    a.mark = a.loss >= BLUNDER ? MARK_BLUNDER : a.loss >= MISTAKE ? MARK_MISTAKE
+           : a.loss >= INACCURACY ? MARK_INACCURACY : MARK_NONE;
+  }
+  out.last = positions.back();
+  return true;
+}
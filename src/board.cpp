@@ -1,5 +1,8 @@
 #include "../header/board.hpp"
 #include "../header/pieceMoves.hpp"
+#include "../header/moveGen.hpp"
+#include "../header/zobrist.hpp"
+#include "../header/trace.hpp"
 
 Board::Board() {
   clearBoard();
@@ -28,7 +31,9 @@ Board::Board() {
   }
 }
 
-Board::Board(const Board& rhs) {
+Board::Board(VariantId variant) : variant(variant) {}
+
+Board::Board(const Board& rhs) : variant(rhs.variant), summary(rhs.summary) {
   for (int i = 0; i < 8; i++) {
     for (int j = 0; j < 8; j++) {
       if (!(rhs.isOccupied(i,j)))
@@ -56,13 +61,21 @@ PieceColor Board::getColor(int row, int col) const {
 }
    
 PieceType Board::getPieceType(int row, int col) const {
-  return chessBoard[row][col]->getType();
+  return PieceType(summary.movementType[squareOf(row, col)]);
 }
 
 Board* Board::clone() const {
   return new Board(*this);
 }
 
+bool Board::isHidden(int row, int col) const {
+  return summary.hidden & squareBB(squareOf(row, col));
+}
+
+VariantId Board::getVariant() const {
+  return variant;
+}
+
 std::vector<Position> Board::validMoves(int row, int col) {
   PieceMoves moves(this);
   return moves.validMoves(row, col);
@@ -76,19 +89,40 @@ std::vector<Position> Board::generateMoves(int row, int col) {
 void Board::clearBoard() {
   for(int i=0; i<8; i++) {
     for(int j=0; j<8; j++) {
-      if (chessBoard[i][j] != nullptr) {
-        delete chessBoard[i][j];
-        chessBoard[i][j] = nullptr;
-      }
+      if (chessBoard[i][j] != nullptr)
+        removePiece(i, j);
     }
   }
 }
 
 void Board::addPiece(PieceType type, PieceColor color, int row, int col) {
+  withVariant(variant, [&](auto v) { addPieceAs<decltype(v)>(type, color, row, col); });
+}
+
+void Board::removePiece(int row, int col) {
+  withVariant(variant, [&](auto v) { removePieceAs<decltype(v)>(row, col); });
+}
+
+template <class Variant>
+void Board::addPieceAs(PieceType type, PieceColor color, int row, int col) {
   if (chessBoard[row][col] != nullptr)
-    delete chessBoard[row][col];
+    removePieceAs<Variant>(row, col);
   
   chessBoard[row][col] = makeNewPiece(type, color);
+  trackAdd<Variant>(row, col);
+  if (listener)
+    listener->pieceAdded(color, type, isHidden(row, col), row, col);
+}
+
+template <class Variant>
+void Board::removePieceAs(int row, int col) {
+  if (chessBoard[row][col] == nullptr)
+    return;
+  if (listener)
+    listener->pieceRemoved(getColor(row, col), chessBoard[row][col]->getType(), isHidden(row, col), row, col);
+  trackRemove<Variant>(row, col);
+  delete chessBoard[row][col];
+  chessBoard[row][col] = nullptr;
 }
 
 Piece* Board::getPiece(int row, int col) const {
@@ -120,74 +154,211 @@ bool Board::pieceMoved(int row, int col) const {
 }
 
 void Board::pieceSetMoved(int row, int col) {
-  if (chessBoard[row][col])
-    chessBoard[row][col]->setMoved();
+  if (chessBoard[row][col] && !chessBoard[row][col]->getMoved()) {
+    // the type it moves as may change (RevealBoard), so re-track it
+    withVariant(variant, [&](auto v) {
+      trackRemove<decltype(v)>(row, col);
+      chessBoard[row][col]->setMoved();
+      trackAdd<decltype(v)>(row, col);
+    });
+  }
 }
 
 void Board::movePiece(int srcRow, int srcCol, int dstRow, int dstCol) {
+  withVariant(variant, [&](auto v) { movePieceAs<decltype(v)>(srcRow, srcCol, dstRow, dstCol); });
+}
+
+template <class Variant>
+void Board::movePieceAs(int srcRow, int srcCol, int dstRow, int dstCol) {
   if (chessBoard[dstRow][dstCol])
-    delete chessBoard[dstRow][dstCol];
+    removePieceAs<Variant>(dstRow, dstCol);
   if (chessBoard[srcRow][srcCol]) {
+    bool wasHidden = listener && isHidden(srcRow, srcCol);
+    trackRemove<Variant>(srcRow, srcCol);
     chessBoard[dstRow][dstCol] = chessBoard[srcRow][srcCol];
     chessBoard[srcRow][srcCol] = nullptr;
-    pieceSetMoved(dstRow, dstCol);
+    chessBoard[dstRow][dstCol]->setMoved();
+    trackAdd<Variant>(dstRow, dstCol);
+    if (listener)
+      listener->pieceMoved(getColor(dstRow, dstCol), chessBoard[dstRow][dstCol]->getType(),
+                           wasHidden, srcRow, srcCol, dstRow, dstCol);
   }
 }
 
 bool Board::kingInCheck(PieceColor color) {
-  Position king_pos = findKing(color);
-  if (king_pos.x == 8 && king_pos.y == 8)
+  TRACE_SCOPE("Board::kingInCheck");
+  Bitboard king = pieces(color, KING);
+  if (!king)
     return false; // no king on board
 
-  PieceType type;
-  for (int i=0; i<8; i++) {
-    for (int j=0; j<8; j++) {
-      if (chessBoard[i][j]) {
-        if (getColor(i, j) == color)
-          continue;
-        else {
-          std::vector<Position> moves = generateMoves(i, j);
-          if (std::find(moves.begin(), moves.end(), king_pos) != moves.end()) {
-            return true;
-          }
-        }
-      }
-    }
-  }
-  return false;
+  PieceColor enemy = (color == WHITE) ? BLACK : WHITE;
+  return attackersTo(*this, lsb(king), enemy, occupied()) != 0;
 }
 
 Position Board::findKing(PieceColor color) {
-  for (int i=0; i<8; i++) {
-    for (int j=0; j<8; j++) {
-      if (chessBoard[i][j]) {
-        if (getPieceType(i, j) == KING && getColor(i,j) == color)
-          return Position(i, j);
-      }
-    }
-  }
-  return Position(8,8);
+  Bitboard king = pieces(color, KING);
+  if (!king)
+    return Position(8,8);
+  return Position(lsb(king) / 8, lsb(king) % 8);
 }
 
 PieceType Board::getInitialPieceType(int row, int col) const {
-  if (row == 1 or row == 6)
-    return PAWN;
-  else {
-    switch (col)
-    {
-    case 0:
-    case 7:
-      return ROOK;
-    case 1:
-    case 6:
-      return KNIGHT;
-    case 2:
-    case 5:
-     return BISHOP;
-    case 3:
-      return QUEEN;
-    default:
-      return KING;
+  return initialPieceType(row, col);
+}
+
+void Board::setListener(BoardListener* l) {
+  listener = l;
+}
+
+BoardListener* Board::getListener() const {
+  return listener;
+}
+
+uint64_t Board::hash() const {
+  return summary.hash;
+}
+
+int Board::pieceCount(PieceColor color, PieceType type) const {
+  return summary.pieceCounts[color][type];
+}
+
+bool Board::insufficientMaterial() const {
+  const int (&counts)[2][6] = summary.pieceCounts;
+  const int (&bishops)[2] = summary.bishopsOnSquareColor;
+  int knights = 0;
+  for (int c = 0; c < 2; c++) {
+    if (counts[c][PAWN] || counts[c][ROOK] || counts[c][QUEEN])
+      return false;
+    knights += counts[c][KNIGHT];
+  }
+  if (knights + bishops[0] + bishops[1] <= 1)
+    return true;
+  return knights == 0 && (bishops[0] == 0 || bishops[1] == 0);
+}
+
+Bitboard Board::pieces(PieceColor color) const {
+  return summary.byColor[color];
+}
+
+Bitboard Board::pieces(PieceColor color, PieceType type) const {
+  return summary.byColor[color] & summary.byType[type];
+}
+
+Bitboard Board::occupied() const {
+  return summary.byColor[WHITE] | summary.byColor[BLACK];
+}
+
+Bitboard Board::unmovedPieces() const {
+  return summary.unmoved;
+}
+
+Bitboard Board::hiddenPieces() const {
+  return summary.hidden;
+}
+
+template <class Variant>
+void Board::trackAdd(int row, int col) {
+  Piece* p = chessBoard[row][col];
+  Bitboard bb = squareBB(squareOf(row, col));
+  PieceType moveType = Variant::movementType(p->getType(), p->getMoved(), row, col);
+  summary.hash ^= zobrist::pieceKey(p->getColor(), p->getType(), row, col);
+  if (!p->getMoved()) {
+    summary.hash ^= zobrist::KEYS.unmoved[squareOf(row, col)];
+    summary.unmoved |= bb;
+  }
+  summary.pieceCounts[p->getColor()][p->getType()]++;
+  if (p->getType() == BISHOP)
+    summary.bishopsOnSquareColor[(row + col) & 1]++;
+  if (Variant::hidden(p->getType(), p->getMoved()))
+    summary.hidden |= bb;
+  summary.byColor[p->getColor()] |= bb;
+  summary.byType[moveType] |= bb;
+  summary.movementType[squareOf(row, col)] = uint8_t(moveType);
+}
+
+template <class Variant>
+void Board::trackRemove(int row, int col) {
+  Piece* p = chessBoard[row][col];
+  Bitboard bb = squareBB(squareOf(row, col));
+  summary.hash ^= zobrist::pieceKey(p->getColor(), p->getType(), row, col);
+  if (!p->getMoved()) {
+    summary.hash ^= zobrist::KEYS.unmoved[squareOf(row, col)];
+    summary.unmoved &= ~bb;
+  }
+  summary.pieceCounts[p->getColor()][p->getType()]--;
+  if (p->getType() == BISHOP)
+    summary.bishopsOnSquareColor[(row + col) & 1]--;
+  summary.hidden &= ~bb;
+  summary.byColor[p->getColor()] &= ~bb;
+  summary.byType[summary.movementType[squareOf(row, col)]] &= ~bb;
+}
+
+template <class Variant>
+Piece* Board::detach(int row, int col) {
+  Piece* p = chessBoard[row][col];
+  if (listener)
+    listener->pieceRemoved(p->getColor(), p->getType(), isHidden(row, col), row, col);
+  trackRemove<Variant>(row, col);
+  chessBoard[row][col] = nullptr;
+  return p;
+}
+
+template <class Variant>
+void Board::attach(Piece* piece, int row, int col) {
+  chessBoard[row][col] = piece;
+  trackAdd<Variant>(row, col);
+  if (listener)
+    listener->pieceAdded(piece->getColor(), piece->getType(), isHidden(row, col), row, col);
+}
+
+template <class Variant>
+void Board::moveBack(int row, int col, int toRow, int toCol, bool unmoved) {
+  Piece* p = detach<Variant>(row, col);
+  if (unmoved)
+    p->resetMoved();
+  attach<Variant>(p, toRow, toCol);
+}
+
+template <class Variant>
+void Board::doMove(Move move, MoveUndo& undo) {
+  int srcRow = move.from / 8, srcCol = move.from % 8;
+  int dstRow = move.to / 8, dstCol = move.to % 8;
+  undo = MoveUndo();
+  if (chessBoard[dstRow][dstCol])
+    undo.captured = detach<Variant>(dstRow, dstCol);
+
+  // castling, same rook handling as Game::makeMove
+  if (summary.movementType[move.from] == KING && (dstCol - srcCol == 2 || srcCol - dstCol == 2)) {
+    int rookCol = (dstCol > srcCol) ? 7 : 0;
+    if (chessBoard[srcRow][rookCol] && getPieceType(srcRow, rookCol) == ROOK) {
+      undo.rookFrom = squareOf(srcRow, rookCol);
+      undo.rookTo = squareOf(srcRow, (dstCol > srcCol) ? 5 : 3);
+      undo.rookUnmoved = !chessBoard[srcRow][rookCol]->getMoved();
+      movePieceAs<Variant>(srcRow, rookCol, undo.rookTo / 8, undo.rookTo % 8);
     }
   }
-}
\ No newline at end of file
+
+  undo.moverUnmoved = !chessBoard[srcRow][srcCol]->getMoved();
+  movePieceAs<Variant>(srcRow, srcCol, dstRow, dstCol);
+}
+
+template <class Variant>
+void Board::undoMove(Move move, const MoveUndo& undo) {
+  moveBack<Variant>(move.to / 8, move.to % 8, move.from / 8, move.from % 8, undo.moverUnmoved);
+  if (undo.rookFrom >= 0)
+    moveBack<Variant>(undo.rookTo / 8, undo.rookTo % 8, undo.rookFrom / 8, undo.rookFrom % 8, undo.rookUnmoved);
+  if (undo.captured)
+    attach<Variant>(undo.captured, move.to / 8, move.to % 8);
+}
+
+template void Board::trackAdd<RevealVariant>(int, int);
+template void Board::addPieceAs<StandardVariant>(PieceType, PieceColor, int, int);
+template void Board::addPieceAs<RevealVariant>(PieceType, PieceColor, int, int);
+template void Board::removePieceAs<StandardVariant>(int, int);
+template void Board::removePieceAs<RevealVariant>(int, int);
+template void Board::movePieceAs<StandardVariant>(int, int, int, int);
+template void Board::movePieceAs<RevealVariant>(int, int, int, int);
+template void Board::doMove<StandardVariant>(Move, MoveUndo&);
+template void Board::doMove<RevealVariant>(Move, MoveUndo&);
+template void Board::undoMove<StandardVariant>(Move, const MoveUndo&);
+template void Board::undoMove<RevealVariant>(Move, const MoveUndo&);
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#include "../header/broadcaster.hpp"
+#include "../header/metrics.hpp"
+#include "../header/trace.hpp"
+
+namespace {
+
+// kept here so every drop counts, including sockets that fail mid-publish
+const metrics::Gauge streams("http_event_streams", "Open /events streams.");
+
+}
+
+void Broadcaster::subscribe(int fd, Frame initial, uint32_t channel) {
+  if (fd >= (int)byFd.size())
+    byFd.resize(fd + 1);
+  Subscriber& sub = byFd[fd];
+  sub = Subscriber();
+  std::vector<int>& fds = channels[channel];
+  sub.channel = channel;
+  sub.slot = (int)fds.size();
+  fds.push_back(fd);
+  count++;
+  streams.add(1);
+  sub.current = std::move(initial);
+  if (sub.current)
+    write(fd, sub);
+}
+
+void Broadcaster::unsubscribe(int fd) {
+  if (!has(fd))
+    return;
+  Subscriber& sub = byFd[fd];
+  // swap-remove from the channel's dense list
+  auto channel = channels.find(sub.channel);
+  std::vector<int>& fds = channel->second;
+  int last = fds.back();
+  fds[sub.slot] = last;
+  byFd[last].slot = sub.slot;
+  fds.pop_back();
+  if (fds.empty())
+    channels.erase(channel);
+  count--;
+  streams.add(-1);
+  sub = Subscriber();
+  close(fd);
+}
+
+bool Broadcaster::has(int fd) const {
+  return fd >= 0 && fd < (int)byFd.size() && byFd[fd].slot >= 0;
+}
+
+void Broadcaster::publish(const Frame& frame, uint32_t channel) {
+  TRACE_SCOPE("Broadcaster::publish");
+  auto it = channels.find(channel);
+  if (it == channels.end())
+    return;
+  // walk backwards: unsubscribe() swap-removes with entries already visited,
+  // and erases the list only with its last entry, which ends the loop
+  std::vector<int>& fds = it->second;
+  for (int i = (int)fds.size() - 1; i >= 0; i--) {
+    int fd = fds[i];
+    Subscriber& sub = byFd[fd];
+    if (sub.current) {
+      sub.next = frame;   // replaces any frame it had not started yet
+      continue;
+    }
+    sub.current = frame;
+    sub.offset = 0;
+    write(fd, sub);
+  }
+}
+
+void Broadcaster::flush(int fd) {
+  if (has(fd) && byFd[fd].current)
+    write(fd, byFd[fd]);
+}
+
+size_t Broadcaster::size() const {
+  return count;
+}
+
+bool Broadcaster::write(int fd, Subscriber& sub) {
+  while (sub.current) {
+    const std::string& bytes = *sub.current;
+    ssize_t n = send(fd, bytes.data() + sub.offset, bytes.size() - sub.offset, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return true;   // flush() resumes on the next writable edge
+      unsubscribe(fd);
+      return false;
+    }
+    sub.offset += n;
+    if (sub.offset == bytes.size()) {
+      sub.current = std::move(sub.next);
+      sub.next.reset();
+      sub.offset = 0;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,201 @@
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "../header/enginePool.hpp"
+#include "../header/gameHost.hpp"
+#include "../header/legalMoves.hpp"
+#include "../header/metrics.hpp"
+#include "../header/zobrist.hpp"
+
+namespace {
+
+const metrics::Counter ponderHits("engine_ponder_total", "Engine moves by whether pondering predicted the reply.",
+                                  "result=\"hit\"");
+const metrics::Counter ponderMisses("engine_ponder_total", "Engine moves by whether pondering predicted the reply.",
+                                    "result=\"miss\"");
+const metrics::Counter instantMoves("engine_instant_moves_total", "Engine moves answered from a finished ponder search.");
+const metrics::Gauge ponderingRooms("engine_pondering_rooms", "Rooms pondering right now.");
+
+uint64_t positionKey(const Board& board, PieceColor side) {
+  return board.hash() ^ (side == BLACK ? zobrist::KEYS.side : 0);
+}
+
+}
+
+EnginePool::EnginePool(Moved moved, EngineConfig config) : config(config), moved(std::move(moved)) {
+  this->config.threads = std::max(1, config.threads);
+  // a thread is always left for engine moves
+  this->config.ponderSlots = std::max(0, std::min(config.ponderSlots, this->config.threads - 1));
+  for (int i = 0; i < this->config.threads; i++)
+    threads.emplace_back([this] { threadLoop(); });
+}
+
+EnginePool::~EnginePool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread& t : threads)
+    t.join();
+}
+
+void EnginePool::engineToMove(const std::shared_ptr<Room>& room) {
+  room->engine->search.stop();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    moves.push_back(Task{room, room->game.getRevision()});
+  }
+  wake.notify_one();
+}
+
+void EnginePool::threadLoop() {
+  pthread_setname_np(pthread_self(), "engine-pool");
+  setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), config.nice);
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    wake.wait(lock, [this] {
+      return stopping || !moves.empty() || (!ponders.empty() && pondering < config.ponderSlots);
+    });
+    if (stopping)
+      return;
+    if (!moves.empty()) {
+      Task task = std::move(moves.front());
+      moves.pop_front();
+      lock.unlock();
+      play(task);
+      lock.lock();
+      continue;
+    }
+    Task task = std::move(ponders.front());
+    ponders.pop_front();
+    ponderingRooms.set(++pondering);
+    lock.unlock();
+    ponder(task);
+    lock.lock();
+    ponderingRooms.set(--pondering);
+    wake.notify_all();   // a ponder slot is free
+  }
+}
+
+void EnginePool::play(const Task& task) {
+  Room& room = *task.room;
+  EngineSeat& seat = *room.engine;
+  std::lock_guard<std::mutex> searchLock(seat.searchMutex);
+  seat.search.clearStop();
+
+  std::unique_ptr<Board> board;
+  PositionHistory history;
+  int halfmoveClock;
+  uint64_t key;
+  {
+    std::lock_guard<std::mutex> lock(room.mutex);
+    if (room.game.getRevision() != task.revision || room.game.isGameOver() || room.game.getCurrentTurn() != seat.color)
+      return;
+    board.reset(room.board.clone());
+    history = room.game.getHistory();
+    halfmoveClock = room.game.getHalfmoveClock();
+    key = room.game.positionKey();
+  }
+
+  std::vector<Move> pv;
+  int64_t budget = seat.movetime;
+  if (seat.ponderedKey) {
+    bool hit = seat.ponderedKey == key && !seat.ponderedPv.empty();
+    (hit ? ponderHits : ponderMisses).add();
+    if (hit) {
+      budget -= seat.ponderedMs;
+      pv = seat.ponderedPv;
+    }
+    seat.ponderedKey = 0;
+  }
+  if (budget > 0 || pv.empty()) {
+    SearchLimits limits;
+    limits.movetime = int(std::max<int64_t>(budget, 10));
+    Move best = seat.search.run(*board, seat.color, halfmoveClock, history, limits,
+                                [&](const SearchReport& r) { pv = r.pv; });
+    if (pv.empty() || pv[0] != best)
+      pv.assign(1, best);
+  } else {
+    instantMoves.add();
+  }
+  if (pv.empty() || pv[0].from == pv[0].to)
+    return;
+
+  bool ponderNext = false;
+  uint64_t revision;
+  {
+    std::lock_guard<std::mutex> lock(room.mutex);
+    if (room.game.getRevision() != task.revision)
+      return;
+    Move best = pv[0];
+    if (!room.game.makeMove(best.from / 8, best.from % 8, best.to / 8, best.to % 8))
+      return;
+    moved(room);
+    seat.predicted = (pv.size() > 1) ? pv[1] : Move();
+    ponderNext = !room.game.isGameOver() && config.ponderSlots > 0;
+    revision = room.game.getRevision();
+  }
+  if (ponderNext) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ponders.push_back(Task{task.room, revision});
+    wake.notify_one();
+  }
+}
+
+void EnginePool::ponder(const Task& task) {
+  Room& room = *task.room;
+  EngineSeat& seat = *room.engine;
+  std::lock_guard<std::mutex> searchLock(seat.searchMutex);
+  // before the staleness check: a human move after it must stop the search
+  seat.search.clearStop();
+
+  std::unique_ptr<Board> board;
+  PositionHistory history;
+  int halfmoveClock;
+  PieceColor side;
+  {
+    std::lock_guard<std::mutex> lock(room.mutex);
+    if (room.game.getRevision() != task.revision || room.game.isGameOver() || room.game.getCurrentTurn() == seat.color)
+      return;
+    board.reset(room.board.clone());
+    history = room.game.getHistory();
+    halfmoveClock = room.game.getHalfmoveClock();
+    side = room.game.getCurrentTurn();
+  }
+
+  // with a predicted reply, search the position after it as the engine
+  MoveList legal;
+  LegalMoves(*board, side).generate(legal);
+  bool predicting = legal.contains(seat.predicted);
+  MoveUndo undo;
+  if (predicting) {
+    Move reply = seat.predicted;
+    bool irreversible = board->isOccupied(reply.to / 8, reply.to % 8) ||
+                        board->getPieceType(reply.from / 8, reply.from % 8) == PAWN;
+    withVariant(board->getVariant(), [&](auto variant) {
+      board->doMove<decltype(variant)>(reply, undo);
+    });
+    side = seat.color;
+    halfmoveClock = irreversible ? 0 : halfmoveClock + 1;
+    history.push(positionKey(*board, side));
+  }
+
+  SearchLimits limits;
+  limits.movetime = std::max(10, std::min(config.maxPonderMs, config.ponderFactor * seat.movetime));
+  std::vector<Move> pv;
+  auto start = std::chrono::steady_clock::now();
+  seat.search.run(*board, side, halfmoveClock, history, limits, [&](const SearchReport& r) { pv = r.pv; });
+  int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+  delete undo.captured;
+
+  // without a prediction the search only leaves its table behind
+  seat.ponderedKey = predicting ? positionKey(*board, side) : 0;
+  seat.ponderedPv = predicting ? pv : std::vector<Move>();
+  seat.ponderedMs = ms;
+}
@@ -0,0 +1,25 @@
+#include "../header/eval.hpp"
+
+int evaluate(const Board& board, const nnue::Accumulator& acc, PieceColor side) {
+  if (nnue::networkLoaded())
+    return acc.evaluate(side);
+  return materialEvaluate(board, side);
+}
+
+// O(hidden pieces): real material comes from the board's counters, unrevealed
+// pieces are then swapped from their real value to the hidden weight.
+int materialEvaluate(const Board& board, PieceColor side) {
+  const EvalWeights& weights = EVAL_WEIGHTS[board.getVariant()];
+  int material[2] = {0, 0};
+  for (int c = BLACK; c <= WHITE; c++) {
+    for (int t = PAWN; t < KING; t++)
+      material[c] += board.pieceCount(PieceColor(c), PieceType(t)) * weights.piece[t];
+    Bitboard hidden = board.hiddenPieces() & board.pieces(PieceColor(c));
+    while (hidden) {
+      int sq = popLsb(hidden);
+      material[c] += weights.hidden - weights.piece[board.getPiece(sq / 8, sq % 8)->getType()];
+    }
+  }
+  PieceColor other = (side == WHITE) ? BLACK : WHITE;
+  return material[side] - material[other];
+}
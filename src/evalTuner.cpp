@@ -0,0 +1,470 @@
+// Texel tuning of the material evaluation (evalWeights.hpp), one variant at
+// a time.
+// usage: eval_tuner play <positions.bin> <standard|reveal> [games] [threads] [depth]
+//          games (default 1000) of self-play at fixed depth (default 4)
+//          after a few random plies, appending every quiet position with
+//          the game's result; lopsided games are adjudicated
+//        eval_tuner tune <positions.bin> <evalWeights.hpp> [threads] [epochs]
+//          fits the logistic scale to the current weights, then runs Adam on
+//          the file's variant until the loss stops falling, and rewrites the
+//          header with the tuned weights (the other variant is kept)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../header/eval.hpp"
+#include "../header/game.hpp"
+#include "../header/legalMoves.hpp"
+#include "../header/revealBoard.hpp"
+#include "../header/search.hpp"
+#include "../header/xoshiro.hpp"
+
+namespace {
+
+// The file is a 16 byte header ("EVALPOS1", variant) and 32 byte records;
+// play appends to it.
+const char MAGIC[8] = {'E', 'V', 'A', 'L', 'P', 'O', 'S', '1'};
+
+struct FileHeader {
+  char magic[8];
+  uint32_t variant;
+  uint32_t reserved;
+};
+
+struct LabeledPosition {
+  Bitboard occupied;
+  // 4 bits per occupied square in square order: color << 3 | real type
+  uint8_t pieces[16];
+  // bit i: the piece on the i-th occupied square is unrevealed
+  uint32_t hidden;
+  uint8_t result;     // for White: 0 loss, 1 draw, 2 win
+  uint8_t turn;
+  uint8_t reserved[2];
+};
+
+static_assert(sizeof(LabeledPosition) == 32, "LabeledPosition is meant to be 32 bytes");
+
+constexpr int RANDOM_PLIES = 8;
+// adjudicated a draw
+constexpr int MAX_PLIES = 300;
+// adjudicated a win once both sides' searches agree for this many plies
+constexpr int DECISIVE_SCORE = 1000;
+constexpr int DECISIVE_PLIES = 6;
+
+// Features are White's minus Black's piece counts: revealed pieces by type
+// (the king slot always cancels, so it counts unrevealed pieces), padded to
+// WIDTH so a position's dot product is one vector.
+constexpr int WIDTH = 8;
+constexpr int HIDDEN_FEATURE = KING;
+constexpr int BLOCK = 4096;
+
+std::atomic<bool> interrupted{false};
+
+LabeledPosition pack(const Board& board, PieceColor turn) {
+  LabeledPosition p{};
+  p.occupied = board.occupied();
+  p.turn = uint8_t(turn);
+  Bitboard rest = p.occupied;
+  for (int i = 0; rest; i++) {
+    int sq = popLsb(rest);
+    Piece* piece = board.getPiece(sq / 8, sq % 8);
+    p.pieces[i / 2] |= uint8_t((piece->getColor() << 3 | piece->getType()) << (4 * (i % 2)));
+    if (board.isHidden(sq / 8, sq % 8))
+      p.hidden |= 1u << i;
+  }
+  return p;
+}
+
+bool writeHeader(FILE* f, VariantId variant) {
+  FileHeader header{};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.variant = variant;
+  return fwrite(&header, sizeof(header), 1, f) == 1;
+}
+
+// opens path to append positions of variant, creating it if missing
+FILE* openForAppend(const char* path, VariantId variant) {
+  FILE* f = fopen(path, "r+b");
+  if (!f) {
+    f = fopen(path, "wb");
+    if (!f || !writeHeader(f, variant)) {
+      perror(path);
+      return nullptr;
+    }
+    return f;
+  }
+  FileHeader header;
+  if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.variant != uint32_t(variant)) {
+    fprintf(stderr, "%s: not a %s position file\n", path,
+            variant == REVEAL_VARIANT ? RevealVariant::NAME : StandardVariant::NAME);
+    fclose(f);
+    return nullptr;
+  }
+  fseek(f, 0, SEEK_END);
+  return f;
+}
+
+// one self-play game; returns the quiet positions labeled with its result
+std::vector<LabeledPosition> playGame(VariantId variant, uint64_t seed, int depth, Search& search) {
+  // RevealBoard only builds the start; ~Board is not virtual, so own a plain Board
+  std::unique_ptr<Board> board(variant == REVEAL_VARIANT ? RevealBoard(RevealLayout::fromSeed(seed)).clone()
+                                                         : new Board());
+  Game game(board.get());
+  Xoshiro256 rng(seed);
+  search.clear();
+  std::vector<LabeledPosition> positions;
+  uint8_t result = 1;
+  int decisive = 0;   // plies in a row White's score was decisive, negative for Black's
+  while (!game.isGameOver() && game.getPly() < MAX_PLIES && !interrupted) {
+    PieceColor us = game.getCurrentTurn();
+    LegalMoves legal(*board, us);
+    Move move;
+    if (game.getPly() < RANDOM_PLIES) {
+      MoveList list;
+      legal.generate(list);
+      move = list[int(rng.below(uint32_t(list.size())))];
+    } else {
+      SearchLimits limits;
+      limits.depth = depth;
+      int score = 0;
+      move = search.run(*board, us, game.getHalfmoveClock(), game.getHistory(), limits,
+                        [&](const SearchReport& r) { score = r.score; });
+      // material is only judged fairly where nothing hangs
+      if (!legal.inCheck() && !board->isOccupied(move.to / 8, move.to % 8))
+        positions.push_back(pack(*board, us));
+      if (us == BLACK)
+        score = -score;
+      if (score >= DECISIVE_SCORE)
+        decisive = std::max(decisive, 0) + 1;
+      else if (score <= -DECISIVE_SCORE)
+        decisive = std::min(decisive, 0) - 1;
+      else
+        decisive = 0;
+      if (decisive >= DECISIVE_PLIES || decisive <= -DECISIVE_PLIES) {
+        result = (decisive > 0) ? 2 : 0;
+        break;
+      }
+    }
+    game.makeMove(move.from / 8, move.from % 8, move.to / 8, move.to % 8);
+  }
+  if (game.getGameState() == CHECKMATE)
+    result = (game.getCurrentTurn() == WHITE) ? 0 : 2;
+  for (LabeledPosition& p : positions)
+    p.result = result;
+  return positions;
+}
+
+int play(const char* path, VariantId variant, int games, int threads, int depth) {
+  FILE* out = openForAppend(path, variant);
+  if (!out)
+    return 1;
+  signal(SIGINT, [](int) { interrupted = true; });
+  signal(SIGTERM, [](int) { interrupted = true; });
+
+  uint64_t base = RevealLayout::randomSeed();
+  std::atomic<int> next{0}, done{0};
+  std::atomic<uint64_t> written{0};
+  std::atomic<bool> failed{false};
+  std::mutex outMutex;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&] {
+      Search search(16);
+      for (int g; !interrupted && (g = next.fetch_add(1)) < games;) {
+        std::vector<LabeledPosition> positions = playGame(variant, base + uint64_t(g), depth, search);
+        if (interrupted)
+          return;
+        {
+          std::lock_guard<std::mutex> lock(outMutex);
+          if (fwrite(positions.data(), sizeof(LabeledPosition), positions.size(), out) != positions.size())
+            failed = true;
+        }
+        written.fetch_add(positions.size(), std::memory_order_relaxed);
+        done.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+  while (done.load() < games && !interrupted && !failed) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "\r%d / %d games, %llu positions (%.1f games/s)", done.load(), games,
+            (unsigned long long)written.load(), done.load() / std::max(seconds, 1e-9));
+  }
+  for (std::thread& w : workers)
+    w.join();
+  bool ok = !failed && fclose(out) == 0;
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  fprintf(stderr, "\r%d games%s, %llu positions appended, %.1f s on %d threads\n", done.load(),
+          interrupted ? " before the interrupt" : "", (unsigned long long)written.load(), seconds, threads);
+  if (!ok) {
+    fprintf(stderr, "%s: write failed\n", path);
+    return 1;
+  }
+  return 0;
+}
+
+struct Dataset {
+  VariantId variant = STANDARD_VARIANT;
+  size_t size = 0;
+  std::vector<int8_t> features;   // size * WIDTH
+  std::vector<float> results;     // for White, 0 to 1
+};
+
+bool load(const char* path, Dataset& data) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  FileHeader header;
+  if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.variant > REVEAL_VARIANT) {
+    fprintf(stderr, "%s: not a position file\n", path);
+    fclose(f);
+    return false;
+  }
+  data.variant = VariantId(header.variant);
+  std::vector<LabeledPosition> block(BLOCK);
+  for (size_t n; (n = fread(block.data(), sizeof(LabeledPosition), block.size(), f)) > 0;) {
+    for (size_t i = 0; i < n; i++) {
+      const LabeledPosition& p = block[i];
+      int8_t row[WIDTH] = {};
+      int count = popCount(p.occupied);
+      for (int k = 0; k < count; k++) {
+        int nibble = (p.pieces[k / 2] >> (4 * (k % 2))) & 15;
+        int type = nibble & 7;
+        if (type == KING)
+          continue;
+        int sign = ((nibble >> 3) == WHITE) ? 1 : -1;
+        row[(p.hidden >> k & 1) ? HIDDEN_FEATURE : type] += int8_t(sign);
+      }
+      data.features.insert(data.features.end(), row, row + WIDTH);
+      data.results.push_back(p.result * 0.5f);
+    }
+  }
+  fclose(f);
+  data.size = data.results.size();
+  return true;
+}
+
+// Mean squared error of the results against sigmoid(scale * eval) and, if
+// gradient is set, its derivative by weight. Contiguous slices per thread,
+// summed in float per block and in double across blocks.
+double loss(const Dataset& data, const float* weights, double scale, int threads, double* gradient) {
+  std::vector<double> partial(size_t(threads) * (WIDTH + 1), 0.0);
+  auto work = [&](int t) {
+    size_t first = data.size * t / threads, last = data.size * (t + 1) / threads;
+    double* sum = &partial[size_t(t) * (WIDTH + 1)];
+    float k = float(scale);
+    for (size_t b = first; b < last; b += BLOCK) {
+      size_t end = std::min(last, b + BLOCK);
+      float error = 0;
+      float grad[WIDTH] = {};
+      for (size_t i = b; i < end; i++) {
+        const int8_t* f = &data.features[i * WIDTH];
+        float eval = 0;
+        for (int j = 0; j < WIDTH; j++)
+          eval += weights[j] * f[j];
+        float s = 1.0f / (1.0f + std::exp(-k * eval));
+        float diff = s - data.results[i];
+        error += diff * diff;
+        if (gradient) {
+          float d = diff * s * (1.0f - s);
+          for (int j = 0; j < WIDTH; j++)
+            grad[j] += d * f[j];
+        }
+      }
+      sum[WIDTH] += error;
+      for (int j = 0; j < WIDTH; j++)
+        sum[j] += grad[j];
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threads; t++)
+    workers.emplace_back(work, t);
+  work(0);
+  for (std::thread& w : workers)
+    w.join();
+  double error = 0;
+  if (gradient)
+    std::fill(gradient, gradient + WIDTH, 0.0);
+  for (int t = 0; t < threads; t++) {
+    const double* sum = &partial[size_t(t) * (WIDTH + 1)];
+    error += sum[WIDTH];
+    if (gradient)
+      for (int j = 0; j < WIDTH; j++)
+        gradient[j] += 2 * scale * sum[j] / double(data.size);
+  }
+  return error / double(data.size);
+}
+
+// golden section search for the scale that best fits the current weights;
+// it then stays fixed, so the tuned weights keep the centipawn scale
+double fitScale(const Dataset& data, const float* weights, int threads) {
+  const double ratio = (std::sqrt(5.0) - 1) / 2;
+  double lo = 1e-4, hi = 0.05;
+  double a = hi - ratio * (hi - lo), b = lo + ratio * (hi - lo);
+  double la = loss(data, weights, a, threads, nullptr), lb = loss(data, weights, b, threads, nullptr);
+  while (hi - lo > 1e-6) {
+    if (la < lb) {
+      hi = b;
+      b = a;
+      lb = la;
+      a = hi - ratio * (hi - lo);
+      la = loss(data, weights, a, threads, nullptr);
+    } else {
+      lo = a;
+      a = b;
+      la = lb;
+      b = lo + ratio * (hi - lo);
+      lb = loss(data, weights, b, threads, nullptr);
+    }
+  }
+  return (lo + hi) / 2;
+}
+
+void writeWeights(FILE* f, const EvalWeights& w) {
+  fprintf(f, "  {{%d, %d, %d, %d, %d, 0}, %d},\n", w.piece[PAWN], w.piece[KNIGHT], w.piece[BISHOP], w.piece[ROOK],
+          w.piece[QUEEN], w.hidden);
+}
+
+bool writeHeader(const std::string& path, const EvalWeights weights[2], const std::string source[2]) {
+  std::string temp = path + ".tmp";
+  FILE* f = fopen(temp.c_str(), "w");
+  if (!f) {
+    perror(temp.c_str());
+    return false;
+  }
+  fprintf(f, "#ifndef EVALWEIGHTS_HPP\n#define EVALWEIGHTS_HPP\n\n"
+             "// Material evaluation weights per variant (VariantId), in centipawns.\n"
+             "// Written by eval_tuner tune, which rewrites the variant it tuned and\n"
+             "// keeps the other.\n"
+             "struct EvalWeights {\n"
+             "  int piece[6];   // by PieceType, revealed pieces\n"
+             "  int hidden;     // an unrevealed RevealBoard piece\n"
+             "};\n\n"
+             "constexpr EvalWeights EVAL_WEIGHTS[2] = {\n");
+  writeWeights(f, weights[STANDARD_VARIANT]);
+  writeWeights(f, weights[REVEAL_VARIANT]);
+  fprintf(f, "};\n\n// where each variant's weights came from\n"
+             "constexpr const char* EVAL_WEIGHTS_SOURCE[2] = {\n  \"%s\",\n  \"%s\",\n};\n\n"
+             "#endif // EVALWEIGHTS_HPP\n",
+          source[STANDARD_VARIANT].c_str(), source[REVEAL_VARIANT].c_str());
+  bool ok = fclose(f) == 0;
+  if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+    perror(path.c_str());
+    return false;
+  }
+  return true;
+}
+
+int tune(const char* path, const std::string& headerPath, int threads, int epochs) {
+  Dataset data;
+  auto start = std::chrono::steady_clock::now();
+  if (!load(path, data))
+    return 1;
+  if (data.size == 0) {
+    fprintf(stderr, "%s: no positions\n", path);
+    return 1;
+  }
+  auto since = [](std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+  };
+  const char* name = data.variant == REVEAL_VARIANT ? RevealVariant::NAME : StandardVariant::NAME;
+  fprintf(stderr, "%zu %s positions loaded in %.1f s\n", data.size, name, since(start));
+
+  const EvalWeights& current = EVAL_WEIGHTS[data.variant];
+  float weights[WIDTH] = {};
+  for (int t = PAWN; t < KING; t++)
+    weights[t] = float(current.piece[t]);
+  weights[HIDDEN_FEATURE] = float(current.hidden);
+  double scale = fitScale(data, weights, threads);
+  double initial = loss(data, weights, scale, threads, nullptr);
+  fprintf(stderr, "scale %.6f per cp, loss %.6f with the current weights\n", scale, initial);
+
+  // Adam over the full set; the step halves whenever the loss rises and the
+  // run ends when it is too small to move a weight or the loss has stalled
+  const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-12;
+  const double stall = 1e-9;
+  double rate = 2.0;
+  double m[WIDTH] = {}, v[WIDTH] = {}, gradient[WIDTH];
+  double previous = initial, last = initial;
+  int epoch = 0;
+  auto tuning = std::chrono::steady_clock::now();
+  for (int quiet = 0; epoch < epochs && rate > 0.01 && quiet < 50 && !interrupted; epoch++) {
+    last = loss(data, weights, scale, threads, gradient);
+    if (last > previous)
+      rate /= 2;
+    quiet = (previous - last < stall) ? quiet + 1 : 0;
+    previous = last;
+    for (int j = 0; j < WIDTH; j++) {
+      m[j] = beta1 * m[j] + (1 - beta1) * gradient[j];
+      v[j] = beta2 * v[j] + (1 - beta2) * gradient[j] * gradient[j];
+      double mHat = m[j] / (1 - std::pow(beta1, epoch + 1));
+      double vHat = v[j] / (1 - std::pow(beta2, epoch + 1));
+      weights[j] -= float(rate * mHat / (std::sqrt(vHat) + epsilon));
+    }
+    if (epoch % 10 == 0)
+      fprintf(stderr, "\repoch %d loss %.6f", epoch, last);
+  }
+  double seconds = since(tuning);
+  fprintf(stderr, "\r%d epochs, loss %.6f -> %.6f, %.2f s per epoch on %d threads\n", epoch, initial, last,
+          seconds / std::max(epoch, 1), threads);
+
+  EvalWeights result[2] = {EVAL_WEIGHTS[STANDARD_VARIANT], EVAL_WEIGHTS[REVEAL_VARIANT]};
+  std::string source[2] = {EVAL_WEIGHTS_SOURCE[STANDARD_VARIANT], EVAL_WEIGHTS_SOURCE[REVEAL_VARIANT]};
+  for (int t = PAWN; t < KING; t++)
+    result[data.variant].piece[t] = int(std::lround(weights[t]));
+  // standard positions have no hidden feature; keep the value as it was
+  if (data.variant == REVEAL_VARIANT)
+    result[data.variant].hidden = int(std::lround(weights[HIDDEN_FEATURE]));
+  char note[128];
+  snprintf(note, sizeof(note), "tuned on %zu positions, loss %.6f", data.size, last);
+  source[data.variant] = note;
+  const EvalWeights& w = result[data.variant];
+  printf("%s: pawn %d knight %d bishop %d rook %d queen %d hidden %d\n", name, w.piece[PAWN], w.piece[KNIGHT],
+         w.piece[BISHOP], w.piece[ROOK], w.piece[QUEEN], w.hidden);
+  return writeHeader(headerPath, result, source) ? 0 : 1;
+}
+
+}
+
+int main(int argc, char** argv) {
+  std::string command = (argc > 1) ? argv[1] : "";
+  auto threadsArg = [&](int i) {
+    int threads = (argc > i) ? atoi(argv[i]) : 0;
+    return threads > 0 ? threads : int(std::max(1u, std::thread::hardware_concurrency()));
+  };
+  if (command == "play" && argc >= 4) {
+    std::string variant = argv[3];
+    if (variant != StandardVariant::NAME && variant != RevealVariant::NAME) {
+      fprintf(stderr, "unknown variant %s\n", argv[3]);
+      return 1;
+    }
+    int games = (argc > 4) ? atoi(argv[4]) : 1000;
+    int depth = (argc > 6) ? atoi(argv[6]) : 4;
+    return play(argv[2], variant == RevealVariant::NAME ? REVEAL_VARIANT : STANDARD_VARIANT, std::max(1, games),
+                threadsArg(5), std::max(1, depth));
+  }
+  if (command == "tune" && argc >= 4) {
+    signal(SIGINT, [](int) { interrupted = true; });
+    int epochs = (argc > 5) ? atoi(argv[5]) : 2000;
+    return tune(argv[2], argv[3], threadsArg(4), std::max(1, epochs));
+  }
+  fprintf(stderr, "usage: eval_tuner play <positions.bin> <standard|reveal> [games] [threads] [depth]\n"
+                  "       eval_tuner tune <positions.bin> <evalWeights.hpp> [threads] [epochs]\n");
+  return 1;
+}
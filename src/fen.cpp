@@ -0,0 +1,138 @@
+#include <cstring>
+#include <sstream>
+
+#include "../header/fen.hpp"
+
+namespace {
+
+const char PIECE_LETTERS[] = "pnbrqk";
+
+bool homeRow(PieceColor color, int row) {
+  return color == WHITE ? row <= 1 : row >= 6;
+}
+
+}
+
+Board* boardFromFen(const std::string& fen, VariantId variant, PieceColor& turn,
+                    int& halfmoveClock, std::string& error) {
+  std::istringstream in(fen);
+  std::string placement, side, castling, enPassant;
+  int fullmove = 1;
+  halfmoveClock = 0;
+  if (!(in >> placement >> side)) {
+    error = "missing fields";
+    return nullptr;
+  }
+  in >> castling >> enPassant >> halfmoveClock >> fullmove;
+  if (side != "w" && side != "b") {
+    error = "bad side to move";
+    return nullptr;
+  }
+  turn = (side == "w") ? WHITE : BLACK;
+
+  Board* board = new Board(variant);
+  int kings[2] = {0, 0};
+  int row = 7, col = 0;
+  for (char c : placement) {
+    if (c == '/') {
+      if (col != 8 || row == 0)
+        break;
+      row--;
+      col = 0;
+    }
+    else if (c >= '1' && c <= '8') {
+      col += c - '0';
+    }
+    else {
+      char lower = (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+      const char* found = lower ? strchr(PIECE_LETTERS, lower) : nullptr;
+      if (!found || col > 7) {
+        col = 9; // forces the error below
+        break;
+      }
+      PieceColor color = (c == lower) ? BLACK : WHITE;
+      PieceType type = PieceType(found - PIECE_LETTERS);
+      kings[color] += (type == KING);
+      board->addPiece(type, color, row, col++);
+    }
+    if (col > 8)
+      break;
+  }
+  if (row != 0 || col != 8 || kings[WHITE] != 1 || kings[BLACK] != 1) {
+    delete board;
+    error = "bad piece placement";
+    return nullptr;
+  }
+
+  // everything starts unmoved; mark what FEN says (or implies) has moved
+  for (int r = 0; r < 8; r++) {
+    for (int c = 0; c < 8; c++) {
+      if (!board->isOccupied(r, c))
+        continue;
+      PieceColor color = board->getColor(r, c);
+      PieceType type = board->getPiece(r, c)->getType();
+      bool unmoved;
+      if (variant == REVEAL_VARIANT) {
+        unmoved = homeRow(color, r);
+      }
+      else if (type == PAWN) {
+        unmoved = (r == (color == WHITE ? 1 : 6));
+      }
+      else {
+        int backRank = (color == WHITE) ? 0 : 7;
+        auto has = [&](char right) {
+          return castling.find(color == WHITE ? right : char(right - 'A' + 'a')) != std::string::npos;
+        };
+        bool kingSide = has('K'), queenSide = has('Q');
+        unmoved = r == backRank &&
+          ((type == KING && c == 4 && (kingSide || queenSide)) ||
+           (type == ROOK && c == 7 && kingSide) ||
+           (type == ROOK && c == 0 && queenSide));
+      }
+      if (!unmoved)
+        board->pieceSetMoved(r, c);
+    }
+  }
+  return board;
+}
+
+std::string boardToFen(const Board& board, PieceColor turn, int halfmoveClock, int fullmove) {
+  std::string fen;
+  for (int row = 7; row >= 0; row--) {
+    int empty = 0;
+    for (int col = 0; col < 8; col++) {
+      if (!board.isOccupied(row, col)) {
+        empty++;
+        continue;
+      }
+      if (empty)
+        fen += char('0' + empty);
+      empty = 0;
+      char letter = PIECE_LETTERS[board.getPiece(row, col)->getType()];
+      fen += (board.getColor(row, col) == WHITE) ? char(letter - 'a' + 'A') : letter;
+    }
+    if (empty)
+      fen += char('0' + empty);
+    if (row)
+      fen += '/';
+  }
+
+  fen += (turn == WHITE) ? " w " : " b ";
+  std::string castling;
+  for (PieceColor color : {WHITE, BLACK}) {
+    int backRank = (color == WHITE) ? 0 : 7;
+    auto unmoved = [&](int col, PieceType type) {
+      return board.isOccupied(backRank, col) && board.getColor(backRank, col) == color &&
+        board.getPiece(backRank, col)->getType() == type && !board.pieceMoved(backRank, col);
+    };
+    if (!unmoved(4, KING))
+      continue;
+    if (unmoved(7, ROOK))
+      castling += (color == WHITE) ? 'K' : 'k';
+    if (unmoved(0, ROOK))
+      castling += (color == WHITE) ? 'Q' : 'q';
+  }
+  fen += castling.empty() ? "-" : castling;
+  fen += " - " + std::to_string(halfmoveClock) + " " + std::to_string(fullmove);
+  return fen;
+}
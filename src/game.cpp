@@ -1,6 +1,44 @@
+#include <algorithm>
+
 #include "../header/game.hpp"
+#include "../header/legalMoves.hpp"
+#include "../header/zobrist.hpp"
+#include "../header/metrics.hpp"
+#include "../header/trace.hpp"
+
+namespace {
+
+const metrics::Histogram moveGenTime("game_move_generation_seconds", "Legal move generation for one piece.");
+const metrics::Histogram evaluateTime("game_state_evaluation_seconds", "Check, mate and draw detection after a move.");
+
+}
 
-Game::Game(Board* board) : board(board), currTurn(WHITE), state(INPROGRESS) {}
+Game::Game(Board* board) : board(board), currTurn(WHITE), state(INPROGRESS) {
+  startKey = positionKey();
+  history.push(startKey);
+}
+
+Game::Game(Board* board, PieceColor turn, int halfmoveClock)
+    : board(board), currTurn(turn), state(INPROGRESS), halfmoveClock(halfmoveClock) {
+  startKey = positionKey();
+  history.push(startKey);
+  evaluateGameState();
+}
+
+Game::Game(Board* board, PieceColor turn, int halfmoveClock, std::vector<Move> earlier, DrawReason drawReason)
+    : Game(board, turn, halfmoveClock) {
+  this->earlier = std::move(earlier);
+  if (drawReason == REPETITION && !isGameOver()) {
+    state = DRAW;
+    this->drawReason = REPETITION;
+  }
+}
+
+Game::~Game() {
+  // undone captures are back on the board, which owns them
+  for (int i = 0; i < ply; i++)
+    delete records[i].undo.captured;
+}
 
 PieceColor Game::getCurrentTurn() const {
   return currTurn;
@@ -14,45 +52,150 @@ GameState Game::getGameState() const{
   return state;
 }
 
+DrawReason Game::getDrawReason() const {
+  return drawReason;
+}
+
+bool Game::isGameOver() const {
+  return state == CHECKMATE || state == DRAW;
+}
+
+int Game::getHalfmoveClock() const {
+  return halfmoveClock;
+}
+
+uint64_t Game::positionKey() const {
+  return board->hash() ^ (currTurn == BLACK ? zobrist::KEYS.side : 0);
+}
+
+PositionHistory& Game::getHistory() {
+  return history;
+}
+
 bool Game::isMoveLegal(int srcRow, int srcCol, int dstRow, int dstCol) {
+  if (isGameOver())
+    return false;
   if (!isCurrentPlayerPiece(srcRow, srcCol))
     return false;
   
-  std::vector<Position> moves = board->validMoves(srcRow, srcCol);
-  if (std::find(moves.begin(), moves.end(), Position(dstRow, dstCol)) != moves.end())
-    return true;
-  return false;
+  MoveList moves;
+  {
+    metrics::ScopedTimer timer(moveGenTime);
+    LegalMoves legal(*board, currTurn);
+    legal.generateFrom(squareOf(srcRow, srcCol), moves);
+  }
+  return moves.contains(Move(squareOf(srcRow, srcCol), squareOf(dstRow, dstCol)));
 }
 
 bool Game::makeMove(int srcRow, int srcCol, int dstRow, int dstCol) {
+  TRACE_SCOPE("Game::makeMove");
   if (!isMoveLegal(srcRow, srcCol, dstRow, dstCol))
     return false;
-  
-  PieceType type = board->getPieceType(srcRow, srcCol);
-
-  // Castling
-  if (type == KING && srcRow == dstRow && (dstCol == 6 || dstCol == 2)) {
-    if (dstCol == 6) { // king-side rook: (row=sr, col 7 -> 5)
-      if (board->isOccupied(srcRow, 7) && board->getPieceType(srcRow, 7) == ROOK) {
-        board->movePiece(srcRow, 7, srcRow, 5);
-        board->pieceSetMoved(srcRow, 5);
-      }
-    }
-    else { // queen-side rook: (row=sr, col 0 -> 3)
-      if (board->isOccupied(srcRow, 0) && board->getPieceType(srcRow, 0) == ROOK) {
-        board->movePiece(srcRow, 0, srcRow, 3);
-        board->pieceSetMoved(srcRow, 3);
-      }
-    }
-  }
+  truncate();
+
+  PlyRecord r;
+  r.move = Move(squareOf(srcRow, srcCol), squareOf(dstRow, dstCol));
+  r.before = status();
+  if (board->getPieceType(srcRow, srcCol) == PAWN || board->isOccupied(dstRow, dstCol))
+    halfmoveClock = 0;
+  else
+    halfmoveClock++;
 
-  // Move
-  board->movePiece(srcRow, srcCol, dstRow, dstCol);
+  // castling moves the rook too
+  withVariant(board->getVariant(), [&](auto v) { board->doMove<decltype(v)>(r.move, r.undo); });
   switchTurn();
+  r.key = positionKey();
+  history.push(r.key);
   evaluateGameState();
+  r.after = status();
+  records.push_back(r);
+  ply++;
+  revision++;
   return true;
 }
 
+bool Game::undo() {
+  if (ply == 0)
+    return false;
+  const PlyRecord& r = records[--ply];
+  withVariant(board->getVariant(), [&](auto v) { board->undoMove<decltype(v)>(r.move, r.undo); });
+  switchTurn();
+  history.pop();
+  restore(r.before);
+  refillHistory();
+  revision++;
+  return true;
+}
+
+bool Game::redo() {
+  if (ply == (int)records.size())
+    return false;
+  PlyRecord& r = records[ply++];
+  withVariant(board->getVariant(), [&](auto v) { board->doMove<decltype(v)>(r.move, r.undo); });
+  switchTurn();
+  history.push(r.key);
+  restore(r.after);
+  revision++;
+  return true;
+}
+
+bool Game::jumpTo(int target) {
+  target -= (int)earlier.size();
+  if (target < 0 || target > (int)records.size())
+    return false;
+  while (ply > target)
+    undo();
+  while (ply < target)
+    redo();
+  return true;
+}
+
+int Game::getPly() const {
+  return (int)earlier.size() + ply;
+}
+
+int Game::getLength() const {
+  return (int)(earlier.size() + records.size());
+}
+
+std::vector<Move> Game::getMoves() const {
+  std::vector<Move> moves;
+  moves.reserve(earlier.size() + ply);
+  moves.insert(moves.end(), earlier.begin(), earlier.end());
+  for (int i = 0; i < ply; i++)
+    moves.push_back(records[i].move);
+  return moves;
+}
+
+uint64_t Game::getRevision() const {
+  return revision;
+}
+
+Game::Status Game::status() const {
+  return Status{state, drawReason, halfmoveClock};
+}
+
+void Game::restore(const Status& s) {
+  state = s.state;
+  drawReason = s.drawReason;
+  halfmoveClock = s.halfmoveClock;
+}
+
+void Game::truncate() {
+  records.resize(ply);
+}
+
+void Game::refillHistory() {
+  // the ring forgot the oldest positions; only those since the last
+  // irreversible move can recur, so that window is all it has to hold
+  if (history.length() > std::min(ply, halfmoveClock))
+    return;
+  history.clear();
+  int from = std::max(0, ply - (PositionHistory::CAPACITY - 1));
+  for (int i = from; i <= ply; i++)
+    history.push(i == 0 ? startKey : records[i - 1].key);
+}
+
 bool Game::isCurrentPlayerPiece(int row, int col) const {
   if (!board->isOccupied(row, col))
     return false;
@@ -67,26 +210,10 @@ void Game::switchTurn() {
 }
 
 void Game::evaluateGameState() {
-  bool inCheck = board->kingInCheck(currTurn);
-  bool hasMove = false;
-
-  // Check all squares on the board
-  for (int i = 0; i < 8; i++) {
-    for (int j = 0; j < 8; ++j) {
-      if (!board->isOccupied(i, j)) 
-        continue;
-      if (board->getColor(i, j) != currTurn) 
-        continue;
-
-      std::vector<Position> moves = board->validMoves(i, j);
-      if (!moves.empty()) {
-        hasMove = true;
-        break;
-      }
-    }
-    if (hasMove)
-      break;
-  }
+  metrics::ScopedTimer timer(evaluateTime);
+  LegalMoves legal(*board, currTurn);
+  bool inCheck = legal.inCheck();
+  bool hasMove = legal.hasLegalMove();
 
   if (hasMove) {
     if (inCheck)
@@ -99,6 +226,19 @@ void Game::evaluateGameState() {
       state = CHECKMATE;
     } else {
       state = DRAW;
+      drawReason = STALEMATE;
     }
   }
+  if (state == CHECKMATE || state == DRAW)
+    return;
+
+  // all O(1): counters kept by Board and the hash history
+  if (history.count(positionKey()) >= 3)
+    drawReason = REPETITION;
+  else if (halfmoveClock >= 100)
+    drawReason = FIFTY_MOVES;
+  else if (board->insufficientMaterial())
+    drawReason = INSUFFICIENT_MATERIAL;
+  if (drawReason != NO_DRAW)
+    state = DRAW;
 }
\ No newline at end of file
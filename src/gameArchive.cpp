@@ -0,0 +1,484 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+#include "../header/gameArchive.hpp"
+#include "../header/bitboard.hpp"
+#include "../header/legalMoves.hpp"
+#include "../header/logger.hpp"
+#include "../header/variant.hpp"
+
+namespace {
+
+// far above any real game; a longer frame is corruption, not a torn append
+constexpr uint64_t MAX_RECORD = 1 << 20;
+
+void putVarint(std::string& out, uint64_t v) {
+  while (v >= 0x80) {
+    out += char(v | 0x80);
+    v >>= 7;
+  }
+  out += char(v);
+}
+
+bool getVarint(std::string_view& in, uint64_t& v) {
+  v = 0;
+  for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+    uint8_t byte = uint8_t(in[0]);
+    in.remove_prefix(1);
+    v |= uint64_t(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool getString(std::string_view& in, std::string& s) {
+  uint64_t length;
+  if (!getVarint(in, length) || length > in.size())
+    return false;
+  s.assign(in.data(), length);
+  in.remove_prefix(length);
+  return true;
+}
+
+// LZMA style range coder, used only with uniform symbols: encode(s, n)
+// narrows the range to the s-th of n equal parts. low + range never passes
+// 2^32, so the first output byte is always 0 and is not stored.
+class RangeEncoder {
+  private:
+    std::string& out;
+    size_t start;
+    uint64_t low = 0;
+    uint32_t range = 0xFFFFFFFF;
+    uint8_t cache = 0;
+    uint64_t cacheSize = 1;
+
+    void shiftLow() {
+      if (uint32_t(low) < 0xFF000000u || (low >> 32) != 0) {
+        uint8_t carry = uint8_t(low >> 32);
+        uint8_t temp = cache;
+        do {
+          out += char(uint8_t(temp + carry));
+          temp = 0xFF;
+        } while (--cacheSize != 0);
+        cache = uint8_t(low >> 24);
+      }
+      cacheSize++;
+      low = (low & 0x00FFFFFF) << 8;
+    }
+  public:
+    explicit RangeEncoder(std::string& out) : out(out), start(out.size()) {}
+    void encode(uint32_t symbol, uint32_t n) {
+      range /= n;
+      low += uint64_t(symbol) * range;
+      while (range < (1u << 24)) {
+        range <<= 8;
+        shiftLow();
+      }
+    }
+    void finish() {
+      for (int i = 0; i < 5; i++)
+        shiftLow();
+      out.erase(start, 1);
+      // trailing zero bytes are implied: the decoder reads zeros past the end
+      while (out.size() > start && out.back() == 0)
+        out.pop_back();
+    }
+};
+
+class RangeDecoder {
+  private:
+    std::string_view in;
+    uint32_t range = 0xFFFFFFFF;
+    uint32_t code = 0;
+
+    uint8_t next() {
+      if (in.empty())
+        return 0;
+      uint8_t byte = uint8_t(in[0]);
+      in.remove_prefix(1);
+      return byte;
+    }
+  public:
+    explicit RangeDecoder(std::string_view in) : in(in) {
+      for (int i = 0; i < 4; i++)
+        code = (code << 8) | next();
+    }
+    // false on corrupt input
+    bool decode(uint32_t n, uint32_t& symbol) {
+      range /= n;
+      symbol = code / range;
+      if (symbol >= n)
+        return false;
+      code -= symbol * range;
+      while (range < (1u << 24)) {
+        range <<= 8;
+        code = (code << 8) | next();
+      }
+      return true;
+    }
+};
+
+// The legal moves of a position as target bitboards by origin square. A
+// move's archive index is its rank in (from, to) order, which is a prefix
+// popcount here, so nothing is sorted; the order is part of the file format.
+class Choices {
+  private:
+    Bitboard targets[64] = {};
+    Bitboard froms = 0;
+    int total = 0;
+  public:
+    void fill(const Board& board, PieceColor side) {
+      for (Bitboard b = froms; b;)
+        targets[popLsb(b)] = 0;
+      MoveList list;
+      LegalMoves(board, side).generate(list);
+      froms = 0;
+      for (const Move& m : list) {
+        targets[m.from] |= Bitboard(1) << m.to;
+        froms |= Bitboard(1) << m.from;
+      }
+      total = list.size();
+    }
+    int size() const { return total; }
+    // -1 if move is not legal
+    int indexOf(Move move) const {
+      if (!(targets[move.from] & (Bitboard(1) << move.to)))
+        return -1;
+      int index = popCount(targets[move.from] & ((Bitboard(1) << move.to) - 1));
+      for (Bitboard b = froms & ((Bitboard(1) << move.from) - 1); b;)
+        index += popCount(targets[popLsb(b)]);
+      return index;
+    }
+    Move at(int index) const {
+      for (Bitboard b = froms; b;) {
+        int from = popLsb(b);
+        int count = popCount(targets[from]);
+        if (index < count) {
+          Bitboard t = targets[from];
+          while (index--)
+            t &= t - 1;
+          return Move(from, lsb(t));
+        }
+        index -= count;
+      }
+      return Move();
+    }
+};
+
+void play(Board& board, Move move) {
+  MoveUndo undo;
+  board.doMove<RevealVariant>(move, undo);
+  delete undo.captured;
+}
+
+struct Header {
+  std::string white;
+  std::string black;
+  int64_t finishedAt = 0;
+  GameOutcome outcome = DRAWN;
+  uint64_t plies = 0;
+};
+
+bool parseHeader(std::string_view& in, Header& h) {
+  uint64_t zigzag, outcome;
+  if (!getString(in, h.white) || !getString(in, h.black) || !getVarint(in, zigzag) ||
+      !getVarint(in, outcome) || outcome > DRAWN || !getVarint(in, h.plies))
+    return false;
+  h.finishedAt = int64_t(zigzag >> 1) ^ -int64_t(zigzag & 1);
+  h.outcome = GameOutcome(outcome);
+  return true;
+}
+
+// true if bytes is whole records with parsing headers, up to its end
+bool wholeRecords(std::string_view bytes) {
+  while (!bytes.empty()) {
+    uint64_t length;
+    Header h;
+    if (!getVarint(bytes, length) || length > MAX_RECORD || length > bytes.size())
+      return false;
+    std::string_view record = bytes.substr(0, length);
+    if (!parseHeader(record, h))
+      return false;
+    bytes.remove_prefix(length);
+  }
+  return true;
+}
+
+// the first byte after a bad frame's start from which whole records run to
+// the end, or bytes.size() if there is none
+size_t resync(std::string_view bytes) {
+  for (size_t at = 1; at < bytes.size(); at++)
+    if (wholeRecords(bytes.substr(at)))
+      return at;
+  return bytes.size();
+}
+
+}
+
+bool GameArchive::encode(const ArchivedGame& game, std::string& record) {
+  record.clear();
+  putVarint(record, game.white.size());
+  record += game.white;
+  putVarint(record, game.black.size());
+  record += game.black;
+  putVarint(record, (uint64_t(game.finishedAt) << 1) ^ uint64_t(game.finishedAt >> 63));
+  putVarint(record, uint64_t(game.outcome));
+  putVarint(record, game.moves.size());
+
+  RangeEncoder coder(record);
+  coder.encode(RevealLayout::rank(game.layout.white), RevealLayout::ARRANGEMENTS);
+  coder.encode(RevealLayout::rank(game.layout.black), RevealLayout::ARRANGEMENTS);
+  RevealBoard board(game.layout);
+  PieceColor side = WHITE;
+  Choices legal;
+  for (Move move : game.moves) {
+    legal.fill(board, side);
+    int index = legal.indexOf(move);
+    if (index < 0)
+      return false;
+    if (legal.size() > 1)
+      coder.encode(uint32_t(index), uint32_t(legal.size()));
+    play(board, move);
+    side = (side == WHITE) ? BLACK : WHITE;
+  }
+  coder.finish();
+  return true;
+}
+
+bool GameArchive::decode(std::string_view record, ArchivedGame& out) {
+  Header h;
+  if (!parseHeader(record, h))
+    return false;
+  out.white = std::move(h.white);
+  out.black = std::move(h.black);
+  out.finishedAt = h.finishedAt;
+  out.outcome = h.outcome;
+
+  RangeDecoder coder(record);
+  uint32_t white, black;
+  if (!coder.decode(RevealLayout::ARRANGEMENTS, white) || !coder.decode(RevealLayout::ARRANGEMENTS, black))
+    return false;
+  RevealLayout::unrank(white, out.layout.white);
+  RevealLayout::unrank(black, out.layout.black);
+
+  RevealBoard board(out.layout);
+  PieceColor side = WHITE;
+  Choices legal;
+  out.moves.clear();
+  out.moves.reserve(h.plies);
+  for (uint64_t ply = 0; ply < h.plies; ply++) {
+    legal.fill(board, side);
+    uint32_t index = 0;
+    if (legal.size() == 0 || (legal.size() > 1 && !coder.decode(uint32_t(legal.size()), index)))
+      return false;
+    Move move = legal.at(int(index));
+    out.moves.push_back(move);
+    play(board, move);
+    side = (side == WHITE) ? BLACK : WHITE;
+  }
+  return true;
+}
+
+GameArchive::GameArchive(std::string path) : path(std::move(path)) {}
+
+GameArchive::~GameArchive() {
+  if (fd >= 0)
+    close(fd);
+}
+
+bool GameArchive::open(std::string& error) {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  fd = ::open(path.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    error = path + ": " + strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    error = path + ": " + strerror(errno);
+    return false;
+  }
+  uint64_t size = uint64_t(st.st_size);
+
+  // Headers only. A record that does not parse keeps its id, unreadable,
+  // and is reported: a bad header spans its own frame, a bad or overlong
+  // frame runs to the next byte from which whole records reach the end of
+  // the file. With no such byte the frame was a torn append and is cut off.
+  std::ifstream in(path, std::ios::binary);
+  std::string record;
+  uint64_t offset = 0;
+  offsets.assign(1, 0);
+  while (offset < size) {
+    uint64_t length = 0;
+    int shift = 0, c = 0, used = 0;
+    while ((c = in.get()) != EOF && shift < 64) {
+      used++;
+      length |= uint64_t(c & 0x7F) << shift;
+      shift += 7;
+      if (!(c & 0x80))
+        break;
+    }
+    if (c == EOF || (c & 0x80) || length > MAX_RECORD || offset + used + length > size) {
+      std::string rest(size - offset, '\0');
+      if (pread(fd, &rest[0], rest.size(), (off_t)offset) != (ssize_t)rest.size())
+        break;
+      uint64_t next = resync(rest);
+      if (next == rest.size())
+        break;
+      logLine("[archive] %s: bad frame at byte %llu, kept as unreadable game %zu\n", path.c_str(),
+              (unsigned long long)offset, offsets.size() - 1);
+      offset += next;
+      offsets.push_back(offset);
+      in.clear();
+      in.seekg((std::streamoff)offset);
+      continue;
+    }
+    record.resize(length);
+    if (!in.read(&record[0], length))
+      break;
+    std::string_view view(record);
+    Header h;
+    if (parseHeader(view, h))
+      index(offsets.size() - 1, h.white, h.black);
+    else
+      logLine("[archive] %s: game %zu at byte %llu does not parse, skipped\n", path.c_str(), offsets.size() - 1,
+              (unsigned long long)offset);
+    offset += used + length;
+    offsets.push_back(offset);
+  }
+  if (offset < size) {
+    // a corrupt length can look like a torn append too: keep the bytes
+    std::string tail(size - offset, '\0');
+    std::string saved = path + ".tail";
+    std::ofstream out(saved, std::ios::binary | std::ios::app);
+    bool kept = pread(fd, &tail[0], tail.size(), (off_t)offset) == (ssize_t)tail.size() &&
+                out.write(tail.data(), tail.size()).flush();
+    if (!kept) {
+      error = saved + ": could not save the " + std::to_string(tail.size()) + " bytes after the last record";
+      return false;
+    }
+    logLine("[archive] %s: cut %zu bytes after the last whole record, appended to %s\n", path.c_str(),
+            tail.size(), saved.c_str());
+    if (ftruncate(fd, (off_t)offset) != 0) {
+      error = path + ": " + strerror(errno);
+      return false;
+    }
+  }
+  return true;
+}
+
+void GameArchive::index(uint64_t id, const std::string& white, const std::string& black) {
+  for (const std::string* user : {&white, &black}) {
+    Postings& p = byUser[*user];
+    if (p.count > 0 && id == p.last)
+      continue;   // a game against oneself is listed once
+    putVarint(p.deltas, p.count ? id - p.last : id);
+    p.last = id;
+    p.count++;
+  }
+}
+
+int64_t GameArchive::append(const ArchivedGame& game) {
+  std::string body, framed;
+  if (!encode(game, body) || body.size() > MAX_RECORD)
+    return -1;
+  putVarint(framed, body.size());
+  framed += body;
+
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  if (fd < 0)
+    return -1;
+  size_t done = 0;
+  while (done < framed.size()) {
+    ssize_t n = write(fd, framed.data() + done, framed.size() - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  if (done < framed.size() || fdatasync(fd) != 0) {
+    if (ftruncate(fd, (off_t)offsets.back()) != 0) {
+      close(fd);
+      fd = -1;
+    }
+    return -1;
+  }
+  uint64_t id = offsets.size() - 1;
+  offsets.push_back(offsets.back() + framed.size());
+  index(id, game.white, game.black);
+  return int64_t(id);
+}
+
+bool GameArchive::readRecord(uint64_t id, std::string& record) const {
+  uint64_t begin, end;
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    if (id + 1 >= offsets.size())
+      return false;
+    begin = offsets[id];
+    end = offsets[id + 1];
+  }
+  record.resize(end - begin);
+  if (pread(fd, &record[0], record.size(), (off_t)begin) != (ssize_t)record.size())
+    return false;
+  std::string_view view(record);
+  uint64_t length;
+  if (!getVarint(view, length))
+    return false;
+  record.erase(0, record.size() - view.size());
+  return true;
+}
+
+bool GameArchive::read(uint64_t id, ArchivedGame& out) const {
+  std::string record;
+  return readRecord(id, record) && decode(record, out);
+}
+
+bool GameArchive::summary(uint64_t id, Summary& out) const {
+  std::string record;
+  if (!readRecord(id, record))
+    return false;
+  std::string_view view(record);
+  Header h;
+  if (!parseHeader(view, h))
+    return false;
+  out = Summary{id, std::move(h.white), std::move(h.black), h.finishedAt, h.outcome, uint32_t(h.plies)};
+  return true;
+}
+
+std::vector<uint64_t> GameArchive::gamesOf(std::string_view user, size_t count, uint64_t before) const {
+  std::vector<uint64_t> ids;
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  auto it = byUser.find(std::string(user));
+  if (it == byUser.end())
+    return ids;
+  std::string_view deltas(it->second.deltas);
+  uint64_t id = 0, gap;
+  ids.reserve(it->second.count);
+  while (getVarint(deltas, gap)) {
+    id += gap;
+    if (id >= before)
+      break;
+    ids.push_back(id);
+  }
+  lock.unlock();
+  std::reverse(ids.begin(), ids.end());
+  if (ids.size() > count)
+    ids.resize(count);
+  return ids;
+}
+
+size_t GameArchive::size() const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return offsets.size() - 1;
+}
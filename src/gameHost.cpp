@@ -0,0 +1,185 @@
+#include <pthread.h>
+
+#include <algorithm>
+
+#include "../header/gameHost.hpp"
+#include "../header/logger.hpp"
+#include "../header/metrics.hpp"
+#include "../header/zobrist.hpp"
+
+namespace {
+
+const metrics::Gauge activeRooms("game_rooms_active", "Rooms with a game in progress.");
+const metrics::Gauge hibernatedRooms("game_rooms_hibernated", "Rooms kept as a snapshot until their next request.");
+const metrics::Counter wokenRooms("game_rooms_woken_total", "Hibernated rooms rebuilt for a request.");
+
+}
+
+GameHost::GameHost(Renderer render, uint32_t shard, uint32_t shards)
+  : render(std::move(render)), processShard(shard), processShards(shards) {}
+
+GameHost::~GameHost() {
+  {
+    std::lock_guard<std::mutex> lock(sweepMutex);
+    stopping = true;
+  }
+  sweepWake.notify_all();
+  if (sweeper.joinable())
+    sweeper.join();
+}
+
+int64_t GameHost::nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t GameHost::shardOf(uint32_t id, uint32_t shards) {
+  // hashed, so consecutive rooms land on different processes
+  uint64_t state = id;
+  return shards <= 1 ? 0 : uint32_t(zobrist::splitmix64(state) % shards);
+}
+
+std::shared_ptr<Room> GameHost::create(std::string white, std::string black,
+                                       std::shared_ptr<EngineSeat> engine) {
+  uint32_t id;
+  do
+    id = nextId.fetch_add(1, std::memory_order_relaxed);
+  while (shardOf(id, processShards) != processShard);
+  auto room = std::make_shared<Room>(id, std::move(white), std::move(black), std::move(engine));
+  room->state = render(*room);
+  room->lastUsed.store(nowMs(), std::memory_order_relaxed);
+  Shard& shard = shards[id % SHARDS];
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.rooms.emplace(id, room);
+  }
+  count.fetch_add(1, std::memory_order_relaxed);
+  activeRooms.add(1);
+  return room;
+}
+
+std::shared_ptr<Room> GameHost::find(uint32_t id) {
+  Shard& shard = shards[id % SHARDS];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  std::shared_ptr<Room> room;
+  auto it = shard.rooms.find(id);
+  if (it != shard.rooms.end())
+    room = it->second;
+  else {
+    auto h = shard.hibernated.find(id);
+    if (h == shard.hibernated.end())
+      return nullptr;
+    room = wake(id, h->second);
+    shard.hibernated.erase(h);
+    shard.rooms.emplace(id, room);
+  }
+  room->lastUsed.store(nowMs(), std::memory_order_relaxed);
+  return room;
+}
+
+bool GameHost::remove(uint32_t id) {
+  Shard& shard = shards[id % SHARDS];
+  std::shared_ptr<Room> room;
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.rooms.find(id);
+    if (it != shard.rooms.end()) {
+      room = std::move(it->second);
+      shard.rooms.erase(it);
+    }
+    else if (!shard.hibernated.erase(id))
+      return false;
+  }
+  count.fetch_sub(1, std::memory_order_relaxed);
+  (room ? activeRooms : hibernatedRooms).add(-1);
+  return true;
+}
+
+// room is locked and held by the host alone
+GameHost::Hibernated GameHost::hibernate(Room& room) {
+  Hibernated h;
+  h.position = PositionSnapshot::capture(room.board, room.game);
+  h.layout = room.board.layout().index();
+  h.moves = room.game.getMoves();
+  h.moves.shrink_to_fit();
+  h.white = room.white;
+  h.black = room.black;
+  h.engine = bool(room.engine);
+  h.engineColor = room.engine ? room.engine->color : WHITE;
+  h.movetime = room.engine ? room.engine->movetime : 0;
+  h.hashMegabytes = room.engine ? room.engine->hashMegabytes : 0;
+  h.resultRecorded = room.resultRecorded;
+  return h;
+}
+
+// shard locked; the board and game take microseconds, an engine seat also
+// allocates its table
+std::shared_ptr<Room> GameHost::wake(uint32_t id, Hibernated& h) const {
+  std::shared_ptr<EngineSeat> seat;
+  if (h.engine)
+    seat = std::make_shared<EngineSeat>(h.engineColor, h.movetime, h.hashMegabytes);
+  auto room = std::make_shared<Room>(id, std::move(h.white), std::move(h.black), std::move(seat),
+                                     RevealLayout::fromIndex(h.layout), h.position, std::move(h.moves));
+  if (room->game.positionKey() != h.position.key)
+    logLine("[rooms] room %u woke to a different position than it hibernated in\n", id);
+  room->resultRecorded = h.resultRecorded;
+  room->state = render(*room);
+  wokenRooms.add();
+  activeRooms.add(1);
+  hibernatedRooms.add(-1);
+  return room;
+}
+
+size_t GameHost::hibernateIdle(std::chrono::milliseconds idle) {
+  int64_t before = nowMs() - idle.count();
+  size_t hibernated = 0;
+  for (Shard& shard : this->shards) {
+    // freed outside the shard lock
+    std::vector<std::shared_ptr<Room>> asleep;
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (auto it = shard.rooms.begin(); it != shard.rooms.end();) {
+        Room& room = *it->second;
+        // only find() hands out new references, under this lock
+        if (room.lastUsed.load(std::memory_order_relaxed) > before || it->second.use_count() != 1) {
+          ++it;
+          continue;
+        }
+        {
+          std::lock_guard<std::mutex> roomLock(room.mutex);
+          shard.hibernated.emplace(it->first, hibernate(room));
+        }
+        asleep.push_back(std::move(it->second));
+        it = shard.rooms.erase(it);
+      }
+    }
+    hibernated += asleep.size();
+  }
+  activeRooms.add(-int64_t(hibernated));
+  hibernatedRooms.add(int64_t(hibernated));
+  return hibernated;
+}
+
+void GameHost::hibernateAfter(std::chrono::milliseconds idle) {
+  std::lock_guard<std::mutex> lock(sweepMutex);
+  if (sweeper.joinable())
+    return;
+  sweeper = std::thread([this, idle] {
+    pthread_setname_np(pthread_self(), "room-sweeper");
+    auto period = std::max(idle / 4, std::chrono::milliseconds(100));
+    std::unique_lock<std::mutex> lock(sweepMutex);
+    while (!sweepWake.wait_for(lock, period, [this] { return stopping; })) {
+      lock.unlock();
+      hibernateIdle(idle);
+      lock.lock();
+    }
+  });
+}
+
+size_t GameHost::size() const {
+  return count.load(std::memory_order_relaxed);
+}
+
+void GameHost::refresh(Room& room) const {
+  room.state = render(room);
+}
@@ -0,0 +1,64 @@
+// HTTP request parser microbenchmark.
+// usage: http_bench [corpus_dir] [iterations]   (default fuzz/http, 200000)
+// Prints ns per parse for every corpus file. Each iteration copies the
+// request into a scratch buffer first (chunked bodies are decoded in place),
+// and that copy is included in the time.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../header/httpRequest.hpp"
+
+// keeps the parse loop from being optimized away
+static volatile size_t sink;
+
+int main(int argc, char** argv) {
+  namespace fs = std::filesystem;
+  const char* dir = (argc > 1) ? argv[1] : "fuzz/http";
+  long iterations = (argc > 2) ? std::atol(argv[2]) : 200000;
+
+  std::vector<fs::path> files;
+  std::error_code ec;
+  for (const auto& entry : fs::directory_iterator(dir, ec))
+    if (entry.is_regular_file())
+      files.push_back(entry.path());
+  if (files.empty()) {
+    fprintf(stderr, "no corpus files in %s\n", dir);
+    return 1;
+  }
+  std::sort(files.begin(), files.end());
+
+  double total = 0;
+  char scratch[65536];
+  for (const fs::path& path : files) {
+    std::ifstream in(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (bytes.size() > sizeof(scratch))
+      continue;
+
+    HttpRequest req;
+    size_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++) {
+      memcpy(scratch, bytes.data(), bytes.size());
+      req.reset();
+      HttpRequest::Status st = req.parse(scratch, bytes.size());
+      checksum += st + req.path.size() + req.body.size();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+    total += ns;
+    sink = checksum;
+    printf("%-28s %5zu bytes  %8.1f ns/request  %s\n", path.filename().c_str(), bytes.size(), ns,
+           req.parse(scratch, bytes.size()) == HttpRequest::COMPLETE ? "complete" : "rejected");
+  }
+  printf("mean %.1f ns/request over %zu files\n", total / files.size(), files.size());
+  return 0;
+}
@@ -0,0 +1,38 @@
+// libFuzzer target for HttpRequest; seed it with fuzz/http:
+//   ./http_fuzz fuzz/http
+// Besides memory safety it checks that feeding a request in two pieces
+// parses to the same result as feeding it at once.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../header/httpRequest.hpp"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  std::vector<char> whole(data, data + size);
+  HttpRequest once;
+  HttpRequest::Status a = once.parse(whole.data(), whole.size());
+
+  std::vector<char> split(data, data + size);
+  HttpRequest twice;
+  size_t cut = size ? data[0] % size : 0;
+  HttpRequest::Status b = twice.parse(split.data(), cut);
+  if (b == HttpRequest::INCOMPLETE)
+    b = twice.parse(split.data(), size);
+
+  if (a != b)
+    abort();
+  if (a == HttpRequest::COMPLETE &&
+      (once.path != std::string_view(split.data() + (once.path.data() - whole.data()), once.path.size()) ||
+       once.body.size() != twice.body.size() ||
+       memcmp(once.body.data(), twice.body.data(), once.body.size()) != 0 ||
+       once.consumed() != twice.consumed()))
+    abort();
+  int value;
+  queryInt(once.query, "sr", value);
+  return 0;
+}
@@ -0,0 +1,307 @@
+#include <cstring>
+
+#include "../header/httpRequest.hpp"
+
+namespace {
+
+constexpr size_t MAX_CHUNK_LINE = 256;
+
+char lower(char c) {
+  return (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); i++)
+    if (lower(a[i]) != lower(b[i]))
+      return false;
+  return true;
+}
+
+// RFC 9110 token characters, as a lookup table
+struct TokenTable {
+  bool valid[256] = {};
+  constexpr TokenTable() {
+    for (int c = '0'; c <= '9'; c++)
+      valid[c] = true;
+    for (int c = 'a'; c <= 'z'; c++)
+      valid[c] = valid[c - 'a' + 'A'] = true;
+    const char extra[] = "!#$%&'*+-.^_`|~";
+    for (int i = 0; extra[i]; i++)
+      valid[(unsigned char)extra[i]] = true;
+  }
+};
+constexpr TokenTable TOKEN;
+
+bool isToken(char c) {
+  return TOKEN.valid[(unsigned char)c];
+}
+
+std::string_view trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+    s.remove_prefix(1);
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+    s.remove_suffix(1);
+  return s;
+}
+
+int hexValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  c = lower(c);
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+// position of "\r\n" in [from, length), or npos
+size_t findCrlf(const char* buffer, size_t from, size_t length) {
+  if (length < 2 || from > length - 2)
+    return std::string_view::npos;
+  const void* p = memmem(buffer + from, length - from, "\r\n", 2);
+  return p ? size_t(static_cast<const char*>(p) - buffer) : std::string_view::npos;
+}
+
+}
+
+void HttpRequest::reset() {
+  *this = HttpRequest();
+}
+
+size_t HttpRequest::consumed() const {
+  return readPos;
+}
+
+std::string_view HttpRequest::header(std::string_view name) const {
+  for (int i = 0; i < headerCount; i++)
+    if (equalsIgnoreCase(headers[i].name, name))
+      return headers[i].value;
+  return std::string_view();
+}
+
+HttpRequest::Status HttpRequest::parse(char* buffer, size_t length) {
+  if (stage == HEAD) {
+    // resume the blank line search where the last call stopped
+    size_t from = scanned > 3 ? scanned - 3 : 0;
+    const void* end = length > from ? memmem(buffer + from, length - from, "\r\n\r\n", 4) : nullptr;
+    if (!end) {
+      scanned = length;
+      return INCOMPLETE;
+    }
+    size_t headEnd = static_cast<const char*>(end) - buffer + 4;
+    Status s = parseHead(buffer, headEnd);
+    if (s != COMPLETE)
+      return s;
+  }
+
+  if (stage == FIXED_BODY) {
+    if (length - bodyStart < contentLength)
+      return INCOMPLETE;
+    body = std::string_view(buffer + bodyStart, contentLength);
+    readPos = bodyStart + contentLength;
+    stage = DONE;
+  }
+  if (stage != DONE)
+    return parseChunked(buffer, length);
+  return COMPLETE;
+}
+
+HttpRequest::Status HttpRequest::parseHead(char* buffer, size_t headEnd) {
+  std::string_view head(buffer, headEnd - 4);
+  size_t lineEnd = head.find("\r\n");
+  std::string_view line = head.substr(0, lineEnd);
+
+  // request line: METHOD SP target SP HTTP/1.x
+  size_t sp1 = line.find(' ');
+  size_t sp2 = (sp1 == std::string_view::npos) ? sp1 : line.find(' ', sp1 + 1);
+  if (sp1 == 0 || sp2 == std::string_view::npos || sp2 == sp1 + 1)
+    return INVALID;
+  method = line.substr(0, sp1);
+  for (char c : method)
+    if (!isToken(c))
+      return INVALID;
+  target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+  std::string_view version = line.substr(sp2 + 1);
+  if (version.size() != 8 || version.substr(0, 7) != "HTTP/1." || version[7] < '0' || version[7] > '9')
+    return INVALID;
+  minorVersion = version[7] - '0';
+  size_t q = target.find('?');
+  path = target.substr(0, q);
+  query = (q == std::string_view::npos) ? std::string_view() : target.substr(q + 1);
+
+  headerCount = 0;
+  bool hasLength = false, chunked = false;
+  while (lineEnd != std::string_view::npos) {
+    size_t start = lineEnd + 2;
+    lineEnd = head.find("\r\n", start);
+    line = head.substr(start, lineEnd == std::string_view::npos ? std::string_view::npos : lineEnd - start);
+    size_t colon = line.find(':');
+    if (colon == 0 || colon == std::string_view::npos || headerCount == MAX_HEADERS)
+      return INVALID;
+    HttpHeader& h = headers[headerCount++];
+    h.name = line.substr(0, colon);
+    for (char c : h.name)
+      if (!isToken(c))
+        return INVALID;
+    h.value = trim(line.substr(colon + 1));
+
+    if (equalsIgnoreCase(h.name, "Content-Length")) {
+      size_t n = 0;
+      if (hasLength || h.value.empty() || h.value.size() > 15)
+        return INVALID;
+      for (char c : h.value) {
+        if (c < '0' || c > '9')
+          return INVALID;
+        n = n * 10 + (c - '0');
+      }
+      contentLength = n;
+      hasLength = true;
+    }
+    else if (equalsIgnoreCase(h.name, "Transfer-Encoding")) {
+      // chunked must be the final coding; we support no others
+      if (!equalsIgnoreCase(h.value, "chunked"))
+        return INVALID;
+      chunked = true;
+    }
+  }
+  // both set is how request smuggling starts
+  if (hasLength && chunked)
+    return INVALID;
+
+  bodyStart = readPos = headEnd;
+  stage = chunked ? CHUNK_SIZE : FIXED_BODY;
+  return COMPLETE;
+}
+
+HttpRequest::Status HttpRequest::parseChunked(char* buffer, size_t length) {
+  for (;;) {
+    switch (stage) {
+    case CHUNK_SIZE: {
+      size_t end = findCrlf(buffer, readPos, length);
+      if (end == std::string_view::npos)
+        return (length - readPos > MAX_CHUNK_LINE) ? INVALID : INCOMPLETE;
+      size_t size = 0;
+      size_t i = readPos;
+      for (; i < end && hexValue(buffer[i]) >= 0; i++) {
+        if (i - readPos >= 15)
+          return INVALID;
+        size = size * 16 + hexValue(buffer[i]);
+      }
+      // chunk extensions after ';' are ignored
+      if (i == readPos || (i < end && buffer[i] != ';' && buffer[i] != ' ' && buffer[i] != '\t'))
+        return INVALID;
+      readPos = end + 2;
+      chunkLeft = size;
+      stage = size ? CHUNK_DATA : TRAILERS;
+      break;
+    }
+    case CHUNK_DATA: {
+      size_t available = length - readPos;
+      size_t n = available < chunkLeft ? available : chunkLeft;
+      // compact the decoded body over the chunk framing already parsed
+      memmove(buffer + bodyStart + bodyLength, buffer + readPos, n);
+      bodyLength += n;
+      readPos += n;
+      chunkLeft -= n;
+      if (chunkLeft)
+        return INCOMPLETE;
+      stage = CHUNK_END;
+      break;
+    }
+    case CHUNK_END:
+      if (length - readPos < 2)
+        return INCOMPLETE;
+      if (buffer[readPos] != '\r' || buffer[readPos + 1] != '\n')
+        return INVALID;
+      readPos += 2;
+      stage = CHUNK_SIZE;
+      break;
+    case TRAILERS: {
+      size_t end = findCrlf(buffer, readPos, length);
+      if (end == std::string_view::npos)
+        return INCOMPLETE;
+      bool last = (end == readPos);
+      readPos = end + 2;
+      if (last) {
+        body = std::string_view(buffer + bodyStart, bodyLength);
+        stage = DONE;
+        return COMPLETE;
+      }
+      break;
+    }
+    default:
+      return INVALID;
+    }
+  }
+}
+
+std::string_view queryValue(std::string_view query, std::string_view key) {
+  while (!query.empty()) {
+    size_t amp = query.find('&');
+    std::string_view pair = query.substr(0, amp);
+    if (pair.size() > key.size() && pair[key.size()] == '=' && pair.substr(0, key.size()) == key)
+      return pair.substr(key.size() + 1);
+    if (amp == std::string_view::npos)
+      break;
+    query.remove_prefix(amp + 1);
+  }
+  return std::string_view();
+}
+
+std::string queryText(std::string_view query, std::string_view key) {
+  std::string_view raw = queryValue(query, key);
+  std::string text;
+  text.reserve(raw.size());
+  for (size_t i = 0; i < raw.size(); i++) {
+    char c = raw[i];
+    if (c == '+') {
+      c = ' ';
+    } else if (c == '%' && i + 2 < raw.size()) {
+      int hi = hexValue(raw[i + 1]), lo = hexValue(raw[i + 2]);
+      if (hi >= 0 && lo >= 0) {
+        c = char(hi * 16 + lo);
+        i += 2;
+      }
+    }
+    text += c;
+  }
+  return text;
+}
+
+bool queryInt(std::string_view query, std::string_view key, int& value) {
+  std::string_view raw = queryValue(query, key);
+  if (raw.empty())
+    return false;
+  bool negative = false, digits = false, first = true;
+  long long n = 0;
+  for (size_t i = 0; i < raw.size(); i++) {
+    char c = raw[i];
+    if (c == '%') {
+      if (i + 2 >= raw.size())
+        return false;
+      int hi = hexValue(raw[i + 1]), lo = hexValue(raw[i + 2]);
+      if (hi < 0 || lo < 0)
+        return false;
+      c = char(hi * 16 + lo);
+      i += 2;
+    }
+    if (c == '-' && first) {
+      negative = true;
+      first = false;
+      continue;
+    }
+    first = false;
+    if (c < '0' || c > '9' || n > 1000000000)
+      return false;
+    n = n * 10 + (c - '0');
+    digits = true;
+  }
+  if (!digits)
+    return false;
+  n = negative ? -n : n;
+  if (n < -2147483648LL || n > 2147483647LL)
+    return false;
+  value = int(n);
+  return true;
+}
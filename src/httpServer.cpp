@@ -0,0 +1,507 @@
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "../header/httpServer.hpp"
+#include "../header/trace.hpp"
+
+namespace {
+
+// a worker stuck on a client that stopped reading gives up after this
+constexpr int SEND_TIMEOUT_SECONDS = 5;
+constexpr int LOW_PRIORITY_NICE = 10;
+
+const metrics::Counter acceptedConnections("http_connections_accepted_total", "Connections accepted.");
+const metrics::Counter badRequests("http_bad_requests_total", "Requests rejected as malformed or too large.");
+const metrics::Counter shedBudget("http_requests_shed_total", "Requests answered 503 instead of queued.",
+                                  "reason=\"latency_budget\"");
+const metrics::Counter shedPeer("http_requests_shed_total", "Requests answered 503 instead of queued.",
+                                "reason=\"peer_in_flight\"");
+const metrics::Counter shedShard("http_requests_shed_total", "Requests answered 503 instead of queued.",
+                                 "reason=\"shard_unavailable\"");
+const metrics::Counter handedOver("http_shard_handovers_total", "Requests passed between shards.",
+                                  "direction=\"sent\"");
+const metrics::Counter handedIn("http_shard_handovers_total", "Requests passed between shards.",
+                                "direction=\"received\"");
+const metrics::Counter handedInRejected("http_shard_handovers_total", "Requests passed between shards.",
+                                        "direction=\"rejected\"");
+const metrics::Gauge openConnections("http_open_connections", "Connections still sending their request.");
+const metrics::Gauge inFlight("http_requests_in_flight", "Requests queued or running on a worker.");
+const metrics::Gauge normalDepth("http_queue_depth", "Requests waiting for a worker.", "lane=\"normal\"");
+const metrics::Gauge engineDepth("http_queue_depth", "Requests waiting for a worker.", "lane=\"engine\"");
+
+std::string routeLabels(std::string_view method, std::string_view path) {
+  return "method=\"" + std::string(method) + "\",route=\"" + std::string(path) + "\"";
+}
+
+void sendSmall(int fd, const std::string& response) {
+  // best effort on a non-blocking socket; these fit in an empty send buffer
+  send(fd, response.data(), response.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+// abstract namespace: nothing to clean up when a shard exits
+socklen_t shardAddress(int port, int shard, sockaddr_un& addr) {
+  addr = sockaddr_un{};
+  addr.sun_family = AF_UNIX;
+  int n = snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "web_gui.%d.shard%d", port, shard);
+  return socklen_t(offsetof(sockaddr_un, sun_path) + 1 + n);
+}
+
+void reply(int fd, const char* status, int retryAfter) {
+  std::string response = std::string("HTTP/1.1 ") + status + "\r\n";
+  if (retryAfter > 0)
+    response += "Retry-After: " + std::to_string(retryAfter) + "\r\n";
+  response += "Content-Length: 0\r\nConnection: close\r\n\r\n";
+  sendSmall(fd, response);
+}
+
+}
+
+HttpServer::HttpServer(const HttpServerConfig& config) : config(config) {
+  fallbackRoute.reset(new Route{LANE_NORMAL,
+    [](int fd, const HttpRequest&) {
+      reply(fd, "404 Not Found", 0);
+      return false;
+    },
+    metrics::Histogram("http_request_duration_seconds", "Time spent in the handler.", "method=\"*\",route=\"*\"")});
+}
+
+HttpServer::~HttpServer() {
+  for (auto* pool : {&normalWorkers, &engineWorkers}) {
+    for (auto& w : *pool)
+      w->queue.close();
+    for (auto& w : *pool)
+      if (w->thread.joinable())
+        w->thread.join();
+  }
+  for (int fd : {ep, listenFd, wakeFd, shardFd})
+    if (fd >= 0)
+      close(fd);
+}
+
+void HttpServer::route(std::string_view method, std::string_view path, Lane lane, Handler handler) {
+  metrics::Histogram latency("http_request_duration_seconds", "Time spent in the handler.",
+                             routeLabels(method, path).c_str());
+  routes.add(method, path, Route{lane, std::move(handler), latency});
+}
+
+void HttpServer::fallback(Handler handler) {
+  fallbackRoute->handler = std::move(handler);
+}
+
+void HttpServer::placement(Placement placement) {
+  place = std::move(placement);
+}
+
+void HttpServer::post(std::function<void()> fn) {
+  {
+    std::lock_guard<std::mutex> lock(postMutex);
+    posted.push_back(std::move(fn));
+  }
+  uint64_t one = 1;
+  if (write(wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    perror("eventfd write");
+}
+
+void HttpServer::publish(Frame frame, uint32_t channel) {
+  post([this, frame, channel] { spectators.publish(frame, channel); });
+}
+
+void HttpServer::subscribe(int fd, Frame initial, uint32_t channel) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  epoll_event ev{};
+  ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  ev.data.fd = fd;
+  if (epoll_ctl(ep, EPOLL_CTL_MOD, fd, &ev) != 0)
+    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+  spectators.subscribe(fd, std::move(initial), channel);
+}
+
+int HttpServer::peerSlot(uint32_t peer) {
+  return int((peer * 2654435761u) >> 20) & (PEER_SLOTS - 1);
+}
+
+void HttpServer::startWorkers(std::vector<std::unique_ptr<Worker>>& pool, int count, int expectedServiceMs,
+                              bool lowPriority, const metrics::Gauge& depth) {
+  for (int i = 0; i < count; i++) {
+    pool.push_back(std::make_unique<Worker>(config.queueCapacity, std::chrono::milliseconds(expectedServiceMs)));
+    Worker& w = *pool.back();
+    w.depth = &depth;
+    w.thread = std::thread([this, &w, lowPriority] { workerLoop(w, lowPriority); });
+  }
+}
+
+void HttpServer::workerLoop(Worker& worker, bool lowPriority) {
+  pthread_setname_np(pthread_self(), lowPriority ? "engine-worker" : "http-worker");
+  // nice applies per thread on Linux
+  if (lowPriority)
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), LOW_PRIORITY_NICE);
+  Job job;
+  while (worker.queue.pop(job)) {
+    worker.depth->add(-1);
+    auto start = std::chrono::steady_clock::now();
+    {
+      TRACE_SCOPE("HttpServer::handle");
+      if (!job.route->handler(job.fd, job.request))
+        close(job.fd);
+    }
+    peerLoad[peerSlot(job.peer)].fetch_sub(1, std::memory_order_relaxed);
+    inFlight.add(-1);
+    auto took = std::chrono::steady_clock::now() - start;
+    job.route->latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(took).count());
+    worker.queue.recordService(std::chrono::duration_cast<std::chrono::microseconds>(took));
+    job = Job();
+  }
+}
+
+void HttpServer::dispatch(int fd, Connection& conn, const Route& route) {
+  if (route.lane == LANE_LOOP) {
+    metrics::ScopedTimer timer(route.latency);
+    if (!route.handler(fd, conn.request))
+      close(fd);
+    return;
+  }
+
+  std::atomic<int>& load = peerLoad[peerSlot(conn.peer)];
+  if (load.fetch_add(1, std::memory_order_relaxed) >= config.peerInFlight) {
+    load.fetch_sub(1, std::memory_order_relaxed);
+    shedPeer.add();
+    reply(fd, "503 Service Unavailable", 1);
+    close(fd);
+    return;
+  }
+
+  auto& pool = (route.lane == LANE_ENGINE) ? engineWorkers : normalWorkers;
+  int budgetMs = (route.lane == LANE_ENGINE) ? config.engineLatencyBudgetMs : config.latencyBudgetMs;
+  Worker* best = nullptr;
+  std::chrono::microseconds bestWait = std::chrono::microseconds::max();
+  for (auto& w : pool) {
+    auto wait = w->queue.estimatedWait();
+    if (wait < bestWait) {
+      bestWait = wait;
+      best = w.get();
+    }
+  }
+
+  Job job;
+  job.fd = fd;
+  job.buffer = std::move(conn.buffer);
+  job.request = conn.request;
+  job.route = &route;
+  job.peer = conn.peer;
+  if (best && bestWait <= std::chrono::milliseconds(budgetMs)) {
+    // workers write with blocking sends
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    timeval timeout{SEND_TIMEOUT_SECONDS, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (best->queue.tryPush(job)) {
+      best->depth->add(1);
+      inFlight.add(1);
+      return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  }
+
+  load.fetch_sub(1, std::memory_order_relaxed);
+  shedBudget.add();
+  int64_t waitMs = (bestWait == std::chrono::microseconds::max()) ? budgetMs : bestWait.count() / 1000;
+  reply(fd, "503 Service Unavailable", int(waitMs / 1000) + 1);
+  close(fd);
+}
+
+void HttpServer::closeConnection(int fd) {
+  if (fd < (int)connections.size() && connections[fd]) {
+    connections[fd].reset();
+    openConnections.add(-1);
+  }
+  close(fd);
+}
+
+void HttpServer::acceptAll() {
+  for (;;) {
+    sockaddr_in peer{};
+    socklen_t len = sizeof(peer);
+    int fd = accept4(listenFd, (sockaddr*)&peer, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        perror("accept");
+      return;
+    }
+    if (fd >= (int)connections.size())
+      connections.resize(fd + 1);
+    auto conn = std::make_unique<Connection>();
+    conn->buffer.reset(new char[config.requestBufferSize]);
+    conn->peer = peer.sin_addr.s_addr;
+    connections[fd] = std::move(conn);
+    acceptedConnections.add();
+    openConnections.add(1);
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.fd = fd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+  }
+}
+
+void HttpServer::readConnection(int fd) {
+  Connection& conn = *connections[fd];
+  bool eof = false;
+  for (;;) {
+    if (conn.length == config.requestBufferSize) {
+      badRequests.add();
+      reply(fd, "431 Request Header Fields Too Large", 0);
+      closeConnection(fd);
+      return;
+    }
+    ssize_t n = recv(fd, conn.buffer.get() + conn.length, config.requestBufferSize - conn.length, 0);
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      closeConnection(fd);
+      return;
+    }
+    // a client may half-close after sending its request
+    eof = (n == 0);
+    if (n <= 0)
+      break;
+    conn.length += n;
+  }
+
+  HttpRequest::Status st;
+  {
+    TRACE_SCOPE("HttpRequest::parse");
+    st = conn.request.parse(conn.buffer.get(), conn.length);
+  }
+  if (st == HttpRequest::INCOMPLETE) {
+    if (eof)
+      closeConnection(fd);
+    return;
+  }
+  if (st == HttpRequest::INVALID) {
+    badRequests.add();
+    reply(fd, "400 Bad Request", 0);
+    closeConnection(fd);
+    return;
+  }
+
+  // one request in flight per connection: stop watching it until answered
+  epoll_ctl(ep, EPOLL_CTL_DEL, fd, nullptr);
+  std::unique_ptr<Connection> owned = std::move(connections[fd]);
+  openConnections.add(-1);
+  if (place) {
+    int owner = place(owned->request);
+    if (owner >= 0 && owner < config.shards && owner != config.shard) {
+      handOver(fd, *owned, owner);
+      return;
+    }
+  }
+  const Route* route = routes.find(owned->request.method, owned->request.path);
+  dispatch(fd, *owned, route ? *route : *fallbackRoute);
+}
+
+bool HttpServer::bindShardSocket() {
+  shardFd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  sockaddr_un addr;
+  socklen_t len = shardAddress(config.port, config.shard, addr);
+  // the abstract namespace has no permissions: every datagram carries its
+  // sender's credentials, and receiveHandovers only takes our own uid's
+  int on = 1;
+  if (shardFd < 0 || setsockopt(shardFd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on)) < 0 ||
+      bind(shardFd, (sockaddr*)&addr, len) < 0) {
+    perror("shard socket");
+    return false;
+  }
+  return true;
+}
+
+// a datagram is the client address and then the request's bytes
+void HttpServer::handOver(int fd, Connection& conn, int owner) {
+  iovec parts[2] = {{&conn.peer, sizeof(conn.peer)}, {conn.buffer.get(), conn.length}};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  sockaddr_un addr;
+  msghdr msg{};
+  msg.msg_name = &addr;
+  msg.msg_namelen = shardAddress(config.port, owner, addr);
+  msg.msg_iov = parts;
+  msg.msg_iovlen = 2;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  if (sendmsg(shardFd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+    shedShard.add();
+    reply(fd, "503 Service Unavailable", 1);
+  }
+  else
+    handedOver.add();
+  // the owner holds its own reference to the connection now
+  close(fd);
+}
+
+void HttpServer::receiveHandovers() {
+  for (;;) {
+    auto conn = std::make_unique<Connection>();
+    conn->buffer.reset(new char[config.requestBufferSize]);
+    iovec parts[2] = {{&conn->peer, sizeof(conn->peer)}, {conn->buffer.get(), config.requestBufferSize}};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(ucred))];
+    msghdr msg{};
+    msg.msg_iov = parts;
+    msg.msg_iovlen = 2;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n = recvmsg(shardFd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        perror("recvmsg");
+      return;
+    }
+    int fd = -1;
+    bool trusted = false;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level != SOL_SOCKET)
+        continue;
+      if (cmsg->cmsg_type == SCM_CREDENTIALS) {
+        ucred cred;
+        memcpy(&cred, CMSG_DATA(cmsg), sizeof(cred));
+        trusted = (cred.uid == getuid());
+      } else if (cmsg->cmsg_type == SCM_RIGHTS) {
+        // a sender may pass several; only ours pass exactly one
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; i++) {
+          int passed;
+          memcpy(&passed, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+          if (fd < 0)
+            fd = passed;
+          else
+            close(passed);
+        }
+      }
+    }
+    if (!trusted) {
+      // another user's process: neither its bytes nor its peer address count
+      handedInRejected.add();
+      if (fd >= 0)
+        close(fd);
+      continue;
+    }
+    if (fd < 0)
+      continue;
+    handedIn.add();
+    conn->length = size_t(n) - std::min(size_t(n), sizeof(conn->peer));
+    if (size_t(n) < sizeof(conn->peer) || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) ||
+        conn->request.parse(conn->buffer.get(), conn->length) != HttpRequest::COMPLETE) {
+      badRequests.add();
+      reply(fd, "400 Bad Request", 0);
+      close(fd);
+      continue;
+    }
+    // served here whatever placement says, so a request never bounces
+    const Route* route = routes.find(conn->request.method, conn->request.path);
+    dispatch(fd, *conn, route ? *route : *fallbackRoute);
+  }
+}
+
+void HttpServer::runPosted() {
+  uint64_t count;
+  while (read(wakeFd, &count, sizeof(count)) > 0) {}
+  std::vector<std::function<void()>> batch;
+  {
+    std::lock_guard<std::mutex> lock(postMutex);
+    batch.swap(posted);
+  }
+  for (auto& fn : batch)
+    fn();
+}
+
+int HttpServer::run() {
+  listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listenFd < 0) {
+    perror("socket");
+    return 1;
+  }
+  int opt = 1;
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  // only when sharded, so a second unsharded server still fails to bind
+  if (config.shards > 1)
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(config.port);
+  if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    perror("bind");
+    return 1;
+  }
+  if (listen(listenFd, SOMAXCONN) < 0) {
+    perror("listen");
+    return 1;
+  }
+
+  ep = epoll_create1(EPOLL_CLOEXEC);
+  wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (ep < 0 || wakeFd < 0) {
+    perror("epoll/eventfd");
+    return 1;
+  }
+  if (config.shards > 1 && !bindShardSocket())
+    return 1;
+  for (int fd : {listenFd, wakeFd, shardFd}) {
+    if (fd < 0)
+      continue;
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+  }
+
+  startWorkers(normalWorkers, config.workers, config.expectedServiceMs, false, normalDepth);
+  startWorkers(engineWorkers, config.engineWorkers, config.engineExpectedServiceMs, true, engineDepth);
+
+  epoll_event ready[256];
+  for (;;) {
+    int n = epoll_wait(ep, ready, 256, -1);
+    if (n < 0) {
+      if (errno != EINTR)
+        perror("epoll_wait");
+      continue;
+    }
+    for (int i = 0; i < n; i++) {
+      int fd = ready[i].data.fd;
+      uint32_t what = ready[i].events;
+      if (fd == listenFd) {
+        acceptAll();
+      }
+      else if (fd == wakeFd) {
+        runPosted();
+      }
+      else if (fd == shardFd) {
+        receiveHandovers();
+      }
+      else if (spectators.has(fd)) {
+        // streams never send after their request: input means hangup
+        if (what & (EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP))
+          spectators.unsubscribe(fd);
+        else if (what & EPOLLOUT)
+          spectators.flush(fd);
+      }
+      else if (fd < (int)connections.size() && connections[fd]) {
+        readConnection(fd);
+      }
+    }
+  }
+}
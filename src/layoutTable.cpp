@@ -0,0 +1,134 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include "../header/layoutTable.hpp"
+#include "../header/zobrist.hpp"
+
+namespace {
+
+const char MAGIC[8] = {'L', 'A', 'Y', 'O', 'U', 'T', 'T', 'B'};
+constexpr size_t HEADER_SIZE = 64;
+constexpr size_t FILE_SIZE = HEADER_SIZE + sizeof(int16_t) * RevealLayout::ARRANGEMENTS;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t count;       // RevealLayout::ARRANGEMENTS
+  uint16_t depth;
+  uint16_t opponents;
+};
+
+bool create(const std::string& path, int depth, int opponents, std::string& error) {
+  std::string temp = path + ".tmp";
+  FILE* f = fopen(temp.c_str(), "wb");
+  if (!f) {
+    error = temp + ": " + strerror(errno);
+    return false;
+  }
+  uint8_t header[HEADER_SIZE] = {};
+  FileHeader fields{};
+  memcpy(fields.magic, MAGIC, sizeof(MAGIC));
+  fields.count = RevealLayout::ARRANGEMENTS;
+  fields.depth = uint16_t(depth);
+  fields.opponents = uint16_t(opponents);
+  memcpy(header, &fields, sizeof(fields));
+  std::vector<int16_t> unscored(RevealLayout::ARRANGEMENTS, LayoutTable::UNSCORED);
+  bool ok = fwrite(header, sizeof(header), 1, f) == 1 &&
+            fwrite(unscored.data(), sizeof(int16_t), unscored.size(), f) == unscored.size();
+  ok = (fflush(f) == 0) && ok && fsync(fileno(f)) == 0;
+  ok = (fclose(f) == 0) && ok;
+  if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+    error = path + ": " + strerror(errno);
+    unlink(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+}
+
+LayoutTable::~LayoutTable() {
+  if (base)
+    munmap(base, length);
+}
+
+bool LayoutTable::map(const std::string& path, bool writable, std::string& error) {
+  int fd = ::open(path.c_str(), (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+  if (fd < 0) {
+    error = path + ": " + strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) != FILE_SIZE) {
+    close(fd);
+    error = path + ": not a layout table";
+    return false;
+  }
+  void* mapped = mmap(nullptr, FILE_SIZE, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    error = path + ": " + strerror(errno);
+    return false;
+  }
+  FileHeader header;
+  memcpy(&header, mapped, sizeof(header));
+  if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.count != RevealLayout::ARRANGEMENTS) {
+    munmap(mapped, FILE_SIZE);
+    error = path + ": not a layout table";
+    return false;
+  }
+  if (base)
+    munmap(base, length);
+  base = static_cast<uint8_t*>(mapped);
+  length = FILE_SIZE;
+  scores = reinterpret_cast<int16_t*>(base + HEADER_SIZE);
+  depth = header.depth;
+  opponents = header.opponents;
+  return true;
+}
+
+bool LayoutTable::open(const std::string& path, std::string& error) {
+  if (!map(path, false, error))
+    return false;
+  std::vector<int16_t> scored;
+  scored.reserve(RevealLayout::ARRANGEMENTS);
+  for (uint32_t i = 0; i < RevealLayout::ARRANGEMENTS; i++)
+    if (scores[i] != UNSCORED)
+      scored.push_back(scores[i]);
+  center = 0;
+  if (!scored.empty()) {
+    std::nth_element(scored.begin(), scored.begin() + scored.size() / 2, scored.end());
+    center = scored[scored.size() / 2];
+  }
+  limit = 0;
+  return true;
+}
+
+bool LayoutTable::openForScoring(const std::string& path, int searchDepth, int opponentsPerLayout,
+                                 std::string& error) {
+  if (access(path.c_str(), F_OK) != 0 && !create(path, searchDepth, opponentsPerLayout, error))
+    return false;
+  if (!map(path, true, error))
+    return false;
+  if (depth != searchDepth || opponents != opponentsPerLayout) {
+    error = path + ": scored at depth " + std::to_string(depth) + " against " + std::to_string(opponents) +
+            " opponents, not " + std::to_string(searchDepth) + "/" + std::to_string(opponentsPerLayout);
+    return false;
+  }
+  return true;
+}
+
+bool LayoutTable::sync() {
+  return base && msync(base, length, MS_SYNC) == 0;
+}
+
+uint32_t LayoutTable::opponent(uint32_t rank, int k) {
+  uint64_t state = (uint64_t(rank) << 8) | uint64_t(k & 0xff);
+  return uint32_t(zobrist::splitmix64(state) % RevealLayout::ARRANGEMENTS);
+}
@@ -0,0 +1,164 @@
+// Scores RevealBoard layouts for fairness (see layoutTable.hpp).
+// usage: layout_tool score <table.bin> [threads] [depth] [opponents] [count]
+//          searches every arrangement as White to depth (default 4) against
+//          opponents (default 1) sampled Black arrangements, on threads
+//          workers (default: all cores). The table is the checkpoint: an
+//          interrupted run picks up where it stopped, and count limits this
+//          run to that many more arrangements.
+//        layout_tool stats <table.bin>
+//          score distribution around the median, to choose a limit
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../header/layoutTable.hpp"
+#include "../header/revealBoard.hpp"
+#include "../header/search.hpp"
+
+namespace {
+
+// workers claim this many ranks at a time
+constexpr uint32_t CHUNK = 256;
+constexpr int SYNC_SECONDS = 30;
+// keeps mate scores clear of UNSCORED
+constexpr int MAX_SCORE = 30000;
+
+std::atomic<bool> interrupted{false};
+
+int16_t scoreArrangement(uint32_t rank, int depth, int opponents, Search& search) {
+  RevealLayout layout;
+  RevealLayout::unrank(rank, layout.white);
+  int total = 0;
+  for (int k = 0; k < opponents; k++) {
+    RevealLayout::unrank(LayoutTable::opponent(rank, k), layout.black);
+    RevealBoard board(layout);
+    PositionHistory history;
+    SearchLimits limits;
+    limits.depth = depth;
+    int score = 0;
+    // an empty table each time, so a score does not depend on what the
+    // thread searched before
+    search.clear();
+    search.run(board, WHITE, 0, history, limits, [&](const SearchReport& r) { score = r.score; });
+    total += std::max(-MAX_SCORE, std::min(score, MAX_SCORE));
+  }
+  return int16_t(total / opponents);
+}
+
+int score(const char* path, int threads, int depth, int opponents, uint64_t count) {
+  LayoutTable table;
+  std::string error;
+  if (!table.openForScoring(path, depth, opponents, error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  uint32_t pending = 0;
+  for (uint32_t r = 0; r < RevealLayout::ARRANGEMENTS; r++)
+    pending += (table.score(r) == LayoutTable::UNSCORED);
+  uint64_t target = std::min<uint64_t>(pending, count);
+  fprintf(stderr, "%u of %u arrangements left, scoring %llu at depth %d against %d opponents\n", pending,
+          RevealLayout::ARRANGEMENTS, (unsigned long long)target, depth, opponents);
+  signal(SIGINT, [](int) { interrupted = true; });
+  signal(SIGTERM, [](int) { interrupted = true; });
+
+  std::atomic<uint32_t> next{0};
+  std::atomic<uint64_t> claimed{0}, done{0};
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&] {
+      // the start position needs little table; clearing it is the cost
+      Search search(1);
+      for (uint32_t first; !interrupted && (first = next.fetch_add(CHUNK)) < RevealLayout::ARRANGEMENTS;) {
+        uint32_t last = std::min(first + CHUNK, RevealLayout::ARRANGEMENTS);
+        for (uint32_t r = first; r < last && !interrupted; r++) {
+          if (table.score(r) != LayoutTable::UNSCORED)
+            continue;
+          if (claimed.fetch_add(1) >= target)
+            return;
+          table.set(r, scoreArrangement(r, depth, opponents, search));
+          done.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    });
+  }
+  auto lastSync = start;
+  while (done.load() < target && !interrupted) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - start).count();
+    fprintf(stderr, "\r%llu / %llu (%.0f layouts/s)", (unsigned long long)done.load(), (unsigned long long)target,
+            done.load() / std::max(seconds, 1e-9));
+    if (now - lastSync >= std::chrono::seconds(SYNC_SECONDS)) {
+      table.sync();
+      lastSync = now;
+    }
+  }
+  for (std::thread& w : workers)
+    w.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  bool synced = table.sync();
+  fprintf(stderr, "\r%llu arrangements scored%s, %.1f s (%.0f layouts/s on %d threads)\n",
+          (unsigned long long)done.load(), interrupted ? " before the interrupt" : "", seconds,
+          done.load() / std::max(seconds, 1e-9), threads);
+  if (!synced) {
+    fprintf(stderr, "%s: could not sync\n", path);
+    return 1;
+  }
+  return 0;
+}
+
+int stats(const char* path) {
+  LayoutTable table;
+  std::string error;
+  if (!table.open(path, error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  std::vector<int> offsets;
+  for (uint32_t r = 0; r < RevealLayout::ARRANGEMENTS; r++)
+    if (table.score(r) != LayoutTable::UNSCORED)
+      offsets.push_back(table.score(r) - table.median());
+  printf("%zu of %u arrangements scored at depth %d against %d opponents, median %d\n", offsets.size(),
+         RevealLayout::ARRANGEMENTS, table.searchDepth(), table.opponentsPerLayout(), table.median());
+  if (offsets.empty())
+    return 0;
+  std::sort(offsets.begin(), offsets.end());
+  printf("offset from the median by percentile:");
+  for (int p : {1, 5, 25, 75, 95, 99})
+    printf(" p%d %+d", p, offsets[(offsets.size() - 1) * p / 100]);
+  printf("\nwithin the limit:");
+  for (int limit : {50, 100, 150, 200, 300}) {
+    size_t inside = std::count_if(offsets.begin(), offsets.end(), [&](int o) { return std::abs(o) <= limit; });
+    printf(" %d cp %.1f%%", limit, 100.0 * inside / offsets.size());
+  }
+  printf("\n");
+  return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+  std::string command = (argc > 1) ? argv[1] : "";
+  if (command == "score" && argc >= 3) {
+    int threads = (argc > 3) ? atoi(argv[3]) : 0;
+    if (threads <= 0)
+      threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    int depth = (argc > 4) ? atoi(argv[4]) : 4;
+    int opponents = (argc > 5) ? atoi(argv[5]) : 1;
+    uint64_t count = (argc > 6) ? strtoull(argv[6], nullptr, 10) : UINT64_MAX;
+    return score(argv[2], threads, std::max(1, depth), std::max(1, std::min(opponents, 255)), count);
+  }
+  if (command == "stats" && argc == 3)
+    return stats(argv[2]);
+  fprintf(stderr, "usage: layout_tool score <table.bin> [threads] [depth] [opponents] [count]\n"
+                  "       layout_tool stats <table.bin>\n");
+  return 1;
+}
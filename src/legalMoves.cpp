@@ -0,0 +1,51 @@
+#include "../header/legalMoves.hpp"
+
+namespace {
+
+template <PieceColor Us>
+void dispatch(const Board& board, const CheckInfo& info, GenType type, MoveList& list) {
+  switch (type) {
+  case CAPTURES:
+    ::generate<Us, CAPTURES>(board, info, list);
+    break;
+  case QUIETS:
+    ::generate<Us, QUIETS>(board, info, list);
+    break;
+  case EVASIONS:
+    ::generate<Us, EVASIONS>(board, info, list);
+    break;
+  case ALL:
+    ::generate<Us, ALL>(board, info, list);
+    break;
+  }
+}
+
+} // namespace
+
+LegalMoves::LegalMoves(const Board& board, PieceColor side)
+  : board(board), us(side),
+    info(side == WHITE ? computeCheckInfo<WHITE>(board) : computeCheckInfo<BLACK>(board)) {}
+
+bool LegalMoves::inCheck() const {
+  return info.checkers != 0;
+}
+
+void LegalMoves::generate(MoveList& list, GenType type) const {
+  if (us == WHITE)
+    dispatch<WHITE>(board, info, type, list);
+  else
+    dispatch<BLACK>(board, info, type, list);
+}
+
+void LegalMoves::generateFrom(int sq, MoveList& list) const {
+  if (us == WHITE)
+    ::generateFrom<WHITE>(board, info, sq, list);
+  else
+    ::generateFrom<BLACK>(board, info, sq, list);
+}
+
+bool LegalMoves::hasLegalMove() const {
+  MoveList list;
+  generate(list);
+  return !list.empty();
+}
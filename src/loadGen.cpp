@@ -0,0 +1,449 @@
+// Load generator for web_gui: simulated clients playing random legal games
+// on localhost, with the request pattern of the page in kIndexHtml.
+// usage: loadgen [clients] [seconds] [port] [engine|open]
+//          (defaults 16 clients, 10 s, port 8080, engine)
+//   engine: every client plays its own game against the engine
+//           (POST /api/engine-game, movetime 100 ms) and waits for the
+//           reply on its /events stream, as the page does
+//   open:   every client moves in the open practice room 0 for whichever
+//           side is to move, so only the HTTP path and the rules are
+//           measured; a finished game is rewound with POST /jump?ply=0
+// Per move a client does what a click does: GET /moves for its pieces until
+// one has a legal move, POST /move, then GET /state. Each client connects
+// from its own loopback address. Prints the requests per second, p50/p99/
+// p999 latency and 503s of every route; run it against two builds with the
+// same arguments for a before/after comparison.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int RECEIVE_TIMEOUT_SECONDS = 10;
+// a game is abandoned after this many plies of random moves
+constexpr int MAX_PLIES = 300;
+
+enum RouteId {
+  ENGINE_GAME,
+  STATE,
+  MOVES,
+  MOVE,
+  JUMP,
+  EVENTS,
+  ENGINE_REPLY,
+  ROUTES,
+};
+
+const char* const ROUTE_NAMES[ROUTES] = {
+  "POST /api/engine-game", "GET /state", "GET /moves", "POST /move", "POST /jump", "GET /events",
+  "engine reply (/events)",
+};
+
+struct RouteStats {
+  std::vector<uint32_t> micros;
+  uint64_t shed = 0;      // 503: the server's admission control said no
+  uint64_t errors = 0;    // any other failure
+};
+
+// one per client thread, merged at the end
+struct Stats {
+  RouteStats routes[ROUTES];
+  uint64_t games = 0;
+  uint64_t plies = 0;
+  uint64_t rejected = 0;   // POST /move answered {"ok":false}
+};
+
+struct Options {
+  int clients = 16;
+  int seconds = 10;
+  int port = 8080;
+  bool engine = true;
+};
+
+std::atomic<bool> running{true};
+
+// Client number client connects from 127.0.0.(client + 1) and onwards (all
+// of 127/8 is loopback), so the server's per-address limits see separate
+// peers as they would in the field.
+int connectLocal(int port, int client) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+  sockaddr_in local{};
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1 + uint32_t(client));
+  if (bind(fd, (sockaddr*)&local, sizeof(local)) != 0) {
+    // connecting anyway would come from 127.0.0.1 and merge this client
+    // into another's per-address limits; fail it so it counts as an error
+    static std::atomic<bool> warned{false};
+    if (!warned.exchange(true)) {
+      char name[INET_ADDRSTRLEN];
+      inet_ntop(AF_INET, &local.sin_addr, name, sizeof(name));
+      fprintf(stderr, "loadgen: bind %s: %s\n", name, strerror(errno));
+    }
+    close(fd);
+    return -1;
+  }
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  timeval timeout{RECEIVE_TIMEOUT_SECONDS, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool sendAll(int fd, const std::string& bytes) {
+  size_t sent = 0;
+  while (sent < bytes.size()) {
+    ssize_t n = send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    sent += size_t(n);
+  }
+  return true;
+}
+
+std::string requestText(const char* method, const std::string& target) {
+  return std::string(method) + " " + target + " HTTP/1.1\r\nHost: localhost\r\nContent-Length: 0\r\n\r\n";
+}
+
+// One request on a fresh connection (web_gui answers one per connection),
+// timed from connect to the server closing it. Returns the body of a 2xx
+// response; false, counted as an error, otherwise.
+bool call(int port, int client, const char* method, const std::string& target, RouteStats& stats,
+          std::string& body) {
+  auto start = Clock::now();
+  int fd = connectLocal(port, client);
+  std::string response;
+  if (fd >= 0 && sendAll(fd, requestText(method, target))) {
+    char buffer[16384];
+    for (ssize_t n; (n = recv(fd, buffer, sizeof(buffer), 0)) > 0;)
+      response.append(buffer, size_t(n));
+  }
+  if (fd >= 0)
+    close(fd);
+  auto micros = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+  size_t headerEnd = response.find("\r\n\r\n");
+  if (response.compare(0, 10, "HTTP/1.1 2") != 0 || headerEnd == std::string::npos) {
+    (response.compare(0, 12, "HTTP/1.1 503") == 0 ? stats.shed : stats.errors)++;
+    return false;
+  }
+  stats.micros.push_back(uint32_t(std::min<int64_t>(micros, UINT32_MAX)));
+  body = response.substr(headerEnd + 4);
+  return true;
+}
+
+// ---- just enough JSON for the state and move lists web_gui sends ----
+
+std::string textField(const std::string& json, const char* name, size_t from = 0) {
+  std::string key = std::string("\"") + name + "\":\"";
+  size_t at = json.find(key, from);
+  if (at == std::string::npos)
+    return "";
+  at += key.size();
+  return json.substr(at, json.find('"', at) - at);
+}
+
+int intField(const std::string& json, const char* name, size_t from = 0) {
+  std::string key = std::string("\"") + name + "\":";
+  size_t at = json.find(key, from);
+  return at == std::string::npos ? -1 : atoi(json.c_str() + at + key.size());
+}
+
+struct Square {
+  int r;
+  int c;
+};
+
+// squares in a JSON array of objects with "r" and "c", optionally only
+// those whose "color" is color
+std::vector<Square> squares(const std::string& json, const std::string& color = "") {
+  std::vector<Square> out;
+  for (size_t at = json.find('{', 1); at != std::string::npos; at = json.find('{', at + 1)) {
+    size_t end = json.find('}', at);
+    std::string object = json.substr(at, end - at);
+    if (object.find("\"r\":") == std::string::npos)
+      break;
+    if (color.empty() || textField(object, "color") == color)
+      out.push_back(Square{intField(object, "r"), intField(object, "c")});
+  }
+  return out;
+}
+
+bool finished(const std::string& state) {
+  std::string s = textField(state, "state");
+  return s == "CHECKMATE" || s == "DRAW";
+}
+
+// ---- one simulated client ----
+
+class Client {
+  private:
+    const Options& options;
+    Stats& stats;
+    const int number;
+    std::mt19937 rng;
+    std::string room = "0";
+    std::string color;       // engine mode: the side this client plays
+    int events = -1;         // the room's /events stream
+    std::string pending;     // stream bytes not yet split into frames
+
+    bool get(RouteId route, const std::string& target, std::string& body) {
+      return call(options.port, number, "GET", target, stats.routes[route], body);
+    }
+    bool post(RouteId route, const std::string& target, std::string& body) {
+      return call(options.port, number, "POST", target, stats.routes[route], body);
+    }
+
+    void closeEvents() {
+      if (events >= 0)
+        close(events);
+      events = -1;
+      pending.clear();
+    }
+
+    // the page keeps this open for the whole game; timed until the
+    // response headers arrive
+    bool openEvents() {
+      closeEvents();
+      RouteStats& route = stats.routes[EVENTS];
+      auto start = Clock::now();
+      events = connectLocal(options.port, number);
+      if (events < 0 || !sendAll(events, requestText("GET", "/events?room=" + room))) {
+        route.errors++;
+        closeEvents();
+        return false;
+      }
+      char buffer[16384];
+      while (pending.find("\r\n\r\n") == std::string::npos) {
+        ssize_t n = recv(events, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+          route.errors++;
+          closeEvents();
+          return false;
+        }
+        pending.append(buffer, size_t(n));
+      }
+      route.micros.push_back(uint32_t(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count()));
+      pending.erase(0, pending.find("\r\n\r\n") + 4);
+      return true;
+    }
+
+    // the next state pushed on the stream; blocking unless wait is false
+    bool nextFrame(std::string& frame, bool wait) {
+      char buffer[16384];
+      for (;;) {
+        size_t end = pending.find("\n\n");
+        if (end != std::string::npos) {
+          frame = pending.substr(0, end);
+          pending.erase(0, end + 2);
+          return true;
+        }
+        ssize_t n = recv(events, buffer, sizeof(buffer), wait ? 0 : MSG_DONTWAIT);
+        if (n <= 0)
+          return false;
+        pending.append(buffer, size_t(n));
+      }
+    }
+
+    bool startGame(std::string& state) {
+      std::string body;
+      if (options.engine) {
+        color = (rng() & 1) ? "WHITE" : "BLACK";
+        if (!post(ENGINE_GAME, std::string("/api/engine-game?movetime=100&color=") +
+                               (color == "WHITE" ? "white" : "black"), body))
+          return false;
+        room = std::to_string(intField(body, "room"));
+        stats.games++;
+      }
+      else if (state.empty() || finished(state) || intField(state, "ply") >= MAX_PLIES) {
+        // every client may see the end; a rewind by another one is harmless
+        if (!state.empty() && !post(JUMP, "/jump?room=0&ply=0", body))
+          return false;
+        stats.games++;
+      }
+      // open mode: the one room's stream stays open across games
+      return get(STATE, "/state?room=" + room, state) && (events >= 0 && !options.engine ? true : openEvents());
+    }
+
+    // Engine mode: until this client is to move, or the game is over. The
+    // stream can lag behind GET /state, so only frames at least as far into
+    // the game as the state already known are taken.
+    bool awaitTurn(std::string& state) {
+      auto start = Clock::now();
+      bool waited = false;
+      std::string frame;
+      auto take = [&] {
+        if (intField(frame, "ply") >= intField(state, "ply"))
+          state = frame;
+      };
+      for (;;) {
+        // whatever arrived already, then block for more if still not our turn
+        while (nextFrame(frame, false))
+          take();
+        if (textField(state, "turn") == color || finished(state))
+          break;
+        if (!nextFrame(frame, true)) {
+          stats.routes[ENGINE_REPLY].errors++;
+          return false;
+        }
+        take();
+        waited = true;
+      }
+      if (waited)
+        stats.routes[ENGINE_REPLY].micros.push_back(uint32_t(
+          std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count()));
+      return true;
+    }
+
+    // a click on a piece, then on one of its targets; false if no piece of
+    // the side to move has a legal move
+    bool playMove(std::string& state) {
+      std::string turn = textField(state, "turn");
+      std::vector<Square> mine = squares(state, turn);
+      std::shuffle(mine.begin(), mine.end(), rng);
+      std::string body;
+      for (const Square& from : mine) {
+        std::string at = "room=" + room + "&sr=" + std::to_string(from.r) + "&sc=" + std::to_string(from.c);
+        if (!get(MOVES, "/moves?" + at, body))
+          return false;
+        std::vector<Square> targets = squares(body);
+        if (targets.empty())
+          continue;
+        const Square& to = targets[rng() % targets.size()];
+        if (!post(MOVE, "/move?" + at + "&dr=" + std::to_string(to.r) + "&dc=" + std::to_string(to.c), body))
+          return false;
+        if (body.find("\"ok\":true") != std::string::npos)
+          stats.plies++;
+        else
+          stats.rejected++;   // open mode: another client moved first
+        return get(STATE, "/state?room=" + room, state);
+      }
+      return false;
+    }
+
+  public:
+    Client(const Options& options, Stats& stats, int number, uint32_t seed)
+      : options(options), stats(stats), number(number), rng(seed) {}
+    ~Client() { closeEvents(); }
+
+    void run() {
+      std::string state;
+      while (running) {
+        if (!startGame(state)) {
+          // the server is shedding or gone; don't spin on it
+          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+          continue;
+        }
+        std::string frame;
+        while (running && intField(state, "ply") < MAX_PLIES && !finished(state)) {
+          if (options.engine && !awaitTurn(state))
+            break;
+          if (finished(state))
+            break;
+          // open mode: other clients moved since the state was read; read it
+          // again as the page would after a failed click
+          if (!playMove(state) && (options.engine || !get(STATE, "/state?room=" + room, state)))
+            break;
+          // the page applies every pushed state; keep the stream drained
+          while (!options.engine && nextFrame(frame, false)) {}
+        }
+      }
+    }
+};
+
+uint32_t percentile(const std::vector<uint32_t>& sorted, double p) {
+  return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, size_t(p * sorted.size()))];
+}
+
+void report(Stats& total, double seconds, const Options& options) {
+  printf("%d clients, %.1f s, %s mode: %llu games, %llu plies, %llu moves rejected\n", options.clients, seconds,
+         options.engine ? "engine" : "open", (unsigned long long)total.games, (unsigned long long)total.plies,
+         (unsigned long long)total.rejected);
+  printf("%-24s %9s %9s %9s %9s %9s %7s %7s\n", "route", "requests", "per s", "p50 ms", "p99 ms", "p999 ms",
+         "503", "errors");
+  for (int r = 0; r < ROUTES; r++) {
+    RouteStats& route = total.routes[r];
+    if (route.micros.empty() && route.shed == 0 && route.errors == 0)
+      continue;
+    std::sort(route.micros.begin(), route.micros.end());
+    printf("%-24s %9zu %9.1f %9.3f %9.3f %9.3f %7llu %7llu\n", ROUTE_NAMES[r], route.micros.size(),
+           route.micros.size() / seconds, percentile(route.micros, 0.50) / 1000.0,
+           percentile(route.micros, 0.99) / 1000.0, percentile(route.micros, 0.999) / 1000.0,
+           (unsigned long long)route.shed, (unsigned long long)route.errors);
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (argc > 1)
+    options.clients = std::max(1, atoi(argv[1]));
+  if (argc > 2)
+    options.seconds = std::max(1, atoi(argv[2]));
+  if (argc > 3)
+    options.port = atoi(argv[3]);
+  if (argc > 4) {
+    std::string mode = argv[4];
+    if (mode != "engine" && mode != "open") {
+      fprintf(stderr, "usage: loadgen [clients] [seconds] [port] [engine|open]\n");
+      return 1;
+    }
+    options.engine = (mode == "engine");
+  }
+
+  std::vector<Stats> stats(options.clients);
+  std::vector<std::thread> threads;
+  std::random_device seeds;
+  auto start = Clock::now();
+  for (int i = 0; i < options.clients; i++) {
+    uint32_t seed = seeds();
+    threads.emplace_back([&options, &stats, i, seed] { Client(options, stats[i], i, seed).run(); });
+  }
+  std::this_thread::sleep_for(std::chrono::seconds(options.seconds));
+  running = false;
+  for (std::thread& t : threads)
+    t.join();
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  Stats total;
+  for (Stats& s : stats) {
+    for (int r = 0; r < ROUTES; r++) {
+      auto& micros = total.routes[r].micros;
+      micros.insert(micros.end(), s.routes[r].micros.begin(), s.routes[r].micros.end());
+      total.routes[r].shed += s.routes[r].shed;
+      total.routes[r].errors += s.routes[r].errors;
+    }
+    total.games += s.games;
+    total.plies += s.plies;
+    total.rejected += s.rejected;
+  }
+  report(total, seconds, options);
+  return 0;
+}
@@ -0,0 +1,207 @@
+#include <algorithm>
+
+#include "../header/lobby.hpp"
+#include "../header/metrics.hpp"
+
+namespace {
+
+const metrics::Gauge waitingPlayers("lobby_waiting_players", "Players waiting for an opponent.");
+const metrics::Counter matchesMade("lobby_matches_total", "Games created by matchmaking.");
+const metrics::Histogram waitTime("lobby_wait_seconds", "Time from joining the queue to a match.");
+
+}
+
+Lobby::Lobby(Pair pair, LobbyConfig config)
+  : config(config), pair(std::move(pair)), buckets(new Bucket[config.buckets]) {
+  sweeper = std::thread([this] { sweepLoop(); });
+}
+
+Lobby::~Lobby() {
+  {
+    std::lock_guard<std::mutex> lock(sweepMutex);
+    stopping = true;
+  }
+  sweepWake.notify_one();
+  sweeper.join();
+}
+
+int Lobby::bucketOf(int rating) const {
+  return std::clamp(rating / config.bucketWidth, 0, config.buckets - 1);
+}
+
+int Lobby::window(const Ticket& ticket, Clock::time_point now) const {
+  auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(now - ticket.since).count();
+  int64_t grown = config.initialWindow + int64_t(config.widenPerSecond) * waited / 1000;
+  return (int)std::min<int64_t>(grown, config.maxWindow);
+}
+
+std::vector<std::unique_lock<std::mutex>> Lobby::lockRange(int first, int last) {
+  // always in ascending order, so overlapping ranges cannot deadlock
+  std::vector<std::unique_lock<std::mutex>> locks;
+  for (int b = first; b <= last; b++)
+    locks.emplace_back(buckets[b].mutex);
+  return locks;
+}
+
+Lobby::Found Lobby::nearest(int first, int last, const Ticket& ticket, int window,
+                            Clock::time_point now, const Ticket* skip) {
+  Found best;
+  auto consider = [&](int bucket, Queue::iterator it, int difference) {
+    if (best.bucket < 0 || difference < best.difference)
+      best = Found{bucket, it, difference};
+  };
+  for (int b = first; b <= last; b++) {
+    Queue& queue = buckets[b].byRating;
+    Queue::iterator start = queue.lower_bound(ticket.rating);
+    // walk outwards; the first compatible ticket each way is the nearest
+    for (auto it = start; it != queue.end() && it->first - ticket.rating <= window; ++it) {
+      if (&it->second != skip && it->first - ticket.rating <= this->window(it->second, now)) {
+        consider(b, it, it->first - ticket.rating);
+        break;
+      }
+    }
+    for (auto it = start; it != queue.begin();) {
+      --it;
+      if (ticket.rating - it->first > window)
+        break;
+      if (&it->second != skip && ticket.rating - it->first <= this->window(it->second, now)) {
+        consider(b, it, ticket.rating - it->first);
+        break;
+      }
+    }
+  }
+  return best;
+}
+
+bool Lobby::join(const std::string& user, int rating) {
+  {
+    std::lock_guard<std::mutex> lock(placesMutex);
+    if (!places.emplace(user, Place()).second)
+      return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(matchesMutex);
+    matches.erase(user);
+  }
+
+  Clock::time_point now = Clock::now();
+  Ticket ticket{user, rating, now};
+  int reach = config.initialWindow;
+  int first = bucketOf(rating - reach), last = bucketOf(rating + reach);
+  Ticket opponent;
+  bool matched = false;
+  {
+    auto locks = lockRange(first, last);
+    Found found = nearest(first, last, ticket, reach, now, nullptr);
+    std::lock_guard<std::mutex> lock(placesMutex);
+    if (found.bucket >= 0) {
+      opponent = std::move(found.ticket->second);
+      buckets[found.bucket].byRating.erase(found.ticket);
+      places[opponent.user] = Place();
+      matched = true;
+    } else {
+      int home = bucketOf(rating);
+      places[user] = Place{home, buckets[home].byRating.emplace(rating, ticket)};
+    }
+  }
+  if (matched)
+    finish(opponent, ticket);
+  return true;
+}
+
+bool Lobby::leave(const std::string& user) {
+  int bucket;
+  {
+    std::lock_guard<std::mutex> lock(placesMutex);
+    auto it = places.find(user);
+    if (it == places.end() || it->second.bucket < 0)
+      return false;
+    bucket = it->second.bucket;
+  }
+  // tickets never change bucket, so only a match can have taken it meanwhile
+  std::lock_guard<std::mutex> bucketLock(buckets[bucket].mutex);
+  std::lock_guard<std::mutex> lock(placesMutex);
+  auto it = places.find(user);
+  if (it == places.end() || it->second.bucket != bucket)
+    return false;
+  buckets[bucket].byRating.erase(it->second.ticket);
+  places.erase(it);
+  return true;
+}
+
+void Lobby::finish(const Ticket& a, const Ticket& b) {
+  const Ticket& white = (a.since <= b.since) ? a : b;
+  const Ticket& black = (&white == &a) ? b : a;
+  uint32_t room = pair(white.user, black.user);
+
+  Clock::time_point now = Clock::now();
+  for (const Ticket* t : {&white, &black})
+    waitTime.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - t->since).count());
+  matchesMade.add();
+  {
+    std::lock_guard<std::mutex> lock(matchesMutex);
+    matches[white.user] = LobbyMatch{room, WHITE, black.user};
+    matches[black.user] = LobbyMatch{room, BLACK, white.user};
+  }
+  std::lock_guard<std::mutex> lock(placesMutex);
+  places.erase(white.user);
+  places.erase(black.user);
+}
+
+Lobby::State Lobby::poll(const std::string& user, LobbyMatch& match) {
+  {
+    std::lock_guard<std::mutex> lock(matchesMutex);
+    auto it = matches.find(user);
+    if (it != matches.end()) {
+      match = it->second;
+      return MATCHED;
+    }
+  }
+  std::lock_guard<std::mutex> lock(placesMutex);
+  return places.count(user) ? WAITING : IDLE;
+}
+
+size_t Lobby::waiting() {
+  std::lock_guard<std::mutex> lock(placesMutex);
+  return places.size();
+}
+
+void Lobby::sweep() {
+  int span = (config.maxWindow + config.bucketWidth - 1) / config.bucketWidth;
+  std::vector<std::pair<Ticket, Ticket>> pairs;
+  for (int b = 0; b < config.buckets; b++) {
+    int first = std::max(0, b - span), last = std::min(config.buckets - 1, b + span);
+    auto locks = lockRange(first, last);
+    Queue& queue = buckets[b].byRating;
+    Clock::time_point now = Clock::now();
+    for (auto it = queue.begin(); it != queue.end();) {
+      int reach = window(it->second, now);
+      Found found = nearest(bucketOf(it->first - reach), bucketOf(it->first + reach), it->second,
+                            reach, now, &it->second);
+      if (found.bucket < 0) {
+        ++it;
+        continue;
+      }
+      pairs.emplace_back(std::move(it->second), std::move(found.ticket->second));
+      {
+        std::lock_guard<std::mutex> lock(placesMutex);
+        places[pairs.back().first.user] = Place();
+        places[pairs.back().second.user] = Place();
+      }
+      buckets[found.bucket].byRating.erase(found.ticket);
+      it = queue.erase(it);
+    }
+  }
+  for (const auto& p : pairs)
+    finish(p.first, p.second);
+  waitingPlayers.set((int64_t)waiting());
+}
+
+void Lobby::sweepLoop() {
+  std::unique_lock<std::mutex> lock(sweepMutex);
+  while (!sweepWake.wait_for(lock, std::chrono::milliseconds(config.sweepMs), [this] { return stopping; })) {
+    lock.unlock();
+    sweep();
+    lock.lock();
+  }
+}
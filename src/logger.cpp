@@ -0,0 +1,103 @@
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "../header/logger.hpp"
+#include "../header/metrics.hpp"
+
+namespace {
+
+constexpr size_t MAX_PENDING = 1 << 20;
+constexpr size_t MAX_LINE = 1024;
+constexpr auto WRITE_INTERVAL = std::chrono::milliseconds(20);
+
+class AsyncLogger {
+  private:
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable written;
+    std::string pending;
+    uint64_t appended = 0;   // lines accepted so far
+    uint64_t flushed = 0;    // lines written so far
+    bool flushWanted = false;
+    std::thread writer;
+
+    void run() {
+      std::string batch;
+      std::unique_lock<std::mutex> lock(mutex);
+      for (;;) {
+        wake.wait_for(lock, WRITE_INTERVAL, [this] { return flushWanted; });
+        batch.swap(pending);
+        uint64_t upTo = appended;
+        flushWanted = false;
+        lock.unlock();
+        size_t done = 0;
+        while (done < batch.size()) {
+          ssize_t n = write(STDERR_FILENO, batch.data() + done, batch.size() - done);
+          if (n <= 0)
+            break;
+          done += n;
+        }
+        batch.clear();
+        lock.lock();
+        flushed = upTo;
+        written.notify_all();
+      }
+    }
+  public:
+    AsyncLogger() : writer([this] { run(); }) {
+      writer.detach();
+    }
+
+    void append(const char* line, size_t length) {
+      static const metrics::Counter dropped("log_lines_dropped_total", "Log lines dropped because the writer fell behind.");
+      std::lock_guard<std::mutex> lock(mutex);
+      if (pending.size() + length > MAX_PENDING) {
+        dropped.add();
+        return;
+      }
+      pending.append(line, length);
+      appended++;
+    }
+
+    void flush() {
+      std::unique_lock<std::mutex> lock(mutex);
+      uint64_t target = appended;
+      flushWanted = true;
+      wake.notify_one();
+      written.wait(lock, [&] { return flushed >= target; });
+    }
+};
+
+AsyncLogger& logger() {
+  // never destroyed: the detached writer may still be running at exit
+  static AsyncLogger* instance = new AsyncLogger();
+  return *instance;
+}
+
+}
+
+void logLine(const char* format, ...) {
+  char line[MAX_LINE];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (n < 0)
+    return;
+  size_t length = size_t(n);
+  if (length >= sizeof(line)) {
+    length = sizeof(line) - 1;
+    line[length - 1] = '\n';
+  }
+  logger().append(line, length);
+}
+
+void flushLog() {
+  logger().flush();
+}
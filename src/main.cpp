@@ -1,11 +1,15 @@
-#include "../header/board.hpp"
-#include "../header/print.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <string>
 
+#include "../header/uci.hpp"
 
-int main() {
-  Board board;
-  Print print;
-  print.printBoard(board);
-  
-  return 0;
-}
\ No newline at end of file
+// With no arguments the console app speaks UCI on stdin/stdout;
+// "app bench [depth]" prints the bench signature and exits.
+int main(int argc, char** argv) {
+  if (argc > 1 && std::string(argv[1]) == "bench") {
+    uciBench(std::cout, argc > 2 ? std::atoi(argv[2]) : 0);
+    return 0;
+  }
+  return uciLoop(std::cin, std::cout);
+}
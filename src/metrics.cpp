@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../header/metrics.hpp"
+
+namespace metrics {
+
+namespace {
+
+// bucket i < 8 holds value i; above that 8 linear sub-buckets per octave
+constexpr int SUB_BITS = 3;
+constexpr int SUB_COUNT = 1 << SUB_BITS;
+constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB_COUNT;
+
+int bucketOf(uint64_t v) {
+  if (v < SUB_COUNT)
+    return int(v);
+  int exponent = 63 - __builtin_clzll(v);
+  int sub = int(v >> (exponent - SUB_BITS)) & (SUB_COUNT - 1);
+  return (exponent - SUB_BITS + 1) * SUB_COUNT + sub;
+}
+
+// exclusive upper bound of a bucket
+double bucketLimit(int bucket) {
+  if (bucket < SUB_COUNT)
+    return bucket + 1;
+  int exponent = bucket / SUB_COUNT + SUB_BITS - 1;
+  int sub = bucket % SUB_COUNT;
+  return double(SUB_COUNT + sub + 1) * double(uint64_t(1) << (exponent - SUB_BITS));
+}
+
+struct HistogramShard {
+  std::atomic<uint64_t> buckets[BUCKETS];
+  std::atomic<uint64_t> sum;
+};
+
+// one per thread, written only by its owner
+struct Shard {
+  std::atomic<uint64_t> counters[MAX_COUNTERS] = {};
+  HistogramShard histograms[MAX_HISTOGRAMS] = {};
+};
+
+// single writer, so a plain load + store is enough and avoids a locked add
+inline void bump(std::atomic<uint64_t>& a, uint64_t n) {
+  a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+struct Description {
+  std::string name;
+  std::string help;
+  std::string labels;
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<Description> counters;
+  std::vector<Description> histograms;
+  std::vector<Description> gauges;
+  std::unique_ptr<std::atomic<int64_t>[]> gaugeValues{new std::atomic<int64_t>[MAX_GAUGES]()};
+  // shards of exited threads stay, so their counts are not lost
+  std::vector<std::unique_ptr<Shard>> shards;
+};
+
+Registry& registry() {
+  static Registry r;
+  return r;
+}
+
+Shard& localShard() {
+  thread_local Shard* shard = [] {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.shards.push_back(std::make_unique<Shard>());
+    return r.shards.back().get();
+  }();
+  return *shard;
+}
+
+int registerIn(std::vector<Description>& list, int capacity, const char* name, const char* help,
+               const char* labels) {
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  if ((int)list.size() == capacity) {
+    fprintf(stderr, "metrics: too many metrics, dropping %s\n", name);
+    return -1;
+  }
+  list.push_back(Description{name, help, labels});
+  return (int)list.size() - 1;
+}
+
+std::string withLabels(const std::string& labels, const std::string& extra) {
+  if (labels.empty() && extra.empty())
+    return "";
+  if (labels.empty() || extra.empty())
+    return "{" + labels + extra + "}";
+  return "{" + labels + "," + extra + "}";
+}
+
+std::string number(double v) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.9g", v);
+  return buf;
+}
+
+void header(std::string& out, std::string& last, const Description& d, const char* type) {
+  if (d.name == last)
+    return;
+  last = d.name;
+  out += "# HELP " + d.name + " " + d.help + "\n# TYPE " + d.name + " " + type + "\n";
+}
+
+}
+
+Counter::Counter(const char* name, const char* help, const char* labels)
+  : id(registerIn(registry().counters, MAX_COUNTERS, name, help, labels)) {}
+
+void Counter::add(uint64_t n) const {
+  if (id >= 0)
+    bump(localShard().counters[id], n);
+}
+
+Gauge::Gauge(const char* name, const char* help, const char* labels) {
+  int id = registerIn(registry().gauges, MAX_GAUGES, name, help, labels);
+  // overflowing gauges share a sink slot that is never rendered
+  static std::atomic<int64_t> sink{0};
+  value = (id >= 0) ? &registry().gaugeValues[id] : &sink;
+}
+
+Histogram::Histogram(const char* name, const char* help, const char* labels)
+  : id(registerIn(registry().histograms, MAX_HISTOGRAMS, name, help, labels)) {}
+
+void Histogram::record(uint64_t nanos) const {
+  if (id < 0)
+    return;
+  HistogramShard& h = localShard().histograms[id];
+  bump(h.buckets[bucketOf(nanos)], 1);
+  bump(h.sum, nanos);
+}
+
+std::string render() {
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  std::string out;
+  std::string last;
+
+  // group series of one metric name under a single HELP/TYPE
+  auto byName = [](const std::vector<Description>& list) {
+    std::vector<int> order(list.size());
+    for (size_t i = 0; i < order.size(); i++)
+      order[i] = (int)i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return list[a].name < list[b].name; });
+    return order;
+  };
+
+  for (int i : byName(r.counters)) {
+    const Description& d = r.counters[i];
+    uint64_t total = 0;
+    for (auto& s : r.shards)
+      total += s->counters[i].load(std::memory_order_relaxed);
+    header(out, last, d, "counter");
+    out += d.name + withLabels(d.labels, "") + " " + std::to_string(total) + "\n";
+  }
+
+  for (int i : byName(r.gauges)) {
+    const Description& d = r.gauges[i];
+    header(out, last, d, "gauge");
+    out += d.name + withLabels(d.labels, "") + " " +
+           std::to_string(r.gaugeValues[i].load(std::memory_order_relaxed)) + "\n";
+  }
+
+  // Prometheus buckets at powers of two from 1us up; the fine HDR buckets
+  // fold into them exactly since every octave boundary is a bucket edge
+  std::string quantiles;
+  std::string lastQuantile;
+  for (int i : byName(r.histograms)) {
+    const Description& d = r.histograms[i];
+    std::vector<uint64_t> counts(BUCKETS, 0);
+    uint64_t sum = 0, total = 0;
+    for (auto& s : r.shards) {
+      const HistogramShard& h = s->histograms[i];
+      for (int b = 0; b < BUCKETS; b++)
+        counts[b] += h.buckets[b].load(std::memory_order_relaxed);
+      sum += h.sum.load(std::memory_order_relaxed);
+    }
+    for (uint64_t c : counts)
+      total += c;
+
+    header(out, last, d, "histogram");
+    uint64_t cumulative = 0;
+    int b = 0;
+    for (int power = 10; power <= 36; power++) {
+      double limit = double(uint64_t(1) << power);
+      while (b < BUCKETS && bucketLimit(b) <= limit)
+        cumulative += counts[b++];
+      out += d.name + "_bucket" + withLabels(d.labels, "le=\"" + number(limit / 1e9) + "\"") + " " +
+             std::to_string(cumulative) + "\n";
+    }
+    out += d.name + "_bucket" + withLabels(d.labels, "le=\"+Inf\"") + " " + std::to_string(total) + "\n";
+    out += d.name + "_sum" + withLabels(d.labels, "") + " " + number(double(sum) / 1e9) + "\n";
+    out += d.name + "_count" + withLabels(d.labels, "") + " " + std::to_string(total) + "\n";
+
+    // the fine buckets also give tight quantiles, exported alongside
+    Description q{d.name + "_quantile", "Quantiles of " + d.name + " from the HDR buckets.", d.labels};
+    header(quantiles, lastQuantile, q, "gauge");
+    for (double p : {0.5, 0.9, 0.99, 0.999}) {
+      uint64_t rank = uint64_t(p * total + 0.5), seen = 0;
+      double value = 0;
+      for (int k = 0; k < BUCKETS && total; k++) {
+        seen += counts[k];
+        if (seen >= rank && counts[k]) {
+          value = bucketLimit(k);
+          break;
+        }
+      }
+      quantiles += q.name + withLabels(d.labels, "quantile=\"" + number(p) + "\"") + " " +
+                   number(value / 1e9) + "\n";
+    }
+  }
+  return out + quantiles;
+}
+
+} // namespace metrics
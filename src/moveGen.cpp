@@ -0,0 +1,253 @@
+#include "../header/moveGen.hpp"
+
+namespace {
+
+template <PieceColor Us>
+constexpr PieceColor opponent() {
+  return Us == WHITE ? BLACK : WHITE;
+}
+
+template <PieceColor Us>
+Bitboard attackedSquares(const Board& board, Bitboard occ) {
+  Bitboard attacked = 0;
+  Bitboard b = board.pieces(Us, PAWN);
+  while (b)
+    attacked |= pawnAttacks(Us, popLsb(b));
+  b = board.pieces(Us, KNIGHT);
+  while (b)
+    attacked |= knightAttacks(popLsb(b));
+  b = board.pieces(Us, KING);
+  while (b)
+    attacked |= kingAttacks(popLsb(b));
+  b = board.pieces(Us, BISHOP) | board.pieces(Us, QUEEN);
+  while (b)
+    attacked |= bishopAttacks(popLsb(b), occ);
+  b = board.pieces(Us, ROOK) | board.pieces(Us, QUEEN);
+  while (b)
+    attacked |= rookAttacks(popLsb(b), occ);
+  return attacked;
+}
+
+template <int Delta>
+void addShifted(Bitboard targets, MoveList& list) {
+  while (targets) {
+    int to = popLsb(targets);
+    list.add(to - Delta, to);
+  }
+}
+
+// squares one pawn on from may move to, before pin and check masks
+template <PieceColor Us, GenType Type>
+Bitboard pawnTargets(const Board& board, int from) {
+  constexpr int Up = (Us == WHITE) ? 8 : -8;
+  Bitboard empty = ~board.occupied();
+  Bitboard b = squareBB(from);
+  Bitboard t = 0;
+  if constexpr (Type != CAPTURES) {
+    Bitboard one = shift<Up>(b) & empty;
+    t |= one;
+    if (board.unmovedPieces() & b)
+      t |= shift<Up>(one) & empty;
+  }
+  if constexpr (Type != QUIETS)
+    t |= pawnAttacks(Us, from) & board.pieces(opponent<Us>());
+  return t;
+}
+
+// Pawns that are not pinned move set-wise by shifting; an unmoved pawn may
+// double push. Pawns on the last rank cannot move (there is no promotion).
+template <PieceColor Us, GenType Type>
+void generatePawnMoves(const Board& board, const CheckInfo& info, Bitboard target, MoveList& list) {
+  constexpr PieceColor Them = opponent<Us>();
+  constexpr int Up = (Us == WHITE) ? 8 : -8;
+  constexpr int UpLeft = Up - 1;
+  constexpr int UpRight = Up + 1;
+
+  Bitboard empty = ~board.occupied();
+  Bitboard enemies = board.pieces(Them);
+  Bitboard pawns = board.pieces(Us, PAWN);
+  Bitboard free = pawns & ~info.pinned;
+
+  if constexpr (Type != CAPTURES) {
+    Bitboard single = shift<Up>(free) & empty;
+    Bitboard twice = shift<Up>(shift<Up>(free & board.unmovedPieces()) & empty) & empty;
+    addShifted<Up>(single & target, list);
+    addShifted<2 * Up>(twice & target, list);
+  }
+  if constexpr (Type != QUIETS) {
+    addShifted<UpLeft>(shift<UpLeft>(free & ~FILE_A) & enemies & target, list);
+    addShifted<UpRight>(shift<UpRight>(free & ~FILE_H) & enemies & target, list);
+  }
+
+  Bitboard pinnedPawns = pawns & info.pinned;
+  while (pinnedPawns) {
+    int from = popLsb(pinnedPawns);
+    Bitboard t = pawnTargets<Us, Type>(board, from) & target & info.pinLine[from];
+    while (t)
+      list.add(from, popLsb(t));
+  }
+}
+
+template <PieceColor Us, PieceType Pt>
+void generatePieceMoves(const Board& board, const CheckInfo& info, Bitboard target, MoveList& list) {
+  Bitboard occ = board.occupied();
+  Bitboard pieces = board.pieces(Us, Pt);
+  while (pieces) {
+    int from = popLsb(pieces);
+    Bitboard t = attacksFrom<Pt>(from, occ) & target;
+    if (info.pinned & squareBB(from))
+      t &= info.pinLine[from];
+    while (t)
+      list.add(from, popLsb(t));
+  }
+}
+
+// The king may not start in check, pass through or land on an attacked
+// square; every square between king and rook must be empty.
+template <PieceColor Us>
+void generateCastling(const Board& board, const CheckInfo& info, MoveList& list) {
+  int kingSq = info.kingSq;
+  if (kingSq < 0 || info.checkers || !(board.unmovedPieces() & squareBB(kingSq)))
+    return;
+
+  Bitboard rooks = board.pieces(Us, ROOK) & board.unmovedPieces();
+  constexpr int sides[2][2] = {{7, 6}, {0, 2}}; // rook column, king destination
+  for (const auto& side : sides) {
+    int row = kingSq / 8;
+    int rookSq = squareOf(row, side[0]);
+    int dst = squareOf(row, side[1]);
+    if (rookSq == kingSq || dst == kingSq || !(rooks & squareBB(rookSq)))
+      continue;
+    if (betweenBB(kingSq, rookSq) & board.occupied())
+      continue;
+    if ((betweenBB(kingSq, dst) | squareBB(dst)) & info.enemyAttacks)
+      continue;
+    list.add(kingSq, dst);
+  }
+}
+
+} // namespace
+
+template <PieceColor Us>
+CheckInfo computeCheckInfo(const Board& board) {
+  constexpr PieceColor Them = opponent<Us>();
+  CheckInfo info;
+  Bitboard king = board.pieces(Us, KING);
+  if (!king)
+    return info; // no king on board, nothing to protect
+  int ksq = info.kingSq = lsb(king);
+
+  Bitboard occ = board.occupied();
+  info.enemyAttacks = attackedSquares<Them>(board, occ ^ squareBB(ksq));
+  info.checkers = (pawnAttacks(Us, ksq) & board.pieces(Them, PAWN))
+                | (knightAttacks(ksq) & board.pieces(Them, KNIGHT))
+                | (kingAttacks(ksq) & board.pieces(Them, KING));
+
+  // sliders lined up with the king either give check or pin one piece
+  Bitboard queens = board.pieces(Them, QUEEN);
+  Bitboard snipers = (rookAttacks(ksq, 0) & (board.pieces(Them, ROOK) | queens))
+                   | (bishopAttacks(ksq, 0) & (board.pieces(Them, BISHOP) | queens));
+  while (snipers) {
+    int s = popLsb(snipers);
+    Bitboard ray = betweenBB(ksq, s);
+    Bitboard blockers = ray & occ;
+    if (!blockers)
+      info.checkers |= squareBB(s);
+    else if (!moreThanOne(blockers) && (blockers & board.pieces(Us))) {
+      info.pinned |= blockers;
+      info.pinLine[lsb(blockers)] = ray | squareBB(s);
+    }
+  }
+
+  if (moreThanOne(info.checkers))
+    info.checkMask = 0;
+  else if (info.checkers)
+    info.checkMask = info.checkers | betweenBB(ksq, lsb(info.checkers));
+  return info;
+}
+
+template <PieceColor Us, GenType Type>
+void generate(const Board& board, const CheckInfo& info, MoveList& list) {
+  if constexpr (Type == EVASIONS) {
+    if (!info.checkers)
+      return;
+  }
+  constexpr PieceColor Them = opponent<Us>();
+  Bitboard occ = board.occupied();
+  Bitboard target = (Type == CAPTURES) ? board.pieces(Them)
+                  : (Type == QUIETS)   ? ~occ
+                  :                      ~board.pieces(Us);
+
+  // in double check only the king may move
+  if (info.checkMask) {
+    Bitboard t = target & info.checkMask;
+    generatePawnMoves<Us, Type>(board, info, t, list);
+    generatePieceMoves<Us, KNIGHT>(board, info, t, list);
+    generatePieceMoves<Us, BISHOP>(board, info, t, list);
+    generatePieceMoves<Us, ROOK>(board, info, t, list);
+    generatePieceMoves<Us, QUEEN>(board, info, t, list);
+  }
+
+  Bitboard kings = board.pieces(Us, KING);
+  while (kings) {
+    int from = popLsb(kings);
+    Bitboard t = kingAttacks(from) & target & ~info.enemyAttacks;
+    while (t)
+      list.add(from, popLsb(t));
+  }
+  if constexpr (Type == QUIETS || Type == ALL)
+    generateCastling<Us>(board, info, list);
+}
+
+template <PieceColor Us>
+void generateFrom(const Board& board, const CheckInfo& info, int sq, MoveList& list) {
+  if (!(board.pieces(Us) & squareBB(sq)))
+    return;
+  PieceType type = board.getPieceType(sq / 8, sq % 8);
+  Bitboard occ = board.occupied();
+  Bitboard t = 0;
+  switch (type) {
+  case KING:
+    t = kingAttacks(sq) & ~info.enemyAttacks;
+    break;
+  case PAWN:
+    t = pawnTargets<Us, ALL>(board, sq);
+    break;
+  case KNIGHT:
+    t = knightAttacks(sq);
+    break;
+  case BISHOP:
+    t = bishopAttacks(sq, occ);
+    break;
+  case ROOK:
+    t = rookAttacks(sq, occ);
+    break;
+  case QUEEN:
+    t = bishopAttacks(sq, occ) | rookAttacks(sq, occ);
+    break;
+  }
+  t &= ~board.pieces(Us);
+  // in double check checkMask is empty: only the king may move
+  if (type != KING) {
+    t &= info.checkMask;
+    if (info.pinned & squareBB(sq))
+      t &= info.pinLine[sq];
+  }
+  while (t)
+    list.add(sq, popLsb(t));
+  if (sq == info.kingSq)
+    generateCastling<Us>(board, info, list);
+}
+
+template CheckInfo computeCheckInfo<WHITE>(const Board&);
+template CheckInfo computeCheckInfo<BLACK>(const Board&);
+template void generate<WHITE, CAPTURES>(const Board&, const CheckInfo&, MoveList&);
+template void generate<WHITE, QUIETS>(const Board&, const CheckInfo&, MoveList&);
+template void generate<WHITE, EVASIONS>(const Board&, const CheckInfo&, MoveList&);
+template void generate<WHITE, ALL>(const Board&, const CheckInfo&, MoveList&);
+template void generate<BLACK, CAPTURES>(const Board&, const CheckInfo&, MoveList&);
+template void generate<BLACK, QUIETS>(const Board&, const CheckInfo&, MoveList&);
+template void generate<BLACK, EVASIONS>(const Board&, const CheckInfo&, MoveList&);
+template void generate<BLACK, ALL>(const Board&, const CheckInfo&, MoveList&);
+template void generateFrom<WHITE>(const Board&, const CheckInfo&, int, MoveList&);
+template void generateFrom<BLACK>(const Board&, const CheckInfo&, int, MoveList&);
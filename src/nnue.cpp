@@ -0,0 +1,302 @@
+#include "../header/nnue.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define NNUE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace nnue {
+
+namespace {
+
+struct Network {
+  alignas(64) int16_t ftBias[HIDDEN];
+  alignas(64) int16_t ftWeights[FEATURES * HIDDEN];
+  alignas(64) int8_t outWeights[2 * HIDDEN];
+  int32_t outBias;
+};
+
+Network network;
+bool loaded = false;
+
+inline const int16_t* column(int feature) {
+  return network.ftWeights + feature * HIDDEN;
+}
+
+// ---------- kernels ----------
+
+struct Kernels {
+  void (*add)(int16_t* acc, const int16_t* w);
+  void (*sub)(int16_t* acc, const int16_t* w);
+  void (*addSub)(int16_t* acc, const int16_t* add, const int16_t* sub);
+  int32_t (*output)(const int16_t* us, const int16_t* them, const int8_t* w);
+  const char* name;
+};
+
+void addScalar(int16_t* acc, const int16_t* w) {
+  for (int i = 0; i < HIDDEN; i++)
+    acc[i] += w[i];
+}
+
+void subScalar(int16_t* acc, const int16_t* w) {
+  for (int i = 0; i < HIDDEN; i++)
+    acc[i] -= w[i];
+}
+
+void addSubScalar(int16_t* acc, const int16_t* add, const int16_t* sub) {
+  for (int i = 0; i < HIDDEN; i++)
+    acc[i] += add[i] - sub[i];
+}
+
+int32_t outputScalar(const int16_t* us, const int16_t* them, const int8_t* w) {
+  int32_t sum = 0;
+  for (int i = 0; i < HIDDEN; i++) {
+    sum += std::clamp<int>(us[i], 0, ACTIVATION_MAX) * w[i];
+    sum += std::clamp<int>(them[i], 0, ACTIVATION_MAX) * w[HIDDEN + i];
+  }
+  return sum;
+}
+
+#ifdef NNUE_X86
+
+__attribute__((target("sse2")))
+void addSse2(int16_t* acc, const int16_t* w) {
+  for (int i = 0; i < HIDDEN; i += 8) {
+    __m128i a = _mm_load_si128((const __m128i*)(acc + i));
+    __m128i b = _mm_load_si128((const __m128i*)(w + i));
+    _mm_store_si128((__m128i*)(acc + i), _mm_add_epi16(a, b));
+  }
+}
+
+__attribute__((target("sse2")))
+void subSse2(int16_t* acc, const int16_t* w) {
+  for (int i = 0; i < HIDDEN; i += 8) {
+    __m128i a = _mm_load_si128((const __m128i*)(acc + i));
+    __m128i b = _mm_load_si128((const __m128i*)(w + i));
+    _mm_store_si128((__m128i*)(acc + i), _mm_sub_epi16(a, b));
+  }
+}
+
+__attribute__((target("sse2")))
+void addSubSse2(int16_t* acc, const int16_t* add, const int16_t* sub) {
+  for (int i = 0; i < HIDDEN; i += 8) {
+    __m128i a = _mm_load_si128((const __m128i*)(acc + i));
+    __m128i b = _mm_load_si128((const __m128i*)(add + i));
+    __m128i c = _mm_load_si128((const __m128i*)(sub + i));
+    _mm_store_si128((__m128i*)(acc + i), _mm_sub_epi16(_mm_add_epi16(a, b), c));
+  }
+}
+
+// int8 weights are sign extended to int16 so the whole dot product stays in
+// plain SSE2 (pmaddwd) without needing SSSE3's pmaddubsw.
+__attribute__((target("sse2")))
+int32_t dotSse2(const int16_t* acc, const int8_t* w, __m128i sum) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i top = _mm_set1_epi16(ACTIVATION_MAX);
+  for (int i = 0; i < HIDDEN; i += 16) {
+    __m128i a0 = _mm_load_si128((const __m128i*)(acc + i));
+    __m128i a1 = _mm_load_si128((const __m128i*)(acc + i + 8));
+    a0 = _mm_min_epi16(_mm_max_epi16(a0, zero), top);
+    a1 = _mm_min_epi16(_mm_max_epi16(a1, zero), top);
+    __m128i wb = _mm_load_si128((const __m128i*)(w + i));
+    __m128i w0 = _mm_srai_epi16(_mm_unpacklo_epi8(wb, wb), 8);
+    __m128i w1 = _mm_srai_epi16(_mm_unpackhi_epi8(wb, wb), 8);
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(a0, w0));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(a1, w1));
+  }
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+  return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("sse2")))
+int32_t outputSse2(const int16_t* us, const int16_t* them, const int8_t* w) {
+  return dotSse2(us, w, _mm_setzero_si128()) + dotSse2(them, w + HIDDEN, _mm_setzero_si128());
+}
+
+__attribute__((target("avx2")))
+void addAvx2(int16_t* acc, const int16_t* w) {
+  for (int i = 0; i < HIDDEN; i += 16) {
+    __m256i a = _mm256_load_si256((const __m256i*)(acc + i));
+    __m256i b = _mm256_load_si256((const __m256i*)(w + i));
+    _mm256_store_si256((__m256i*)(acc + i), _mm256_add_epi16(a, b));
+  }
+}
+
+__attribute__((target("avx2")))
+void subAvx2(int16_t* acc, const int16_t* w) {
+  for (int i = 0; i < HIDDEN; i += 16) {
+    __m256i a = _mm256_load_si256((const __m256i*)(acc + i));
+    __m256i b = _mm256_load_si256((const __m256i*)(w + i));
+    _mm256_store_si256((__m256i*)(acc + i), _mm256_sub_epi16(a, b));
+  }
+}
+
+__attribute__((target("avx2")))
+void addSubAvx2(int16_t* acc, const int16_t* add, const int16_t* sub) {
+  for (int i = 0; i < HIDDEN; i += 16) {
+    __m256i a = _mm256_load_si256((const __m256i*)(acc + i));
+    __m256i b = _mm256_load_si256((const __m256i*)(add + i));
+    __m256i c = _mm256_load_si256((const __m256i*)(sub + i));
+    _mm256_store_si256((__m256i*)(acc + i), _mm256_sub_epi16(_mm256_add_epi16(a, b), c));
+  }
+}
+
+// Clipped activations are packed to uint8 so pmaddubsw multiplies 32 pairs
+// per instruction; 2 * 127 * 127 still fits the int16 intermediate.
+__attribute__((target("avx2")))
+__m256i dotAvx2(const int16_t* acc, const int8_t* w, __m256i sum) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i top = _mm256_set1_epi16(ACTIVATION_MAX);
+  const __m256i ones = _mm256_set1_epi16(1);
+  for (int i = 0; i < HIDDEN; i += 32) {
+    __m256i a0 = _mm256_load_si256((const __m256i*)(acc + i));
+    __m256i a1 = _mm256_load_si256((const __m256i*)(acc + i + 16));
+    a0 = _mm256_min_epi16(_mm256_max_epi16(a0, zero), top);
+    a1 = _mm256_min_epi16(_mm256_max_epi16(a1, zero), top);
+    // packus works per 128-bit lane, the permute restores linear order
+    __m256i a = _mm256_permute4x64_epi64(_mm256_packus_epi16(a0, a1), 0xD8);
+    __m256i b = _mm256_load_si256((const __m256i*)(w + i));
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(a, b), ones));
+  }
+  return sum;
+}
+
+__attribute__((target("avx2")))
+int32_t outputAvx2(const int16_t* us, const int16_t* them, const int8_t* w) {
+  __m256i sum = dotAvx2(us, w, _mm256_setzero_si256());
+  sum = dotAvx2(them, w + HIDDEN, sum);
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+  return _mm_cvtsi128_si32(s);
+}
+
+#endif // NNUE_X86
+
+// NNUE_SIMD=scalar|sse2 in the environment caps the kernel set, which is
+// handy for comparing paths on the same machine.
+Kernels selectKernels() {
+  const Kernels scalar = {addScalar, subScalar, addSubScalar, outputScalar, "scalar"};
+#ifdef NNUE_X86
+  const char* cap = std::getenv("NNUE_SIMD");
+  bool allowAvx2 = !cap || (std::strcmp(cap, "scalar") != 0 && std::strcmp(cap, "sse2") != 0);
+  bool allowSse2 = !cap || std::strcmp(cap, "scalar") != 0;
+  __builtin_cpu_init();
+  if (allowAvx2 && __builtin_cpu_supports("avx2"))
+    return {addAvx2, subAvx2, addSubAvx2, outputAvx2, "avx2"};
+  if (allowSse2 && __builtin_cpu_supports("sse2"))
+    return {addSse2, subSse2, addSubSse2, outputSse2, "sse2"};
+#endif
+  return scalar;
+}
+
+const Kernels& kernels() {
+  static const Kernels k = selectKernels();
+  return k;
+}
+
+int kindOf(PieceType type, bool hidden) {
+  return hidden ? HIDDEN_KIND : static_cast<int>(type);
+}
+
+template <typename T>
+bool readArray(std::ifstream& in, T* data, size_t count) {
+  return bool(in.read(reinterpret_cast<char*>(data), sizeof(T) * count));
+}
+
+} // namespace
+
+int featureIndex(PieceColor perspective, PieceColor color, int kind, int row, int col) {
+  int sq = row * 8 + col;
+  if (perspective == BLACK)
+    sq ^= 56;
+  int side = (color == perspective) ? 0 : 1;
+  return (side * KINDS + kind) * 64 + sq;
+}
+
+bool loadNetwork(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    return false;
+
+  char magic[4];
+  uint32_t header[3];
+  if (!in.read(magic, 4) || std::memcmp(magic, "RVNN", 4) != 0)
+    return false;
+  if (!readArray(in, header, 3))
+    return false;
+  if (header[0] != FILE_VERSION || header[1] != FEATURES || header[2] != HIDDEN)
+    return false;
+
+  auto net = std::make_unique<Network>();
+  if (!readArray(in, net->ftBias, HIDDEN) ||
+      !readArray(in, net->ftWeights, size_t(FEATURES) * HIDDEN) ||
+      !readArray(in, net->outWeights, 2 * HIDDEN) ||
+      !readArray(in, &net->outBias, 1))
+    return false;
+
+  network = *net;
+  loaded = true;
+  return true;
+}
+
+bool networkLoaded() {
+  return loaded;
+}
+
+const char* simdName() {
+  return kernels().name;
+}
+
+Accumulator::Accumulator() {
+  std::memset(values, 0, sizeof(values));
+}
+
+void Accumulator::refresh(const Board& board) {
+  for (int p = 0; p < 2; p++)
+    std::memcpy(values[p], network.ftBias, sizeof(values[p]));
+
+  for (int i = 0; i < 8; i++) {
+    for (int j = 0; j < 8; j++) {
+      if (board.isOccupied(i, j))
+        pieceAdded(board.getColor(i, j), board.getPiece(i, j)->getType(), board.isHidden(i, j), i, j);
+    }
+  }
+}
+
+void Accumulator::pieceAdded(PieceColor color, PieceType type, bool hidden, int row, int col) {
+  int kind = kindOf(type, hidden);
+  for (PieceColor p : {WHITE, BLACK})
+    kernels().add(values[p], column(featureIndex(p, color, kind, row, col)));
+}
+
+void Accumulator::pieceRemoved(PieceColor color, PieceType type, bool hidden, int row, int col) {
+  int kind = kindOf(type, hidden);
+  for (PieceColor p : {WHITE, BLACK})
+    kernels().sub(values[p], column(featureIndex(p, color, kind, row, col)));
+}
+
+void Accumulator::pieceMoved(PieceColor color, PieceType type, bool fromHidden,
+                             int srcRow, int srcCol, int dstRow, int dstCol) {
+  int fromKind = kindOf(type, fromHidden);
+  int toKind = kindOf(type, false);
+  for (PieceColor p : {WHITE, BLACK}) {
+    kernels().addSub(values[p], column(featureIndex(p, color, toKind, dstRow, dstCol)),
+                     column(featureIndex(p, color, fromKind, srcRow, srcCol)));
+  }
+}
+
+int Accumulator::evaluate(PieceColor side) const {
+  PieceColor other = (side == WHITE) ? BLACK : WHITE;
+  int32_t out = network.outBias + kernels().output(values[side], values[other], network.outWeights);
+  return int(int64_t(out) * EVAL_SCALE / (ACTIVATION_MAX * WEIGHT_SCALE));
+}
+
+} // namespace nnue
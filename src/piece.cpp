@@ -1,5 +1,53 @@
 #include "../header/piece.hpp"
 
+#include <new>
+
+namespace {
+
+// freed pieces a thread keeps; the rest go back to the heap
+constexpr std::size_t CACHE_LIMIT = 1024;
+
+// trivially destructible, so a piece freed during thread exit (after the
+// flusher below ran) still finds a valid list and bypasses it
+thread_local void* freeHead = nullptr;
+thread_local std::size_t freeCount = 0;
+thread_local bool exiting = false;
+
+struct Flusher {
+  ~Flusher() {
+    exiting = true;
+    while (freeHead) {
+      void* next = *static_cast<void**>(freeHead);
+      ::operator delete(freeHead);
+      freeHead = next;
+    }
+    freeCount = 0;
+  }
+};
+thread_local Flusher flusher;
+
+}
+
+void* Piece::operator new(std::size_t size) {
+  if (size != sizeof(Piece) || !freeHead)
+    return ::operator new(size);
+  void* p = freeHead;
+  freeHead = *static_cast<void**>(p);
+  freeCount--;
+  return p;
+}
+
+void Piece::operator delete(void* p, std::size_t size) {
+  if (size != sizeof(Piece) || freeCount >= CACHE_LIMIT || exiting) {
+    ::operator delete(p);
+    return;
+  }
+  (void)&flusher;   // registers the flush at thread exit
+  *static_cast<void**>(p) = freeHead;
+  freeHead = p;
+  freeCount++;
+}
+
 Piece::Piece(PieceType type, PieceColor color) : type(type), color(color) {}
 
 Piece::Piece(PieceType type, PieceColor color, bool moved) : type(type), color(color), moved(moved) {}
@@ -24,6 +72,11 @@ void Piece::setMoved() {
 }
 
 
+void Piece::resetMoved() {
+  this->moved = false;
+}
+
+
 bool Piece::getAlive() const{
   return this->alive;
 }
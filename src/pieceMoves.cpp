@@ -1,13 +1,21 @@
 #include "../header/pieceMoves.hpp"
+#include "../header/attacks.hpp"
+#include "../header/legalMoves.hpp"
+#include "../header/trace.hpp"
 
 PieceMoves::PieceMoves(Board* board) : board(board) {}
 
 std::vector<Position> PieceMoves::validMoves(int row, int col) {
-  std::vector<Position> moves;
   if (!(board->isOccupied(row, col)))
     return {};
-  moves = generateMoves(row, col);
-  validateMoves(row, col, moves);
+  LegalMoves legal(*board, board->getColor(row, col));
+  MoveList list;
+  legal.generateFrom(squareOf(row, col), list);
+
+  std::vector<Position> moves;
+  moves.reserve(list.size());
+  for (const Move& m : list)
+    moves.push_back(m.dst());
   return moves;
 }
 
@@ -41,71 +49,13 @@ std::vector<Position> PieceMoves::generateMoves(int row, int col) {
 
 
 std::vector<Position> PieceMoves::bishopMoves(int row, int col) {
-  std::vector<Position> possibleMoves;
-  PieceColor color = board->getColor(row, col);
-
-  // up right
-  for(int i = row+1, j=col+1; i<8 && j<8; i++, j++) {
-    if (checkMove(i, j, color, possibleMoves))
-      break;
-  }
-
-  // down right
-  for(int i = row-1, j=col+1; i>=0 && j<8; i--, j++) {
-    if (checkMove(i, j, color, possibleMoves))
-      break;
-  }
-
-  // up left
-  for(int i = row+1, j=col-1; i<8 && j>=0; i++, j--) {
-    if (checkMove(i, j, color, possibleMoves))
-      break;
-  }
-
-  // down left
-  for(int i = row-1, j=col-1; i>=0 && j>=0; i--, j--) {
-    if (checkMove(i, j, color, possibleMoves))
-      break;
-  }
-
-  return possibleMoves;
+  int sq = squareOf(row, col);
+  return toPositions(bishopAttacks(sq, board->occupied()) & ~board->pieces(board->getColor(row, col)));
 }
 
 std::vector<Position> PieceMoves::kingMoves(int row, int col) {
-  std::vector<Position> possibleMoves;
   PieceColor color = board->getColor(row, col);
-
-  // up
-  if (row+1<8)
-    checkMove(row+1, col, color, possibleMoves);
-
-  // down
-  if (row-1>=0)
-    checkMove(row-1, col, color, possibleMoves);
-
-  // right
-  if (col+1<8)
-    checkMove(row, col+1, color, possibleMoves);
-
-  // left
-  if (col-1>=0)
-    checkMove(row, col-1, color, possibleMoves);
-
-  // up right
-  if (row+1<8 && col+1<8)
-    checkMove(row+1, col+1, color, possibleMoves);
-
-  // up left
-  if (row+1<8 && col-1>=0)
-    checkMove(row+1, col-1, color, possibleMoves);
-
-  // down right
-  if (row-1>=0 && col+1<8)
-    checkMove(row-1, col+1, color, possibleMoves);
-
-  // down left
-  if (row-1>=0 && col-1>=0)
-    checkMove(row-1, col-1, color, possibleMoves);
+  std::vector<Position> possibleMoves = toPositions(kingAttacks(squareOf(row, col)) & ~board->pieces(color));
 
   // castling
   if (!(board->pieceMoved(row, col))) {
@@ -137,127 +87,50 @@ std::vector<Position> PieceMoves::kingMoves(int row, int col) {
 
   return possibleMoves;
 }
-std::vector<Position> PieceMoves::knightMoves(int row, int col) {
-  std::vector<Position> possibleMoves;
-  PieceColor color = board->getColor(row, col);
-
-  // up 2, right 1
-  if (row+2<8 && col+1<8)
-    checkMove(row+2, col+1, color, possibleMoves);
-
-  // up 1, right 2
-  if (row+1<8 && col+2<8)
-    checkMove(row+1, col+2, color, possibleMoves);
-
-  // down 2, right 1
-  if (row-2>=0 && col+1<8) 
-    checkMove(row-2, col+1, color, possibleMoves);
-
-  // down 1, right 2
-  if (row-1>=0 && col+2<8)
-    checkMove(row-1, col+2, color, possibleMoves);
-
-  // up 2, left 1
-  if (row+2<8 && col-1>=0)
-    checkMove(row+2, col-1, color, possibleMoves);
-
-  // up 1, left 2
-  if (row+1<8 && col-2>=0)
-    checkMove(row+1, col-2, color, possibleMoves);
 
-  // down 2, left 1
-  if (row-2>=0 && col-1>=0)
-    checkMove(row-2, col-1, color, possibleMoves);
-
-  // down 1, left 2
-  if (row-1>=0 && col-2>=0)
-    checkMove(row-1, col-2, color, possibleMoves);
-
-  return possibleMoves;
+std::vector<Position> PieceMoves::knightMoves(int row, int col) {
+  return toPositions(knightAttacks(squareOf(row, col)) & ~board->pieces(board->getColor(row, col)));
 }
 
 std::vector<Position> PieceMoves::pawnMoves(int row, int col) {
-  std::vector<Position> possibleMoves;
   PieceColor color = board->getColor(row, col);
-
-  int direction = 1;
-  if (color == BLACK)
-    direction = -1;
-  
-  if ((direction == 1 && row < 7) || (direction == -1 && row > 0)) {
-    if ((board->isOccupied(row+direction,col+1)) && board->getColor(row+direction,col+1) != color)
-      possibleMoves.push_back(Position(row+direction,col+1));
-    if ((board->isOccupied(row+direction,col-1)) && board->getColor(row+direction,col-1) != color)
-      possibleMoves.push_back(Position(row+direction,col-1));
-
-    if (!(board->isOccupied(row+direction,col)))
-      possibleMoves.push_back(Position(row+direction,col));
-    else
-      return possibleMoves;
-  }
-  
-  if (!(board->pieceMoved(row, col))) {
-    if (!(board->isOccupied(row+2*direction,col)))
-      possibleMoves.push_back(Position(row+2*direction,col));
-  }
-
-  return possibleMoves;
+  PieceColor enemy = (color == WHITE) ? BLACK : WHITE;
+  int sq = squareOf(row, col);
+  Bitboard b = squareBB(sq);
+  Bitboard empty = ~board->occupied();
+
+  // a pawn on the last rank cannot move, there is no promotion
+  Bitboard one = (color == WHITE) ? shift<8>(b) & empty : shift<-8>(b) & empty;
+  Bitboard two = 0;
+  if (one && !board->pieceMoved(row, col))
+    two = (color == WHITE) ? shift<8>(one) & empty : shift<-8>(one) & empty;
+
+  return toPositions((pawnAttacks(color, sq) & board->pieces(enemy)) | one | two);
 }
 
 std::vector<Position> PieceMoves::queenMoves(int row, int col) {
-  std::vector<Position> possibleMoves = rookMoves(row, col);
-  std::vector<Position> diagonal = bishopMoves(row, col);
-  possibleMoves.insert(possibleMoves.end(), diagonal.begin(), diagonal.end());
-
-  return possibleMoves;
+  int sq = squareOf(row, col);
+  Bitboard occ = board->occupied();
+  return toPositions((bishopAttacks(sq, occ) | rookAttacks(sq, occ)) & ~board->pieces(board->getColor(row, col)));
 }
 
 std::vector<Position> PieceMoves::rookMoves(int row, int col) {
-  std::vector<Position> possibleMoves;
-  PieceColor color = board->getColor(row, col);
-  // right 
-  for(int j = col+1; j < 8; j++) {
-    if (checkMove(row, j, color, possibleMoves))
-      break;
-  }
-
-  // left
-  for(int j = col-1; j >= 0 ; j--) {
-    if (checkMove(row, j, color, possibleMoves))
-      break;
-  }
-
-  // down
-  for(int i = row-1; i >= 0 ; i--) {
-    if (checkMove(i, col, color, possibleMoves))
-      break;
-  }
-
-  // up
-  for(int i = row+1; i < 8 ; i++) {
-    if (checkMove(i, col, color, possibleMoves))
-      break;
-  }
-  
-  // Haven't added castling
-
-  return possibleMoves;
+  int sq = squareOf(row, col);
+  return toPositions(rookAttacks(sq, board->occupied()) & ~board->pieces(board->getColor(row, col)));
 }
 
-bool PieceMoves::checkMove(int row, int col, PieceColor color,std::vector<Position>& moves) {
-  if (!(board->isOccupied(row,col))) {
-    moves.push_back(Position(row,col));
-  }  
-  else {
-    if ((board->getColor(row,col) != color)) {
-      moves.push_back(Position(row,col));
-    } 
-    return true;
+std::vector<Position> PieceMoves::toPositions(Bitboard targets) {
+  std::vector<Position> moves;
+  moves.reserve(popCount(targets));
+  while (targets) {
+    int sq = popLsb(targets);
+    moves.push_back(Position(sq / 8, sq % 8));
   }
-  return false;
+  return moves;
 }
 
 void PieceMoves::validateMoves(int row, int col, std::vector<Position>& moves) {
+  TRACE_SCOPE("PieceMoves::validateMoves");
   if (moves.size() == 0)
     return;
   
@@ -0,0 +1,75 @@
+#include "../header/positionHistory.hpp"
+
+PositionHistory::PositionHistory() {
+  clear();
+}
+
+void PositionHistory::clear() {
+  head = 0;
+  size = 0;
+  for (int i = 0; i < TABLE_SIZE; i++)
+    table[i].count = 0;
+}
+
+int PositionHistory::findSlot(uint64_t key) const {
+  int i = int(key & (TABLE_SIZE - 1));
+  while (table[i].count != 0 && table[i].key != key)
+    i = (i + 1) & (TABLE_SIZE - 1);
+  return i;
+}
+
+void PositionHistory::increment(uint64_t key) {
+  int i = findSlot(key);
+  table[i].key = key;
+  table[i].count++;
+}
+
+void PositionHistory::decrement(uint64_t key) {
+  int i = findSlot(key);
+  if (table[i].count == 0 || --table[i].count != 0)
+    return;
+
+  // backward shift deletion keeps linear probing chains intact
+  int j = i;
+  for (;;) {
+    j = (j + 1) & (TABLE_SIZE - 1);
+    if (table[j].count == 0)
+      break;
+    int home = int(table[j].key & (TABLE_SIZE - 1));
+    bool reachable = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+    if (reachable)
+      continue;
+    table[i] = table[j];
+    table[j].count = 0;
+    i = j;
+  }
+}
+
+int PositionHistory::push(uint64_t key) {
+  if (size == CAPACITY) {
+    // drop the oldest entry, it is far outside any repetition window
+    decrement(ring[head]);
+    size--;
+  }
+  ring[head] = key;
+  head = (head + 1) % CAPACITY;
+  size++;
+  increment(key);
+  return count(key);
+}
+
+void PositionHistory::pop() {
+  if (size == 0)
+    return;
+  head = (head + CAPACITY - 1) % CAPACITY;
+  size--;
+  decrement(ring[head]);
+}
+
+int PositionHistory::count(uint64_t key) const {
+  return int(table[findSlot(key)].count);
+}
+
+int PositionHistory::length() const {
+  return size;
+}
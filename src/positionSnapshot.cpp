@@ -0,0 +1,55 @@
+#include <algorithm>
+
+#include "../header/positionSnapshot.hpp"
+#include "../header/revealBoard.hpp"
+
+namespace {
+
+// bit of a start square in PositionSnapshot::unmoved, -1 elsewhere
+int startBit(int sq) {
+  int row = sq / 8;
+  if (row < 2)
+    return sq;
+  if (row >= 6)
+    return sq - 32;
+  return -1;
+}
+
+}
+
+PositionSnapshot PositionSnapshot::capture(const Board& board, const Game& game) {
+  PositionSnapshot s;
+  s.occupied = board.occupied();
+  s.key = game.positionKey();
+  int n = 0;
+  for (Bitboard b = s.occupied; b; n++) {
+    int sq = popLsb(b);
+    const Piece* p = board.getPiece(sq / 8, sq % 8);
+    s.pieces[n / 2] |= uint8_t((p->getColor() << 3 | p->getType()) << (4 * (n & 1)));
+    if (!p->getMoved() && startBit(sq) >= 0)
+      s.unmoved |= uint32_t(1) << startBit(sq);
+  }
+  s.ply = uint16_t(std::min(game.getPly(), 0xffff));
+  s.halfmoveClock = uint8_t(std::min(game.getHalfmoveClock(), 0xff));
+  if (game.getCurrentTurn() == BLACK)
+    s.flags |= BLACK_TO_MOVE;
+  if (game.getDrawReason() == REPETITION)
+    s.flags |= REPETITION_DRAW;
+  return s;
+}
+
+void PositionSnapshot::restore(Board& board) const {
+  int n = 0;
+  for (Bitboard b = occupied; b; n++) {
+    int sq = popLsb(b);
+    int nibble = (pieces[n / 2] >> (4 * (n & 1))) & 15;
+    board.addPiece(PieceType(nibble & 7), PieceColor(nibble >> 3), sq / 8, sq % 8);
+    if (startBit(sq) < 0 || !(unmoved >> startBit(sq) & 1))
+      board.pieceSetMoved(sq / 8, sq % 8);
+  }
+}
+
+RevealBoard::RevealBoard(const RevealLayout& layout, const PositionSnapshot& position)
+    : Board(REVEAL_VARIANT), initial(layout) {
+  position.restore(*this);
+}
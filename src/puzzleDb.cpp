@@ -0,0 +1,211 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+
+#include "../header/puzzleDb.hpp"
+#include "../header/bitboard.hpp"
+#include "../header/fen.hpp"
+#include "../header/legalMoves.hpp"
+
+namespace {
+
+const char MAGIC[8] = {'P', 'U', 'Z', 'Z', 'L', 'E', 'D', 'B'};
+constexpr size_t HEADER_SIZE = 64;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t recordSize;
+  uint32_t reserved;
+  uint64_t count;
+};
+
+// "e2e4" -> Move; false for anything else (promotions included)
+bool parseUci(const std::string& text, Move& move) {
+  if (text.size() != 4 || text[0] < 'a' || text[0] > 'h' || text[2] < 'a' || text[2] > 'h' ||
+      text[1] < '1' || text[1] > '8' || text[3] < '1' || text[3] > '8')
+    return false;
+  move = Move((text[1] - '1') * 8 + (text[0] - 'a'), (text[3] - '1') * 8 + (text[2] - 'a'));
+  return true;
+}
+
+// plays move if it is legal for side
+bool playLegal(Board& board, PieceColor side, Move move) {
+  MoveList list;
+  LegalMoves(board, side).generate(list);
+  if (!list.contains(move))
+    return false;
+  MoveUndo undo;
+  board.doMove<StandardVariant>(move, undo);
+  delete undo.captured;
+  return true;
+}
+
+}
+
+Board* PuzzleRecord::board() const {
+  Board* board = new Board(variant());
+  for (int sq = 0; sq < 64; sq++) {
+    int nibble = (squares[sq / 2] >> ((sq & 1) * 4)) & 0xF;
+    if (nibble)
+      board->addPiece(PieceType((nibble & 7) - 1), (nibble & 8) ? WHITE : BLACK, sq / 8, sq % 8);
+  }
+  for (Bitboard moved = board->occupied() & ~unmoved; moved;) {
+    int sq = popLsb(moved);
+    board->pieceSetMoved(sq / 8, sq % 8);
+  }
+  return board;
+}
+
+PuzzleRecord PuzzleRecord::fromBoard(const Board& board, PieceColor turn) {
+  PuzzleRecord p{};
+  for (int sq = 0; sq < 64; sq++) {
+    if (!board.isOccupied(sq / 8, sq % 8))
+      continue;
+    int nibble = 1 + board.getPiece(sq / 8, sq % 8)->getType();
+    if (board.getColor(sq / 8, sq % 8) == WHITE)
+      nibble |= 8;
+    p.squares[sq / 2] |= uint8_t(nibble << ((sq & 1) * 4));
+  }
+  p.unmoved = board.unmovedPieces();
+  p.flags = uint8_t((turn == WHITE ? WHITE_TO_MOVE : 0) |
+                    (board.getVariant() == REVEAL_VARIANT ? REVEAL : 0));
+  return p;
+}
+
+bool puzzleFromCsv(const std::string& line, PuzzleRecord& out, std::string& error) {
+  std::vector<std::string> fields;
+  std::stringstream in(line);
+  std::string field;
+  while (std::getline(in, field, ','))
+    fields.push_back(field);
+  if (fields.size() < 4) {
+    error = "missing fields";
+    return false;
+  }
+
+  PieceColor turn;
+  int halfmoveClock;
+  std::unique_ptr<Board> board(boardFromFen(fields[1], STANDARD_VARIANT, turn, halfmoveClock, error));
+  if (!board)
+    return false;
+  std::vector<Move> moves;
+  std::istringstream words(fields[2]);
+  for (std::string word; words >> word;) {
+    Move move;
+    if (!parseUci(word, move)) {
+      error = "unsupported move " + word;
+      return false;
+    }
+    moves.push_back(move);
+  }
+  if (moves.size() < 2 || moves.size() - 1 > size_t(PuzzleRecord::MAX_PLIES)) {
+    error = "solution length";
+    return false;
+  }
+
+  // the opponent's setup move, then the position is the puzzle
+  if (!playLegal(*board, turn, moves[0])) {
+    error = "illegal setup move";
+    return false;
+  }
+  turn = (turn == WHITE) ? BLACK : WHITE;
+  out = PuzzleRecord::fromBoard(*board, turn);
+  out.rating = uint16_t(std::max(0, std::min(atoi(fields[3].c_str()), 65535)));
+  out.plies = uint8_t(moves.size() - 1);
+
+  PieceColor side = turn;
+  for (int i = 0; i < out.plies; i++) {
+    if (!playLegal(*board, side, moves[i + 1])) {
+      error = "illegal move at ply " + std::to_string(i);
+      return false;
+    }
+    out.solution[i] = moves[i + 1];
+    side = (side == WHITE) ? BLACK : WHITE;
+  }
+
+  if (fields.size() > 7) {
+    size_t at = fields[7].find("mateIn");
+    if (at != std::string::npos)
+      out.mateIn = uint8_t(atoi(fields[7].c_str() + at + 6));
+  }
+  return true;
+}
+
+PuzzleDb::~PuzzleDb() {
+  if (base)
+    munmap(const_cast<uint8_t*>(base), length);
+}
+
+bool PuzzleDb::open(const std::string& path, std::string& error) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    error = path + ": " + strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || size_t(st.st_size) < HEADER_SIZE) {
+    close(fd);
+    error = path + ": not a puzzle file";
+    return false;
+  }
+  void* mapped = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    error = path + ": " + strerror(errno);
+    return false;
+  }
+  // puzzles are picked at random; readahead would only waste page cache
+  madvise(mapped, size_t(st.st_size), MADV_RANDOM);
+
+  FileHeader header;
+  memcpy(&header, mapped, sizeof(header));
+  if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.recordSize != sizeof(PuzzleRecord) ||
+      header.count > (size_t(st.st_size) - HEADER_SIZE) / sizeof(PuzzleRecord)) {
+    munmap(mapped, size_t(st.st_size));
+    error = path + ": not a puzzle file";
+    return false;
+  }
+  if (base)
+    munmap(const_cast<uint8_t*>(base), length);
+  base = static_cast<const uint8_t*>(mapped);
+  length = size_t(st.st_size);
+  records = reinterpret_cast<const PuzzleRecord*>(base + HEADER_SIZE);
+  count = header.count;
+  return true;
+}
+
+bool PuzzleDb::write(const std::string& path, const std::vector<PuzzleRecord>& puzzles,
+                     std::string& error) {
+  std::string temp = path + ".tmp";
+  FILE* f = fopen(temp.c_str(), "wb");
+  if (!f) {
+    error = temp + ": " + strerror(errno);
+    return false;
+  }
+  uint8_t header[HEADER_SIZE] = {};
+  FileHeader fields{};
+  memcpy(fields.magic, MAGIC, sizeof(MAGIC));
+  fields.recordSize = sizeof(PuzzleRecord);
+  fields.count = puzzles.size();
+  memcpy(header, &fields, sizeof(fields));
+  bool ok = fwrite(header, sizeof(header), 1, f) == 1 &&
+            (puzzles.empty() || fwrite(puzzles.data(), sizeof(PuzzleRecord), puzzles.size(), f) == puzzles.size());
+  ok = (fflush(f) == 0) && ok && fsync(fileno(f)) == 0;
+  ok = (fclose(f) == 0) && ok;
+  // readers map the old file until they reopen; rename swaps atomically
+  if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+    error = path + ": " + strerror(errno);
+    unlink(temp.c_str());
+    return false;
+  }
+  return true;
+}
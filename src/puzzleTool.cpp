@@ -0,0 +1,133 @@
+// Builds and checks puzzle files (see puzzleDb.hpp).
+// usage: puzzle_tool pack <puzzles.csv> <out.bin>
+//          Lichess puzzle CSV in; lines these rules cannot play are skipped
+//        puzzle_tool verify <puzzles.bin> [threads] [depth] [sound.bin]
+//          checks every puzzle (puzzleVerify.hpp) on threads workers
+//          (default: all cores, depth 6), prints "index: reason" for each failure and
+//          optionally writes the sound ones to sound.bin
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../header/puzzleDb.hpp"
+#include "../header/puzzleVerify.hpp"
+#include "../header/search.hpp"
+
+namespace {
+
+int pack(const char* csvPath, const char* outPath) {
+  std::ifstream in(csvPath);
+  if (!in) {
+    fprintf(stderr, "cannot read %s\n", csvPath);
+    return 1;
+  }
+  std::vector<PuzzleRecord> puzzles;
+  std::map<std::string, size_t> skipped;
+  std::string line, error;
+  size_t lineNumber = 0;
+  while (std::getline(in, line)) {
+    if (lineNumber++ == 0 && line.rfind("PuzzleId", 0) == 0)
+      continue;
+    PuzzleRecord p;
+    if (puzzleFromCsv(line, p, error))
+      puzzles.push_back(p);
+    else
+      skipped[error.rfind("unsupported move", 0) == 0 ? "unsupported move" : error]++;
+  }
+  if (!PuzzleDb::write(outPath, puzzles, error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  printf("%zu puzzles written to %s\n", puzzles.size(), outPath);
+  for (const auto& s : skipped)
+    printf("  skipped %zu: %s\n", s.second, s.first.c_str());
+  return 0;
+}
+
+int verify(const char* path, int threads, int depth, const char* soundPath) {
+  PuzzleDb db;
+  std::string error;
+  if (!db.open(path, error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  // workers claim CHUNK puzzles at a time; mate proofs vary a lot in cost
+  constexpr size_t CHUNK = 64;
+  std::atomic<size_t> next{0}, done{0};
+  std::vector<uint8_t> sound(db.size(), 0);
+  std::vector<std::vector<std::pair<size_t, std::string>>> failures(threads);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      Search search(4);
+      std::string why;
+      for (size_t first; (first = next.fetch_add(CHUNK)) < db.size();) {
+        size_t last = std::min(first + CHUNK, db.size());
+        for (size_t i = first; i < last; i++) {
+          if (verifyPuzzle(db[i], search, depth, why))
+            sound[i] = 1;
+          else
+            failures[t].emplace_back(i, why);
+        }
+        done.fetch_add(last - first, std::memory_order_relaxed);
+      }
+    });
+  }
+  while (done.load() < db.size()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    fprintf(stderr, "\r%zu / %zu", done.load(), db.size());
+  }
+  for (std::thread& w : workers)
+    w.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::vector<std::pair<size_t, std::string>> all;
+  for (auto& f : failures)
+    all.insert(all.end(), f.begin(), f.end());
+  std::sort(all.begin(), all.end());
+  for (const auto& f : all)
+    printf("%zu: %s\n", f.first, f.second.c_str());
+  fprintf(stderr, "\r%zu puzzles, %zu unsound, %.1f s (%.0f puzzles/s on %d threads)\n", db.size(),
+          all.size(), seconds, db.size() / std::max(seconds, 1e-9), threads);
+
+  if (soundPath) {
+    std::vector<PuzzleRecord> kept;
+    for (size_t i = 0; i < db.size(); i++)
+      if (sound[i])
+        kept.push_back(db[i]);
+    if (!PuzzleDb::write(soundPath, kept, error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+  }
+  return all.empty() ? 0 : 2;
+}
+
+}
+
+int main(int argc, char** argv) {
+  std::string command = (argc > 1) ? argv[1] : "";
+  if (command == "pack" && argc == 4)
+    return pack(argv[2], argv[3]);
+  if (command == "verify" && argc >= 3) {
+    int threads = (argc > 3) ? atoi(argv[3]) : 0;
+    if (threads <= 0)
+      threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    int depth = (argc > 4) ? atoi(argv[4]) : 6;
+    return verify(argv[2], threads, std::max(1, depth), (argc > 5) ? argv[5] : nullptr);
+  }
+  fprintf(stderr, "usage: puzzle_tool pack <puzzles.csv> <out.bin>\n"
+                  "       puzzle_tool verify <puzzles.bin> [threads] [depth] [sound.bin]\n");
+  return 1;
+}
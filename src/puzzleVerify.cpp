@@ -0,0 +1,251 @@
+#include <memory>
+#include <utility>
+
+#include "../header/puzzleVerify.hpp"
+#include "../header/attacks.hpp"
+#include "../header/bitboard.hpp"
+#include "../header/legalMoves.hpp"
+#include "../header/moveGen.hpp"
+#include "../header/variant.hpp"
+
+namespace {
+
+template <PieceColor Us>
+constexpr PieceColor opponent() {
+  return Us == WHITE ? BLACK : WHITE;
+}
+
+std::string moveName(Move m) {
+  std::string s;
+  for (int sq : {m.from, m.to}) {
+    s += char('a' + sq % 8);
+    s += char('1' + sq / 8);
+  }
+  return s;
+}
+
+// AND/OR mate proof. Refutations repeat across siblings (the same king
+// step escapes most non-mating tries), so the last escape and the last
+// mating move found at each depth are tried first.
+class Prover {
+  private:
+    static constexpr int MAX_MATE = 8;
+    Move escape[MAX_MATE + 1];
+    Move mating[MAX_MATE + 1];
+
+    static void tryFirst(MoveList& list, Move move) {
+      for (int i = 1; i < list.count; i++) {
+        if (list.moves[i] == move) {
+          std::swap(list.moves[0], list.moves[i]);
+          return;
+        }
+      }
+    }
+    // false only if move cannot check the king on kingSq: a mate in one has
+    // to, and this is far cheaper than making the move
+    template <PieceColor Us>
+    static bool mayCheck(const Board& board, Move move, int kingSq) {
+      PieceType type = board.getPiece(move.from / 8, move.from % 8)->getType();
+      if (type == KING && (move.to - move.from == 2 || move.from - move.to == 2))
+        return true;   // castling: the rook may check
+      Bitboard occupied = (board.occupied() & ~squareBB(move.from)) | squareBB(move.to);
+      Bitboard target = squareBB(kingSq);
+      switch (type) {
+      case PAWN:   if (pawnAttacks(Us, move.to) & target) return true; break;
+      case KNIGHT: if (knightAttacks(move.to) & target) return true; break;
+      case BISHOP: if (bishopAttacks(move.to, occupied) & target) return true; break;
+      case ROOK:   if (rookAttacks(move.to, occupied) & target) return true; break;
+      case QUEEN:  if ((bishopAttacks(move.to, occupied) | rookAttacks(move.to, occupied)) & target) return true; break;
+      default: break;
+      }
+      // discovered: a slider behind the piece that moved away
+      Bitboard queens = board.pieces(Us, QUEEN);
+      Bitboard sliders = (bishopAttacks(kingSq, occupied) & (board.pieces(Us, BISHOP) | queens)) |
+                         (rookAttacks(kingSq, occupied) & (board.pieces(Us, ROOK) | queens));
+      return (sliders & ~squareBB(move.from)) != 0;
+    }
+  public:
+    // Us to move mates within n moves
+    template <class Variant, PieceColor Us>
+    bool mates(Board& board, int n) {
+      MoveList list;
+      generate<Us, ALL>(board, computeCheckInfo<Us>(board), list);
+      tryFirst(list, mating[n]);
+      Bitboard king = board.pieces(opponent<Us>(), KING);
+      for (Move move : list) {
+        if (n == 1 && king && !mayCheck<Us>(board, move, lsb(king)))
+          continue;
+        MoveUndo undo;
+        board.doMove<Variant>(move, undo);
+        bool won = lost<Variant, opponent<Us>()>(board, n);
+        board.undoMove<Variant>(move, undo);
+        if (won) {
+          mating[n] = move;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // Us to move is mated now, or (n > 1) every reply allows mate in n - 1
+    template <class Variant, PieceColor Us>
+    bool lost(Board& board, int n) {
+      // only a check can be mate; most leaves end on this test
+      if (n <= 1) {
+        Bitboard king = board.pieces(Us, KING);
+        if (!king || !attackersTo(board, lsb(king), opponent<Us>(), board.occupied()))
+          return false;
+      }
+      CheckInfo info = computeCheckInfo<Us>(board);
+      MoveList list;
+      generate<Us, ALL>(board, info, list);
+      if (list.empty())
+        return info.checkers != 0;
+      if (n <= 1)
+        return false;
+      tryFirst(list, escape[n]);
+      for (Move move : list) {
+        MoveUndo undo;
+        board.doMove<Variant>(move, undo);
+        bool mated = mates<Variant, opponent<Us>()>(board, n - 1);
+        board.undoMove<Variant>(move, undo);
+        if (!mated) {
+          escape[n] = move;
+          return false;
+        }
+      }
+      return true;
+    }
+
+    template <class Variant, PieceColor Us>
+    int countMating(Board& board, int n, int limit, MoveList* found) {
+      MoveList list;
+      generate<Us, ALL>(board, computeCheckInfo<Us>(board), list);
+      int count = 0;
+      for (Move move : list) {
+        MoveUndo undo;
+        board.doMove<Variant>(move, undo);
+        bool won = lost<Variant, opponent<Us>()>(board, n);
+        board.undoMove<Variant>(move, undo);
+        if (won) {
+          if (found)
+            found->add(move.from, move.to);
+          if (++count >= limit)
+            break;
+        }
+      }
+      return count;
+    }
+
+    template <class Variant>
+    bool matesAfter(Board& board, PieceColor side, Move move, int n) {
+      MoveUndo undo;
+      board.doMove<Variant>(move, undo);
+      bool won = (side == WHITE) ? lost<Variant, BLACK>(board, n) : lost<Variant, WHITE>(board, n);
+      board.undoMove<Variant>(move, undo);
+      return won;
+    }
+
+    static bool fits(int n) { return n >= 1 && n <= MAX_MATE; }
+};
+
+template <class Variant>
+bool verifyLine(const PuzzleRecord& p, Board& board, Search& search, int depth, std::string& why) {
+  if (p.plies == 0 || p.plies > PuzzleRecord::MAX_PLIES || p.plies % 2 == 0) {
+    why = "the line must end on the solver's move";
+    return false;
+  }
+  if (p.mateIn && p.plies != 2 * p.mateIn - 1) {
+    why = "mate in " + std::to_string(p.mateIn) + " needs " + std::to_string(2 * p.mateIn - 1) + " plies";
+    return false;
+  }
+  PieceColor side = p.turn();
+  PositionHistory history;
+  for (int ply = 0; ply < p.plies; ply++) {
+    Move move = p.solution[ply];
+    MoveList legal;
+    LegalMoves(board, side).generate(legal);
+    if (!legal.contains(move)) {
+      why = "ply " + std::to_string(ply) + ": " + moveName(move) + " is illegal";
+      return false;
+    }
+    if (ply % 2 == 0 && p.mateIn) {
+      int n = p.mateIn - ply / 2;
+      Prover prover;
+      if (!prover.matesAfter<Variant>(board, side, move, n)) {
+        why = "ply " + std::to_string(ply) + ": " + moveName(move) + " does not mate in " + std::to_string(n);
+        return false;
+      }
+      // the last move may be any mate
+      MoveList found;
+      int count = 1;
+      if (ply + 1 < p.plies)
+        count = (side == WHITE) ? prover.countMating<Variant, WHITE>(board, n, 2, &found)
+                                : prover.countMating<Variant, BLACK>(board, n, 2, &found);
+      if (count > 1) {
+        Move other = (found[0] == move) ? found[1] : found[0];
+        why = "ply " + std::to_string(ply) + ": " + moveName(other) + " mates too";
+        return false;
+      }
+    }
+    else if (ply % 2 == 0) {
+      SearchLimits limits;
+      limits.depth = depth;
+      history.clear();
+      Move best = search.run(board, side, 0, history, limits, [](const SearchReport&) {});
+      if (best != move) {
+        why = "ply " + std::to_string(ply) + ": search prefers " + moveName(best) + " to " + moveName(move);
+        return false;
+      }
+    }
+    MoveUndo undo;
+    board.doMove<Variant>(move, undo);
+    delete undo.captured;
+    side = (side == WHITE) ? BLACK : WHITE;
+  }
+  return true;
+}
+
+}
+
+int countMatingMoves(Board& board, PieceColor side, int n, int limit, MoveList* found) {
+  if (!Prover::fits(n))
+    return 0;
+  Prover prover;
+  return withVariant(board.getVariant(), [&](auto variant) {
+    using Variant = decltype(variant);
+    return (side == WHITE) ? prover.countMating<Variant, WHITE>(board, n, limit, found)
+                           : prover.countMating<Variant, BLACK>(board, n, limit, found);
+  });
+}
+
+bool verifyPuzzle(const PuzzleRecord& puzzle, Search& search, int depth, std::string& why) {
+  std::unique_ptr<Board> board(puzzle.board());
+  return withVariant(board->getVariant(), [&](auto variant) {
+    return verifyLine<decltype(variant)>(puzzle, *board, search, depth, why);
+  });
+}
+
+bool acceptsMove(const PuzzleRecord& puzzle, int ply, Move move) {
+  if (ply < 0 || ply >= puzzle.plies || ply % 2)
+    return false;
+  if (move == puzzle.solution[ply])
+    return true;
+  // any mate finishes a mate puzzle
+  if (!puzzle.mateIn || ply + 1 != puzzle.plies)
+    return false;
+  std::unique_ptr<Board> board(puzzle.board());
+  return withVariant(board->getVariant(), [&](auto variant) {
+    using Variant = decltype(variant);
+    PieceColor side = puzzle.turn();
+    for (int i = 0; i < ply; i++) {
+      MoveUndo undo;
+      board->doMove<Variant>(puzzle.solution[i], undo);
+      delete undo.captured;
+      side = (side == WHITE) ? BLACK : WHITE;
+    }
+    MoveList legal;
+    LegalMoves(*board, side).generate(legal);
+    return legal.contains(move) && Prover().matesAfter<Variant>(*board, side, move, 1);
+  });
+}
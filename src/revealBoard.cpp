@@ -1,57 +1,166 @@
 #include "../header/revealBoard.hpp"
+#include "../header/layoutTable.hpp"
+#include "../header/xoshiro.hpp"
 #include <algorithm>
+#include <atomic>
 #include <random>
 
-RevealBoard::RevealBoard() {
-  clearBoard();
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::vector<PieceType> whitePieces = {
-    QUEEN,
-    ROOK, ROOK,
-    BISHOP, BISHOP,
-    KNIGHT, KNIGHT,
-    PAWN, PAWN, PAWN, PAWN, PAWN, PAWN, PAWN, PAWN
-  };
-  std::vector<PieceType> blackPieces = whitePieces;
-  std::shuffle(whitePieces.begin(), whitePieces.end(), gen);
-  std::shuffle(blackPieces.begin(), blackPieces.end(), gen);
-
-  int count = 0;
-  // White Piece
-  for (int i=0; i<2; i++) {
-    for (int j=0; j<8; j++) {
-      if (i == 0 && j == 4)
-        addPiece(KING, WHITE, i, j);
-      else {
-        addPiece(whitePieces[count], WHITE, i, j);
-        count++;
+namespace {
+
+// back-row multiset, in the order the ranking enumerates types
+constexpr PieceType KINDS[] = {PAWN, KNIGHT, BISHOP, ROOK, QUEEN};
+constexpr int COUNTS[] = {8, 2, 2, 2, 1};
+// one side's pieces before shuffling
+constexpr PieceType SIDE[RevealLayout::SQUARES] = {
+  QUEEN,
+  ROOK, ROOK,
+  BISHOP, BISHOP,
+  KNIGHT, KNIGHT,
+  PAWN, PAWN, PAWN, PAWN, PAWN, PAWN, PAWN, PAWN
+};
+
+// a lopsided side is reshuffled at most this often; if a table rejects
+// nearly everything its limit is too tight, and the last draw is used
+constexpr int MAX_REDRAWS = 64;
+
+std::atomic<const LayoutTable*> layoutTable{nullptr};
+
+void shuffle(PieceType side[RevealLayout::SQUARES], Xoshiro256& rng) {
+  std::copy(SIDE, SIDE + RevealLayout::SQUARES, side);
+  for (int i = RevealLayout::SQUARES - 1; i > 0; i--)
+    std::swap(side[i], side[rng.below(i + 1)]);
+}
+
+uint64_t factorial(int n) {
+  uint64_t f = 1;
+  for (int i = 2; i <= n; i++)
+    f *= i;
+  return f;
+}
+
+// distinct arrangements of the remaining multiset
+uint64_t arrangements(const int counts[5]) {
+  int n = 0;
+  uint64_t divisor = 1;
+  for (int k = 0; k < 5; k++) {
+    n += counts[k];
+    divisor *= factorial(counts[k]);
+  }
+  return factorial(n) / divisor;
+}
+
+}
+
+uint32_t RevealLayout::rank(const PieceType side[SQUARES]) {
+  int counts[5];
+  std::copy(COUNTS, COUNTS + 5, counts);
+  uint64_t index = 0;
+  for (int i = 0; i < SQUARES; i++) {
+    for (int k = 0; k < 5; k++) {
+      if (KINDS[k] == side[i]) {
+        counts[k]--;
+        break;
       }
+      if (counts[k] == 0)
+        continue;
+      // every arrangement that puts kind k here comes first
+      counts[k]--;
+      index += arrangements(counts);
+      counts[k]++;
     }
   }
+  return uint32_t(index);
+}
 
-  // Black Piece
-  count = 0;
-  for (int i=7; i>=6; i--) {
-    for (int j=0; j<8; j++) {
-      if (i == 7 && j == 4)
-        addPiece(KING, BLACK, i, j);
-      else {
-        addPiece(blackPieces[count], BLACK, i, j);
-        count++;
+void RevealLayout::unrank(uint32_t index, PieceType side[SQUARES]) {
+  int counts[5];
+  std::copy(COUNTS, COUNTS + 5, counts);
+  uint64_t rest = index;
+  for (int i = 0; i < SQUARES; i++) {
+    for (int k = 0; k < 5; k++) {
+      if (counts[k] == 0)
+        continue;
+      counts[k]--;
+      uint64_t block = arrangements(counts);
+      if (rest < block) {
+        side[i] = KINDS[k];
+        break;
       }
+      rest -= block;
+      counts[k]++;
     }
   }
 }
 
-PieceType RevealBoard::getPieceType(int row, int col) const {
-  if (pieceMoved(row, col))
-    return chessBoard[row][col]->getType();
-  else {
-    return getInitialPieceType(row, col);
+uint64_t RevealLayout::index() const {
+  return uint64_t(rank(white)) * ARRANGEMENTS + rank(black);
+}
+
+RevealLayout RevealLayout::fromIndex(uint64_t index) {
+  RevealLayout layout;
+  unrank(uint32_t(index / ARRANGEMENTS), layout.white);
+  unrank(uint32_t(index % ARRANGEMENTS), layout.black);
+  return layout;
+}
+
+RevealLayout RevealLayout::fromSeed(uint64_t seed) {
+  Xoshiro256 rng(seed);
+  RevealLayout layout;
+  shuffle(layout.white, rng);
+  shuffle(layout.black, rng);
+  return layout;
+}
+
+RevealLayout RevealLayout::fromSeed(uint64_t seed, const LayoutTable& fair) {
+  Xoshiro256 rng(seed);
+  RevealLayout layout;
+  for (PieceType* side : {layout.white, layout.black}) {
+    shuffle(side, rng);
+    for (int i = 0; i < MAX_REDRAWS && !fair.fair(side); i++)
+      shuffle(side, rng);
+  }
+  return layout;
+}
+
+uint64_t RevealLayout::randomSeed() {
+  // one random_device read per thread instead of per board
+  thread_local Xoshiro256 seeds(std::random_device{}() ^ (uint64_t(std::random_device{}()) << 32));
+  return seeds.next();
+}
+
+RevealBoard::RevealBoard() : Board(REVEAL_VARIANT) {
+  const LayoutTable* fair = layoutTable.load(std::memory_order_acquire);
+  uint64_t seed = RevealLayout::randomSeed();
+  initial = fair ? RevealLayout::fromSeed(seed, *fair) : RevealLayout::fromSeed(seed);
+  place();
+}
+
+void RevealBoard::setLayoutTable(const LayoutTable* fair) {
+  layoutTable.store(fair, std::memory_order_release);
+}
+
+RevealBoard::RevealBoard(uint64_t seed) : Board(REVEAL_VARIANT), initial(RevealLayout::fromSeed(seed)) {
+  place();
+}
+
+RevealBoard::RevealBoard(const RevealLayout& layout) : Board(REVEAL_VARIANT), initial(layout) {
+  place();
+}
+
+// Fills an empty board without a listener, so pieces go straight into the
+// summary (trackAdd) instead of through addPiece and its notifications.
+void RevealBoard::place() {
+  for (int row : {0, 1, 7, 6}) {
+    PieceColor color = (row < 2) ? WHITE : BLACK;
+    bool backRank = (row == 0 || row == 7);
+    // layout order: back rank without the king, then the pawn rank
+    const PieceType* side = (color == WHITE) ? initial.white : initial.black;
+    const PieceType* next = backRank ? side : side + 7;
+    for (int col = 0; col < 8; col++) {
+      PieceType type = (backRank && col == 4) ? KING : *next++;
+      chessBoard[row][col] = makeNewPiece(type, color);
+      trackAdd<RevealVariant>(row, col);
+    }
   }
 }
 
-Board* RevealBoard::clone() const {
-  return new RevealBoard(*this);
-}
\ No newline at end of file
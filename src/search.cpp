@@ -0,0 +1,398 @@
+#include <algorithm>
+#include <cstring>
+
+#include "../header/search.hpp"
+#include "../header/eval.hpp"
+#include "../header/zobrist.hpp"
+
+namespace {
+
+enum Bound : uint8_t {
+  BOUND_NONE,
+  BOUND_UPPER,
+  BOUND_LOWER,
+  BOUND_EXACT,
+};
+
+constexpr int INF = MATE_SCORE + 1;
+// scores beyond this are mates, stored in the table relative to the node
+constexpr int MATE_BOUND = MATE_SCORE - MAX_PLY;
+
+// move ordering buckets
+constexpr int TT_MOVE_SCORE = 1 << 30;
+constexpr int CAPTURE_SCORE = 1 << 28;
+constexpr int KILLER_SCORE = 1 << 27;
+
+int scoreToTable(int score, int ply) {
+  if (score >= MATE_BOUND)
+    return score + ply;
+  if (score <= -MATE_BOUND)
+    return score - ply;
+  return score;
+}
+
+int scoreFromTable(int score, int ply) {
+  if (score >= MATE_BOUND)
+    return score - ply;
+  if (score <= -MATE_BOUND)
+    return score + ply;
+  return score;
+}
+
+template <PieceColor Us>
+constexpr PieceColor opponent() {
+  return Us == WHITE ? BLACK : WHITE;
+}
+
+// move the next best scored move to index i
+void pickMove(MoveList& list, int* scores, int i) {
+  int best = i;
+  for (int j = i + 1; j < list.count; j++)
+    if (scores[j] > scores[best])
+      best = j;
+  std::swap(list.moves[i], list.moves[best]);
+  std::swap(scores[i], scores[best]);
+}
+
+}
+
+Search::Search(int hashMegabytes) {
+  resize(hashMegabytes);
+}
+
+void Search::resize(int hashMegabytes) {
+  size_t entries = 1;
+  size_t wanted = size_t(std::max(hashMegabytes, 1)) * 1024 * 1024 / sizeof(TTEntry);
+  while (entries * 2 <= wanted)
+    entries *= 2;
+  table.assign(entries, TTEntry());
+  tableMask = entries - 1;
+  clear();
+}
+
+void Search::clear() {
+  std::fill(table.begin(), table.end(), TTEntry());
+  std::memset(historyScore, 0, sizeof(historyScore));
+}
+
+void Search::stop() {
+  stopFlag.store(true, std::memory_order_relaxed);
+}
+
+void Search::clearStop() {
+  stopFlag.store(false, std::memory_order_relaxed);
+}
+
+uint64_t Search::nodesSearched() const {
+  return nodeCount.load(std::memory_order_relaxed);
+}
+
+int64_t Search::elapsedMs() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - startTime).count();
+}
+
+// polled every node, the clock only every 1024 nodes
+bool Search::checkStop() {
+  if (stopped)
+    return true;
+  if ((nodes & 1023) == 0) {
+    nodeCount.store(nodes, std::memory_order_relaxed);
+    if (stopFlag.load(std::memory_order_relaxed) || (hardLimitMs && elapsedMs() >= hardLimitMs))
+      stopped = true;
+  }
+  if (nodeLimit && nodes >= nodeLimit)
+    stopped = true;
+  return stopped;
+}
+
+template <PieceColor Us>
+uint64_t Search::positionKey() const {
+  return board->hash() ^ (Us == BLACK ? zobrist::KEYS.side : 0);
+}
+
+template <PieceColor Us>
+void Search::scoreMoves(const MoveList& list, int* scores, Move ttMove, int ply) const {
+  Bitboard theirs = board->pieces(opponent<Us>());
+  for (int i = 0; i < list.count; i++) {
+    Move m = list[i];
+    if (m == ttMove)
+      scores[i] = TT_MOVE_SCORE;
+    else if (theirs & squareBB(m.to))
+      // most valuable victim, least valuable attacker
+      scores[i] = CAPTURE_SCORE + 16 * PIECE_VALUE[board->getPieceType(m.to / 8, m.to % 8)]
+                - board->getPieceType(m.from / 8, m.from % 8);
+    else if (m == killers[ply][0] || m == killers[ply][1])
+      scores[i] = KILLER_SCORE;
+    else
+      scores[i] = historyScore[m.from][m.to];
+  }
+}
+
+template <class Variant, PieceColor Us>
+int Search::quiesce(int alpha, int beta, int ply) {
+  constexpr PieceColor Them = opponent<Us>();
+  pvLength[ply] = ply;
+  nodes++;
+  if (checkStop())
+    return 0;
+  if (ply >= MAX_PLY)
+    return evaluate(*board, acc, Us);
+
+  CheckInfo info = computeCheckInfo<Us>(*board);
+  int best = -INF;
+  MoveList list;
+  if (info.checkers) {
+    generate<Us, EVASIONS>(*board, info, list);
+    if (list.empty())
+      return -MATE_SCORE + ply;
+  }
+  else {
+    best = evaluate(*board, acc, Us);
+    if (best >= beta)
+      return best;
+    alpha = std::max(alpha, best);
+    generate<Us, CAPTURES>(*board, info, list);
+  }
+
+  int scores[MoveList::CAPACITY];
+  scoreMoves<Us>(list, scores, Move(), ply);
+  for (int i = 0; i < list.count; i++) {
+    pickMove(list, scores, i);
+    Move m = list[i];
+    MoveUndo undo;
+    board->doMove<Variant>(m, undo);
+    int score = -quiesce<Variant, Them>(-beta, -alpha, ply + 1);
+    board->undoMove<Variant>(m, undo);
+    if (stopped)
+      return 0;
+    if (score > best) {
+      best = score;
+      if (score > alpha) {
+        alpha = score;
+        if (score >= beta)
+          break;
+      }
+    }
+  }
+  return best;
+}
+
+template <class Variant, PieceColor Us>
+int Search::negamax(int depth, int alpha, int beta, int ply, bool allowNull) {
+  constexpr PieceColor Them = opponent<Us>();
+  bool pvNode = beta - alpha > 1;
+  pvLength[ply] = ply;
+  uint64_t key = positionKey<Us>();
+
+  if (ply > 0) {
+    // the current position is already in history, a second entry is a repetition
+    if (clock[ply] >= 100 || history->count(key) >= 2 || board->insufficientMaterial())
+      return 0;
+    if (ply >= MAX_PLY)
+      return evaluate(*board, acc, Us);
+  }
+
+  CheckInfo info = computeCheckInfo<Us>(*board);
+  bool inCheck = info.checkers != 0;
+  if (inCheck)
+    depth++;
+  if (depth <= 0)
+    return quiesce<Variant, Us>(alpha, beta, ply);
+
+  nodes++;
+  if (checkStop())
+    return 0;
+
+  TTEntry& entry = table[key & tableMask];
+  Move ttMove;
+  if (entry.key == key) {
+    ttMove = entry.move;
+    int ttScore = scoreFromTable(entry.score, ply);
+    if (!pvNode && entry.depth >= depth &&
+        (entry.bound == BOUND_EXACT ||
+         (entry.bound == BOUND_LOWER && ttScore >= beta) ||
+         (entry.bound == BOUND_UPPER && ttScore <= alpha)))
+      return ttScore;
+  }
+
+  // null move: if passing still fails high, a real move will too; skipped
+  // without pieces, where zugzwang makes passing a bad guess
+  Bitboard pieces = board->pieces(Us) & ~board->pieces(Us, PAWN) & ~board->pieces(Us, KING);
+  if (allowNull && !pvNode && !inCheck && depth >= 3 && pieces &&
+      evaluate(*board, acc, Us) >= beta) {
+    clock[ply + 1] = clock[ply] + 1;
+    history->push(key ^ zobrist::KEYS.side);
+    int score = -negamax<Variant, Them>(depth - 3, -beta, -beta + 1, ply + 1, false);
+    history->pop();
+    if (stopped)
+      return 0;
+    if (score >= beta)
+      return score >= MATE_BOUND ? beta : score;
+  }
+
+  MoveList list;
+  generate<Us, ALL>(*board, info, list);
+  if (list.empty())
+    return inCheck ? -MATE_SCORE + ply : 0;
+  if (ply == 0 && !excluded.empty()) {
+    int kept = 0;
+    for (int i = 0; i < list.count; i++)
+      if (!excluded.contains(list[i]))
+        list.moves[kept++] = list[i];
+    list.count = kept;
+  }
+
+  int scores[MoveList::CAPACITY];
+  scoreMoves<Us>(list, scores, ttMove, ply);
+  int best = -INF;
+  Move bestMove;
+  int originalAlpha = alpha;
+  Bitboard theirs = board->pieces(Them);
+  for (int i = 0; i < list.count; i++) {
+    pickMove(list, scores, i);
+    Move m = list[i];
+    bool capture = theirs & squareBB(m.to);
+    bool irreversible = capture || board->getPieceType(m.from / 8, m.from % 8) == PAWN;
+    clock[ply + 1] = irreversible ? 0 : clock[ply] + 1;
+
+    MoveUndo undo;
+    board->doMove<Variant>(m, undo);
+    history->push(positionKey<Them>());
+    int score;
+    if (i == 0) {
+      score = -negamax<Variant, Them>(depth - 1, -beta, -alpha, ply + 1, true);
+    }
+    else {
+      int reduction = (depth >= 3 && i >= 3 && !capture && !inCheck) ? (i >= 8 ? 2 : 1) : 0;
+      score = -negamax<Variant, Them>(depth - 1 - reduction, -alpha - 1, -alpha, ply + 1, true);
+      if (score > alpha && reduction)
+        score = -negamax<Variant, Them>(depth - 1, -alpha - 1, -alpha, ply + 1, true);
+      if (score > alpha && score < beta)
+        score = -negamax<Variant, Them>(depth - 1, -beta, -alpha, ply + 1, true);
+    }
+    history->pop();
+    board->undoMove<Variant>(m, undo);
+    if (stopped)
+      return 0;
+
+    if (score > best) {
+      best = score;
+      bestMove = m;
+      if (score > alpha) {
+        alpha = score;
+        pv[ply][ply] = m;
+        for (int j = ply + 1; j < pvLength[ply + 1]; j++)
+          pv[ply][j] = pv[ply + 1][j];
+        pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+        if (score >= beta) {
+          if (!capture) {
+            if (killers[ply][0] != m) {
+              killers[ply][1] = killers[ply][0];
+              killers[ply][0] = m;
+            }
+            historyScore[m.from][m.to] = std::min(historyScore[m.from][m.to] + depth * depth, KILLER_SCORE - 1);
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  // a root with excluded moves has a different value; keep it out of the table
+  if (ply == 0 && !excluded.empty())
+    return best;
+  entry.key = key;
+  entry.score = int16_t(scoreToTable(best, ply));
+  entry.move = bestMove;
+  entry.depth = int8_t(depth);
+  entry.bound = best >= beta ? BOUND_LOWER : (alpha > originalAlpha ? BOUND_EXACT : BOUND_UPPER);
+  return best;
+}
+
+template <class Variant, PieceColor Us>
+int Search::iterate(int depth, int alpha, int beta) {
+  return negamax<Variant, Us>(depth, alpha, beta, 0, false);
+}
+
+Move Search::run(Board& searchBoard, PieceColor side, int halfmoveClock, PositionHistory& positions,
+                 const SearchLimits& limits, const std::function<void(const SearchReport&)>& report) {
+  startTime = std::chrono::steady_clock::now();
+  board = &searchBoard;
+  history = &positions;
+  nodes = 0;
+  nodeCount.store(0, std::memory_order_relaxed);
+  nodeLimit = limits.nodes;
+  stopped = false;
+  std::memset(killers, 0, sizeof(killers));
+  clock[0] = halfmoveClock;
+
+  // soft limit: don't start another iteration; hard limit: abort this one
+  int64_t softLimitMs = 0;
+  hardLimitMs = 0;
+  if (limits.movetime) {
+    softLimitMs = hardLimitMs = limits.movetime;
+  }
+  else if (limits.time[side] && !limits.infinite) {
+    int64_t remaining = limits.time[side];
+    int64_t share = remaining / (limits.movesToGo ? limits.movesToGo : 30) + limits.inc[side] * 3 / 4;
+    hardLimitMs = std::max<int64_t>(1, std::min(share * 3, remaining / 2));
+    softLimitMs = std::max<int64_t>(1, std::min(share, hardLimitMs));
+  }
+
+  BoardListener* previousListener = board->getListener();
+  if (nnue::networkLoaded()) {
+    acc.refresh(*board);
+    board->setListener(&acc);
+  }
+
+  Move best;
+  MoveList legal;
+  if (side == WHITE)
+    generate<WHITE, ALL>(*board, computeCheckInfo<WHITE>(*board), legal);
+  else
+    generate<BLACK, ALL>(*board, computeCheckInfo<BLACK>(*board), legal);
+  excluded.count = 0;
+  for (Move m : limits.excluded)
+    if (legal.contains(m) && !excluded.contains(m))
+      excluded.add(m.from, m.to);
+  if (excluded.size() == legal.size())
+    legal.count = 0;
+  for (const Move& m : legal) {
+    if (!excluded.contains(m)) {
+      best = m;
+      break;
+    }
+  }
+
+  int maxDepth = limits.depth ? std::min(limits.depth, MAX_PLY - 1) : MAX_PLY - 1;
+  for (int depth = 1; depth <= maxDepth && !legal.empty(); depth++) {
+    int score = withVariant(board->getVariant(), [&](auto v) {
+      using Variant = decltype(v);
+      return side == WHITE ? iterate<Variant, WHITE>(depth, -INF, INF)
+                           : iterate<Variant, BLACK>(depth, -INF, INF);
+    });
+    // an interrupted iteration is only trusted for its first, fully searched move
+    if (stopped && (depth > 1 || pvLength[0] == 0))
+      break;
+    best = pv[0][0];
+
+    SearchReport info;
+    info.depth = depth;
+    info.score = score;
+    info.nodes = nodes;
+    info.ms = elapsedMs();
+    info.pv.assign(pv[0], pv[0] + pvLength[0]);
+    report(info);
+
+    if (stopped || (softLimitMs && info.ms >= softLimitMs))
+      break;
+    // a mate found within the full width depth won't get shorter
+    if (!limits.infinite && !limits.depth && std::abs(score) >= MATE_BOUND && MATE_SCORE - std::abs(score) < depth)
+      break;
+  }
+
+  nodeCount.store(nodes, std::memory_order_relaxed);
+  board->setListener(previousListener);
+  return best;
+}
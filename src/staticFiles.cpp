@@ -0,0 +1,253 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "../header/staticFiles.hpp"
+#include "../header/trace.hpp"
+
+namespace {
+
+struct MimeType {
+  const char* extension;
+  const char* mime;
+  bool compressible;
+};
+
+const MimeType MIME_TYPES[] = {
+  {".html", "text/html; charset=utf-8", true},
+  {".css", "text/css; charset=utf-8", true},
+  {".js", "text/javascript; charset=utf-8", true},
+  {".json", "application/json", true},
+  {".svg", "image/svg+xml", true},
+  {".txt", "text/plain; charset=utf-8", true},
+  {".png", "image/png", false},
+  {".jpg", "image/jpeg", false},
+  {".ico", "image/x-icon", false},
+  {".woff2", "font/woff2", false},
+};
+
+// smaller files fit one packet either way
+constexpr size_t MIN_COMPRESS_SIZE = 256;
+
+// Only a name carrying its content hash may be cached for a year; anything
+// else (styles.css as much as the HTML) changes under the same name on a
+// deploy, so browsers revalidate it, which the ETag makes a 304.
+constexpr const char* CACHE_REVALIDATE = "no-cache";
+constexpr const char* CACHE_IMMUTABLE = "public, max-age=31536000, immutable";
+constexpr size_t MIN_HASH_DIGITS = 8;
+
+// "name.<hex digits>.ext", e.g. app.3f9c2a71.js
+bool contentAddressed(const std::string& urlPath) {
+  size_t ext = urlPath.rfind('.');
+  size_t slash = urlPath.rfind('/');
+  if (ext == std::string::npos || (slash != std::string::npos && ext < slash))
+    return false;
+  size_t dot = urlPath.rfind('.', ext - 1);
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash) || ext - dot - 1 < MIN_HASH_DIGITS)
+    return false;
+  for (size_t i = dot + 1; i < ext; i++)
+    if (!isxdigit((unsigned char)urlPath[i]))
+      return false;
+  return true;
+}
+
+std::string hashETag(const void* data, size_t size, const char* suffix) {
+  // FNV-1a, 64 bit
+  uint64_t h = 1469598103934665603ull;
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++)
+    h = (h ^ p[i]) * 1099511628211ull;
+  char buf[40];
+  snprintf(buf, sizeof(buf), "\"%016llx%s\"", (unsigned long long)h, suffix);
+  return buf;
+}
+
+bool sendAll(int sock, const std::string& bytes) {
+  size_t sent = 0;
+  while (sent < bytes.size()) {
+    ssize_t n = send(sock, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    sent += n;
+  }
+  return true;
+}
+
+// "gzip" listed without a zero q-value
+bool acceptsGzip(std::string_view acceptEncoding) {
+  size_t pos = acceptEncoding.find("gzip");
+  if (pos == std::string_view::npos)
+    return false;
+  size_t next = acceptEncoding.find_first_not_of(' ', pos + 4);
+  if (next == std::string_view::npos || acceptEncoding[next] != ';')
+    return true;
+  size_t q = acceptEncoding.find("q=", next);
+  if (q == std::string_view::npos)
+    return true;
+  std::string_view value = acceptEncoding.substr(q + 2);
+  value = value.substr(0, value.find_first_of(", "));
+  return value.find_first_not_of("0.") != std::string_view::npos;
+}
+
+#ifdef HAVE_ZLIB
+// gzip data into an anonymous memory file; -1 if it does not shrink
+int compressToMemfd(const void* data, size_t size, const std::string& name, size_t& outSize) {
+  z_stream zs{};
+  if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+    return -1;
+  std::string out(deflateBound(&zs, size), '\0');
+  zs.next_in = (Bytef*)data;
+  zs.avail_in = (uInt)size;
+  zs.next_out = (Bytef*)&out[0];
+  zs.avail_out = (uInt)out.size();
+  int rc = deflate(&zs, Z_FINISH);
+  outSize = zs.total_out;
+  deflateEnd(&zs);
+  if (rc != Z_STREAM_END || outSize >= size)
+    return -1;
+
+  int fd = memfd_create(name.c_str(), 0);
+  if (fd < 0)
+    return -1;
+  if (write(fd, out.data(), outSize) != (ssize_t)outSize) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+#endif
+
+}
+
+StaticFiles::~StaticFiles() {
+  for (auto& kv : files) {
+    close(kv.second.plain.fd);
+    if (kv.second.gzip.fd >= 0)
+      close(kv.second.gzip.fd);
+  }
+}
+
+size_t StaticFiles::load(const std::string& root) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  for (auto it = fs::recursive_directory_iterator(root, ec); !ec && it != fs::end(it); it.increment(ec)) {
+    if (!it->is_regular_file() || it->path().extension() == ".gz")
+      continue;
+    std::string rel = it->path().lexically_relative(root).generic_string();
+    addFile("/" + rel, it->path().string());
+  }
+  return files.size();
+}
+
+void StaticFiles::addFile(const std::string& urlPath, const std::string& diskPath) {
+  int fd = open(diskPath.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0)
+      close(fd);
+    return;
+  }
+
+  Entry entry;
+  bool compressible = false;
+  for (const MimeType& m : MIME_TYPES) {
+    size_t len = strlen(m.extension);
+    if (urlPath.size() > len && urlPath.compare(urlPath.size() - len, len, m.extension) == 0) {
+      entry.mime = m.mime;
+      compressible = m.compressible;
+      break;
+    }
+  }
+  entry.immutable = contentAddressed(urlPath);
+  entry.plain.fd = fd;
+  entry.plain.size = st.st_size;
+
+  // the mapping only lives long enough to hash (and maybe compress) the file
+  void* data = st.st_size ? mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+  if (data == MAP_FAILED) {
+    close(fd);
+    return;
+  }
+  entry.plain.etag = hashETag(data, st.st_size, "");
+
+  int gz = open((diskPath + ".gz").c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat gzst;
+  if (gz >= 0 && fstat(gz, &gzst) == 0) {
+    entry.gzip.fd = gz;
+    entry.gzip.size = gzst.st_size;
+  }
+#ifdef HAVE_ZLIB
+  else if (compressible && (size_t)st.st_size >= MIN_COMPRESS_SIZE) {
+    entry.gzip.fd = compressToMemfd(data, st.st_size, urlPath, entry.gzip.size);
+  }
+#endif
+  if (gz >= 0 && entry.gzip.fd != gz)
+    close(gz);
+  // a distinct representation needs a distinct strong validator
+  if (entry.gzip.fd >= 0)
+    entry.gzip.etag = entry.plain.etag.substr(0, entry.plain.etag.size() - 1) + "-gz\"";
+
+  if (data)
+    munmap(data, st.st_size);
+  files[urlPath] = entry;
+}
+
+bool StaticFiles::has(std::string_view urlPath) const {
+  return files.find(urlPath) != files.end();
+}
+
+bool StaticFiles::serve(int sock, std::string_view urlPath, bool head,
+                        std::string_view acceptEncoding, std::string_view ifNoneMatch) const {
+  TRACE_SCOPE("StaticFiles::serve");
+  auto it = files.find(urlPath);
+  if (it == files.end())
+    return false;
+  const Entry& entry = it->second;
+  bool gzip = entry.gzip.fd >= 0 && acceptsGzip(acceptEncoding);
+  const Variant& v = gzip ? entry.gzip : entry.plain;
+
+  std::string headers;
+  bool notModified = !ifNoneMatch.empty() && ifNoneMatch.find(v.etag) != std::string_view::npos;
+  headers = notModified ? "HTTP/1.1 304 Not Modified\r\n" : "HTTP/1.1 200 OK\r\n";
+  headers += "Content-Type: ";
+  headers += entry.mime;
+  headers += "\r\nETag: " + v.etag;
+  headers += "\r\nCache-Control: ";
+  headers += entry.immutable ? CACHE_IMMUTABLE : CACHE_REVALIDATE;
+  if (entry.gzip.fd >= 0)
+    headers += "\r\nVary: Accept-Encoding";
+  if (gzip)
+    headers += "\r\nContent-Encoding: gzip";
+  if (!notModified)
+    headers += "\r\nContent-Length: " + std::to_string(v.size);
+  headers += "\r\nConnection: close\r\n\r\n";
+  if (!sendAll(sock, headers) || notModified || head)
+    return true;
+
+  off_t offset = 0;
+  while ((size_t)offset < v.size) {
+    ssize_t n = sendfile(sock, v.fd, &offset, v.size - offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+  }
+  return true;
+}
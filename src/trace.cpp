@@ -0,0 +1,126 @@
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../header/trace.hpp"
+
+namespace trace {
+
+namespace {
+
+// fields are atomics so a concurrent dump reads them without a data race; a
+// span overwritten while it is being copied can come out mixed, which only
+// matters if the ring wraps during the dump
+struct Event {
+  std::atomic<const char*> name{nullptr};
+  std::atomic<uint64_t> start{0};
+  std::atomic<uint64_t> end{0};
+};
+
+struct Ring {
+  Event events[RING_SIZE];
+  std::atomic<uint64_t> head{0};   // spans recorded so far
+  long tid = 0;
+  char threadName[16] = {};
+};
+
+struct Registry {
+  std::mutex mutex;
+  // rings of exited threads stay so their last spans can still be dumped
+  std::vector<std::unique_ptr<Ring>> rings;
+};
+
+Registry& registry() {
+  static Registry r;
+  return r;
+}
+
+Ring& localRing() {
+  thread_local Ring* ring = [] {
+    auto owned = std::make_unique<Ring>();
+    owned->tid = syscall(SYS_gettid);
+    pthread_getname_np(pthread_self(), owned->threadName, sizeof(owned->threadName));
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.rings.push_back(std::move(owned));
+    return r.rings.back().get();
+  }();
+  return *ring;
+}
+
+void appendEscaped(std::string& out, const char* s) {
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      out += '\\';
+    if ((unsigned char)*s >= 0x20)
+      out += *s;
+  }
+}
+
+}
+
+uint64_t nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void record(const char* name, uint64_t start, uint64_t end) {
+  Ring& ring = localRing();
+  uint64_t head = ring.head.load(std::memory_order_relaxed);
+  Event& e = ring.events[head % RING_SIZE];
+  e.name.store(name, std::memory_order_relaxed);
+  e.start.store(start, std::memory_order_relaxed);
+  e.end.store(end, std::memory_order_relaxed);
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+std::string chromeJson(int windowMs) {
+  uint64_t now = nowNanos();
+  uint64_t since = now - std::min<uint64_t>(now, uint64_t(std::max(windowMs, 0)) * 1000000);
+
+  std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  char buf[160];
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (const auto& ring : r.rings) {
+    if (!first)
+      out += ',';
+    first = false;
+    out += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" + std::to_string(ring->tid) +
+           ",\"args\":{\"name\":\"";
+    appendEscaped(out, ring->threadName[0] ? ring->threadName : "thread");
+    out += "\"}}";
+
+    // newest first, stopping at the window or at spans already overwritten
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t oldest = head > RING_SIZE ? head - RING_SIZE : 0;
+    for (uint64_t i = head; i > oldest; i--) {
+      const Event& e = ring->events[(i - 1) % RING_SIZE];
+      uint64_t end = e.end.load(std::memory_order_relaxed);
+      if (end < since)
+        break;
+      uint64_t start = e.start.load(std::memory_order_relaxed);
+      const char* name = e.name.load(std::memory_order_relaxed);
+      if (!name || start > end)
+        continue;
+      out += ",{\"ph\":\"X\",\"pid\":1,\"name\":\"";
+      appendEscaped(out, name);
+      snprintf(buf, sizeof(buf), "\",\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f}",
+               ring->tid, start / 1000.0, (end - start) / 1000.0);
+      out += buf;
+    }
+  }
+  out += "]}";
+  return out;
+}
+
+} // namespace trace
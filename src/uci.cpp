@@ -0,0 +1,372 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "../header/uci.hpp"
+#include "../header/fen.hpp"
+#include "../header/game.hpp"
+#include "../header/nnue.hpp"
+#include "../header/print.hpp"
+#include "../header/revealBoard.hpp"
+#include "../header/search.hpp"
+
+namespace {
+
+constexpr int DEFAULT_HASH_MB = 16;
+constexpr int DEFAULT_BENCH_DEPTH = 8;
+
+// fixed set for bench: [variant, fen]; reveal entries are fixed layouts so
+// the node count is reproducible
+const std::pair<VariantId, const char*> BENCH_POSITIONS[] = {
+  {STANDARD_VARIANT, START_FEN},
+  {STANDARD_VARIANT, "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4"},
+  {STANDARD_VARIANT, "r3k2r/ppp2ppp/2nqbn2/3pp3/3PP3/2NQBN2/PPP2PPP/R3K2R w KQkq - 0 9"},
+  {STANDARD_VARIANT, "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1"},
+  {STANDARD_VARIANT, "8/8/4k3/8/2Q5/8/4K3/8 w - - 0 1"},
+  {REVEAL_VARIANT, "nbrqkpnr/pbpppppp/8/8/8/8/PPBNPPQP/RNPPKBRP w - - 0 1"},
+  {REVEAL_VARIANT, "ppnpkrbq/rbpnpppp/8/8/8/8/NPPBPQPR/PRBPKPNP w - - 0 1"},
+};
+
+std::string squareName(int sq) {
+  return std::string(1, char('a' + sq % 8)) + char('1' + sq / 8);
+}
+
+std::string moveName(Move m) {
+  if (m.from == m.to)
+    return "0000";
+  return squareName(m.from) + squareName(m.to);
+}
+
+// "e2e4" -> true with rows/cols filled in
+bool parseMove(const std::string& text, int& srcRow, int& srcCol, int& dstRow, int& dstCol) {
+  if (text.size() != 4)
+    return false;
+  srcCol = text[0] - 'a';
+  srcRow = text[1] - '1';
+  dstCol = text[2] - 'a';
+  dstRow = text[3] - '1';
+  for (int v : {srcRow, srcCol, dstRow, dstCol})
+    if (v < 0 || v > 7)
+      return false;
+  return true;
+}
+
+std::string scoreText(int score) {
+  if (std::abs(score) >= MATE_SCORE - MAX_PLY) {
+    int plies = MATE_SCORE - std::abs(score);
+    int moves = (plies + 1) / 2;
+    return "mate " + std::to_string(score > 0 ? moves : -moves);
+  }
+  return "cp " + std::to_string(score);
+}
+
+std::string infoLine(const SearchReport& report) {
+  std::ostringstream line;
+  line << "info depth " << report.depth << " score " << scoreText(report.score)
+       << " nodes " << report.nodes
+       << " nps " << (report.nodes * 1000 / uint64_t(std::max<int64_t>(report.ms, 1)))
+       << " time " << report.ms << " pv";
+  for (Move m : report.pv)
+    line << ' ' << moveName(m);
+  return line.str();
+}
+
+class Uci {
+  private:
+    std::ostream& out;
+    std::mutex outMutex;
+    VariantId variant = STANDARD_VARIANT;
+    // "position startpos" in the reveal variant; drawn when the variant is
+    // chosen, or set with the RevealLayout option to replay a game
+    RevealLayout layout = RevealLayout::fromSeed(RevealLayout::randomSeed());
+    std::unique_ptr<Board> board;
+    std::unique_ptr<Game> game;
+    int fullmove = 1;
+    Search search{DEFAULT_HASH_MB};
+    std::thread worker;
+    // "go infinite" holds bestmove back until stop
+    std::mutex stopMutex;
+    std::condition_variable stopSignal;
+    bool stopRequested = false;
+
+    void send(const std::string& line);
+    void newPosition(Board* b, PieceColor turn, int halfmoveClock);
+    Board* startBoard() const;
+    void stopSearch();
+    void position(std::istringstream& args);
+    void go(std::istringstream& args);
+    void setOption(std::istringstream& args);
+    void display();
+  public:
+    explicit Uci(std::ostream& out);
+    ~Uci();
+    bool command(const std::string& line);
+};
+
+Uci::Uci(std::ostream& out) : out(out) {
+  newPosition(new Board(), WHITE, 0);
+}
+
+Uci::~Uci() {
+  stopSearch();
+}
+
+void Uci::send(const std::string& line) {
+  std::lock_guard<std::mutex> lock(outMutex);
+  out << line << std::endl;
+}
+
+void Uci::newPosition(Board* b, PieceColor turn, int halfmoveClock) {
+  game.reset();
+  board.reset(b);
+  game.reset(new Game(board.get(), turn, halfmoveClock));
+}
+
+Board* Uci::startBoard() const {
+  // a plain Board: board deletes through Board*, and ~Board is not virtual
+  if (variant == REVEAL_VARIANT)
+    return RevealBoard(layout).clone();
+  return new Board();
+}
+
+void Uci::stopSearch() {
+  if (!worker.joinable())
+    return;
+  search.stop();
+  {
+    std::lock_guard<std::mutex> lock(stopMutex);
+    stopRequested = true;
+  }
+  stopSignal.notify_all();
+  worker.join();
+}
+
+void Uci::position(std::istringstream& args) {
+  stopSearch();
+  std::string token;
+  args >> token;
+  if (token == "startpos") {
+    newPosition(startBoard(), WHITE, 0);
+    fullmove = 1;
+    args >> token;
+  }
+  else if (token == "fen") {
+    std::string fen, part;
+    while (args >> part && part != "moves")
+      fen += part + " ";
+    token = part;
+    PieceColor turn;
+    int halfmoveClock;
+    std::string error;
+    Board* b = boardFromFen(fen, variant, turn, halfmoveClock, error);
+    if (!b) {
+      send("info string invalid fen: " + error);
+      return;
+    }
+    newPosition(b, turn, halfmoveClock);
+    std::istringstream fields(fen);
+    for (int i = 0; i < 6 && fields >> part; i++)
+      if (i == 5)
+        fullmove = std::max(1, std::atoi(part.c_str()));
+  }
+  else {
+    return;
+  }
+
+  if (token != "moves")
+    return;
+  while (args >> token) {
+    int srcRow, srcCol, dstRow, dstCol;
+    if (!parseMove(token, srcRow, srcCol, dstRow, dstCol) ||
+        !game->makeMove(srcRow, srcCol, dstRow, dstCol)) {
+      send("info string illegal move " + token);
+      return;
+    }
+    if (game->getCurrentTurn() == WHITE)
+      fullmove++;
+  }
+}
+
+void Uci::go(std::istringstream& args) {
+  stopSearch();
+  SearchLimits limits;
+  std::string token;
+  while (args >> token) {
+    if (token == "depth") args >> limits.depth;
+    else if (token == "nodes") args >> limits.nodes;
+    else if (token == "movetime") args >> limits.movetime;
+    else if (token == "wtime") args >> limits.time[WHITE];
+    else if (token == "btime") args >> limits.time[BLACK];
+    else if (token == "winc") args >> limits.inc[WHITE];
+    else if (token == "binc") args >> limits.inc[BLACK];
+    else if (token == "movestogo") args >> limits.movesToGo;
+    else if (token == "infinite") limits.infinite = true;
+  }
+
+  search.clearStop();
+  stopRequested = false;
+  worker = std::thread([this, limits] {
+    Move best = search.run(*board, game->getCurrentTurn(), game->getHalfmoveClock(), game->getHistory(),
+                           limits, [this](const SearchReport& report) { send(infoLine(report)); });
+    if (limits.infinite) {
+      std::unique_lock<std::mutex> lock(stopMutex);
+      stopSignal.wait(lock, [this] { return stopRequested; });
+    }
+    send("bestmove " + moveName(best));
+  });
+}
+
+void Uci::setOption(std::istringstream& args) {
+  std::string token, name, value;
+  args >> token; // "name"
+  while (args >> token && token != "value")
+    name += (name.empty() ? "" : " ") + token;
+  std::getline(args >> std::ws, value);
+
+  stopSearch();
+  if (name == "Hash") {
+    search.resize(std::max(1, std::atoi(value.c_str())));
+  }
+  else if (name == "UCI_Variant") {
+    variant = (value == "reveal") ? REVEAL_VARIANT : STANDARD_VARIANT;
+    if (variant == REVEAL_VARIANT) {
+      layout = RevealLayout::fromSeed(RevealLayout::randomSeed());
+      send("info string layout " + std::to_string(layout.index()));
+    }
+    newPosition(startBoard(), WHITE, 0);
+    fullmove = 1;
+  }
+  else if (name == "RevealLayout") {
+    // an index from "info string layout", or random
+    char* end = nullptr;
+    unsigned long long index = std::strtoull(value.c_str(), &end, 10);
+    if (value == "random")
+      layout = RevealLayout::fromSeed(RevealLayout::randomSeed());
+    else if (!value.empty() && *end == '\0' && index < RevealLayout::LAYOUTS)
+      layout = RevealLayout::fromIndex(index);
+    else {
+      send("info string invalid layout " + value);
+      return;
+    }
+    send("info string layout " + std::to_string(layout.index()));
+    newPosition(startBoard(), WHITE, 0);
+    fullmove = 1;
+  }
+  else if (name == "EvalFile") {
+    if (value.empty() || value == "<empty>")
+      return;
+    if (nnue::loadNetwork(value))
+      send(std::string("info string loaded network ") + value + " (" + nnue::simdName() + ")");
+    else
+      send("info string could not load network " + value);
+  }
+  else {
+    send("info string unknown option " + name);
+  }
+}
+
+void Uci::display() {
+  std::lock_guard<std::mutex> lock(outMutex);
+  Print print;
+  print.printBoard(*board);
+  out << "Fen: " << boardToFen(*board, game->getCurrentTurn(), game->getHalfmoveClock(), fullmove)
+      << "\nKey: " << std::hex << game->positionKey() << std::dec << std::endl;
+}
+
+// returns false on quit
+bool Uci::command(const std::string& line) {
+  std::istringstream args(line);
+  std::string token;
+  if (!(args >> token))
+    return true;
+
+  if (token == "uci") {
+    send("id name RevealChess\nid author RevealChess developers");
+    send("option name Hash type spin default " + std::to_string(DEFAULT_HASH_MB) + " min 1 max 4096");
+    send("option name UCI_Variant type combo default standard var standard var reveal");
+    send("option name EvalFile type string default <empty>");
+    send("option name RevealLayout type string default random");
+    send("uciok");
+  }
+  else if (token == "isready") {
+    send("readyok");
+  }
+  else if (token == "ucinewgame") {
+    stopSearch();
+    search.clear();
+  }
+  else if (token == "setoption") {
+    setOption(args);
+  }
+  else if (token == "position") {
+    position(args);
+  }
+  else if (token == "go") {
+    go(args);
+  }
+  else if (token == "stop") {
+    stopSearch();
+  }
+  else if (token == "quit") {
+    stopSearch();
+    return false;
+  }
+  else if (token == "bench") {
+    stopSearch();
+    int depth = 0;
+    args >> depth;
+    std::lock_guard<std::mutex> lock(outMutex);
+    uciBench(out, depth);
+  }
+  else if (token == "d") {
+    display();
+  }
+  else {
+    send("info string unknown command " + token);
+  }
+  return true;
+}
+
+}
+
+void uciBench(std::ostream& out, int depth) {
+  Search search(DEFAULT_HASH_MB);
+  SearchLimits limits;
+  limits.depth = depth > 0 ? depth : DEFAULT_BENCH_DEPTH;
+  uint64_t totalNodes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const auto& entry : BENCH_POSITIONS) {
+    PieceColor turn;
+    int halfmoveClock;
+    std::string error;
+    std::unique_ptr<Board> board(boardFromFen(entry.second, entry.first, turn, halfmoveClock, error));
+    Game game(board.get(), turn, halfmoveClock);
+    search.clear();
+    Move best = search.run(*board, turn, halfmoveClock, game.getHistory(), limits,
+                           [](const SearchReport&) {});
+    out << "Position (" << (entry.first == REVEAL_VARIANT ? "reveal" : "standard") << ") "
+        << entry.second << ": bestmove " << moveName(best) << ", "
+        << search.nodesSearched() << " nodes" << std::endl;
+    totalNodes += search.nodesSearched();
+  }
+  int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  out << "\n===========================\n"
+      << "Total time (ms) : " << ms << "\n"
+      << "Nodes searched  : " << totalNodes << "\n"
+      << "Nodes/second    : " << totalNodes * 1000 / uint64_t(std::max<int64_t>(ms, 1)) << std::endl;
+}
+
+int uciLoop(std::istream& in, std::ostream& out) {
+  Uci uci(out);
+  std::string line;
+  while (std::getline(in, line))
+    if (!uci.command(line))
+      break;
+  return 0;
+}
@@ -0,0 +1,562 @@
+#include <fcntl.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+#include "../header/logger.hpp"
+#include "../header/sha256.hpp"
+#include "../header/userStore.hpp"
+
+namespace {
+
+constexpr size_t MAX_NAME = 32;
+constexpr size_t MAX_FIELD = 256;
+// compaction is not worth a rewrite below this many dead bytes
+constexpr uint64_t MIN_DEAD_BYTES = 64 * 1024;
+constexpr double ELO_K = 32;
+// PBKDF2 rounds for new passwords; stored per password, so raising it
+// leaves existing ones verifiable (~70 ms each on a worker)
+constexpr uint32_t PASSWORD_ITERATIONS = 100000;
+constexpr size_t SALT_BYTES = 16;
+constexpr const char* HASH_SCHEME = "pbkdf2-sha256$";
+
+bool validName(std::string_view name) {
+  if (name.empty() || name.size() > MAX_NAME)
+    return false;
+  for (char c : name) {
+    bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+              c == '_' || c == '.' || c == '-';
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+bool validField(std::string_view field) {
+  return field.size() <= MAX_FIELD && field.find_first_of("\t\r\n") == std::string_view::npos;
+}
+
+const char* outcomeName(GameOutcome outcome) {
+  switch (outcome) {
+    case WHITE_WINS: return "1-0";
+    case BLACK_WINS: return "0-1";
+    default:         return "1/2";
+  }
+}
+
+bool parseOutcome(std::string_view s, GameOutcome& outcome) {
+  if (s == "1-0")
+    outcome = WHITE_WINS;
+  else if (s == "0-1")
+    outcome = BLACK_WINS;
+  else if (s == "1/2")
+    outcome = DRAWN;
+  else
+    return false;
+  return true;
+}
+
+bool parseInt(std::string_view s, int64_t& value) {
+  if (s.empty() || s.size() > 18)
+    return false;
+  bool negative = (s[0] == '-');
+  if (negative)
+    s.remove_prefix(1);
+  if (s.empty())
+    return false;
+  int64_t n = 0;
+  for (char c : s) {
+    if (c < '0' || c > '9')
+      return false;
+    n = n * 10 + (c - '0');
+  }
+  value = negative ? -n : n;
+  return true;
+}
+
+std::vector<std::string_view> splitTabs(std::string_view line) {
+  std::vector<std::string_view> fields;
+  for (;;) {
+    size_t tab = line.find('\t');
+    fields.push_back(line.substr(0, tab));
+    if (tab == std::string_view::npos)
+      return fields;
+    line.remove_prefix(tab + 1);
+  }
+}
+
+std::string toHex(const uint8_t* bytes, size_t size) {
+  static const char* digits = "0123456789abcdef";
+  std::string out;
+  out.reserve(2 * size);
+  for (size_t i = 0; i < size; i++) {
+    out += digits[bytes[i] >> 4];
+    out += digits[bytes[i] & 15];
+  }
+  return out;
+}
+
+std::string passwordHash(std::string_view password, std::string_view saltHex, uint32_t iterations) {
+  uint8_t out[32];
+  sha256::pbkdf2(password, saltHex, iterations, out);
+  return toHex(out, sizeof(out));
+}
+
+// "pbkdf2-sha256$iterations$salt$hash" with a fresh random salt, or empty
+// if the system has no randomness to give
+std::string hashPassword(std::string_view password) {
+  uint8_t salt[SALT_BYTES];
+  if (getrandom(salt, sizeof(salt), 0) != (ssize_t)sizeof(salt))
+    return "";
+  std::string saltHex = toHex(salt, sizeof(salt));
+  return HASH_SCHEME + std::to_string(PASSWORD_ITERATIONS) + "$" + saltHex + "$" +
+         passwordHash(password, saltHex, PASSWORD_ITERATIONS);
+}
+
+bool isHashed(std::string_view stored) {
+  return stored.compare(0, strlen(HASH_SCHEME), HASH_SCHEME) == 0;
+}
+
+// the time taken does not depend on where the hashes differ
+bool verifyPassword(std::string_view stored, std::string_view password) {
+  std::vector<std::string_view> f;
+  for (std::string_view rest = stored.substr(strlen(HASH_SCHEME));;) {
+    size_t dollar = rest.find('$');
+    f.push_back(rest.substr(0, dollar));
+    if (dollar == std::string_view::npos)
+      break;
+    rest.remove_prefix(dollar + 1);
+  }
+  int64_t iterations;
+  if (f.size() != 3 || !parseInt(f[0], iterations) || iterations < 1 || iterations > UINT32_MAX)
+    return false;
+  std::string computed = passwordHash(password, f[1], uint32_t(iterations));
+  if (computed.size() != f[2].size())
+    return false;
+  unsigned char diff = 0;
+  for (size_t i = 0; i < computed.size(); i++)
+    diff |= computed[i] ^ f[2][i];
+  return diff == 0;
+}
+
+std::string userRecord(const std::string& name, const std::string& password, const std::string& avatar) {
+  return "U\t" + name + "\t" + password + "\t" + avatar;
+}
+
+std::string resultRecord(std::string_view white, std::string_view black, GameOutcome outcome, uint32_t plies,
+                         int64_t finishedAt) {
+  return "R\t" + std::string(white) + "\t" + std::string(black) + "\t" + outcomeName(outcome) + "\t" +
+         std::to_string(plies) + "\t" + std::to_string(finishedAt);
+}
+
+// makes a rename in path's directory durable
+bool syncDirectory(const std::string& path) {
+  size_t slash = path.rfind('/');
+  std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+  int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dirFd < 0)
+    return false;
+  bool ok = fsync(dirFd) == 0;
+  close(dirFd);
+  return ok;
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, data, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+}
+
+struct UserStore::Ranking {
+  struct Key {
+    double rating;   // exact, as stored: keyOf must find the entry again
+    uint32_t games;
+    uint32_t id;
+  };
+  struct Better {
+    bool operator()(const Key& a, const Key& b) const {
+      if (a.rating != b.rating)
+        return a.rating > b.rating;
+      if (a.games != b.games)
+        return a.games > b.games;
+      return a.id < b.id;
+    }
+  };
+  __gnu_pbds::tree<Key, __gnu_pbds::null_type, Better, __gnu_pbds::rb_tree_tag,
+                   __gnu_pbds::tree_order_statistics_node_update> tree;
+
+  static bool ranked(const User& u) {
+    return u.wins + u.losses + u.draws > 0;
+  }
+  static Key keyOf(const User& u, uint32_t id) {
+    return Key{u.rating, u.wins + u.losses + u.draws, id};
+  }
+};
+
+UserStore::UserStore(std::string path) : path(std::move(path)), ranking(new Ranking) {}
+
+UserStore::~UserStore() {
+  if (fd >= 0)
+    close(fd);
+}
+
+bool UserStore::open(std::string& error) {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  std::string log;
+  {
+    std::ifstream in(path, std::ios::binary);
+    if (in) {
+      std::ostringstream all;
+      all << in.rdbuf();
+      log = all.str();
+    }
+  }
+
+  // only an unterminated last line is a torn write; a whole line that does
+  // not replay is reported and skipped, so it cannot hide the records after it
+  size_t good = 0;
+  for (size_t newline; good < log.size() && (newline = log.find('\n', good)) != std::string::npos;
+       good = newline + 1) {
+    if (!replay(std::string_view(log).substr(good, newline - good)))
+      logLine("[users] %s: skipped bad record at byte %zu\n", path.c_str(), good);
+  }
+
+  fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    error = path + ": " + strerror(errno);
+    return false;
+  }
+  if (good < log.size() && ftruncate(fd, (off_t)good) != 0) {
+    error = path + ": " + strerror(errno);
+    return false;
+  }
+  logBytes = good;
+
+  // logs from before passwords were hashed: hash them and rewrite the log
+  // so the plaintext is gone from it
+  bool plaintext = false;
+  for (User& u : users) {
+    if (isHashed(u.password))
+      continue;
+    u.password = hashPassword(u.password);
+    if (u.password.empty()) {
+      error = path + ": no randomness to salt passwords with";
+      return false;
+    }
+    plaintext = true;
+  }
+  if (plaintext) {
+    logLine("[users] %s: hashed plaintext passwords\n", path.c_str());
+    if (!compactLocked()) {
+      error = path + ": could not rewrite without plaintext passwords";
+      return false;
+    }
+  }
+  compactIfWorthIt();
+  return true;
+}
+
+bool UserStore::replay(std::string_view line) {
+  std::vector<std::string_view> f = splitTabs(line);
+  if (f[0] == "U" && f.size() == 4) {
+    if (!validName(f[1]) || byName.count(f[1]))
+      return false;
+    users.emplace_back(std::string(f[1]), std::string(f[2]), std::string(f[3]));
+    byName.emplace(users.back().name, uint32_t(users.size() - 1));
+    liveBytes += line.size() + 1;
+    return true;
+  }
+  if ((f[0] == "P" || f[0] == "A") && f.size() == 3) {
+    auto it = byName.find(f[1]);
+    if (it == byName.end())
+      return false;
+    std::string& field = (f[0] == "P") ? users[it->second].password : users[it->second].avatar;
+    liveBytes += f[2].size() - field.size();
+    field = std::string(f[2]);
+    return true;
+  }
+  if (f[0] == "R" && f.size() == 6) {
+    auto white = byName.find(f[1]), black = byName.find(f[2]);
+    StoredResult r;
+    int64_t plies, finishedAt;
+    if (white == byName.end() || black == byName.end() || white == black || !parseOutcome(f[3], r.outcome) ||
+        !parseInt(f[4], plies) || plies < 0 || !parseInt(f[5], finishedAt))
+      return false;
+    r.white = white->second;
+    r.black = black->second;
+    r.plies = uint32_t(plies);
+    r.finishedAt = finishedAt;
+    liveBytes += resultRecord(f[1], f[2], r.outcome, r.plies, r.finishedAt).size() + 1;
+    applyResult(r);
+    return true;
+  }
+  return false;
+}
+
+UserStore::Status UserStore::append(const std::string& record) {
+  if (fd < 0)
+    return IO_ERROR;
+  std::string line = record + '\n';
+  if (!writeAll(fd, line.data(), line.size()) || fdatasync(fd) != 0) {
+    // a partial line would hide every later record from replay; if it cannot
+    // be cut off, stop writing behind it
+    if (ftruncate(fd, (off_t)logBytes) != 0) {
+      close(fd);
+      fd = -1;
+    }
+    return IO_ERROR;
+  }
+  logBytes += line.size();
+  return OK;
+}
+
+const UserStore::User* UserStore::find(std::string_view name) const {
+  auto it = byName.find(name);
+  return it == byName.end() ? nullptr : &users[it->second];
+}
+
+void UserStore::applyResult(const StoredResult& result) {
+  uint32_t index = uint32_t(results.size());
+  results.push_back(result);
+
+  User& white = users[result.white];
+  User& black = users[result.black];
+  // out of the tree while the key's rating and games change
+  for (uint32_t id : {result.white, result.black}) {
+    if (Ranking::ranked(users[id]))
+      ranking->tree.erase(Ranking::keyOf(users[id], id));
+  }
+  double expected = 1 / (1 + std::pow(10.0, (black.rating - white.rating) / 400));
+  double scored = result.outcome == WHITE_WINS ? 1 : result.outcome == DRAWN ? 0.5 : 0;
+  white.rating += ELO_K * (scored - expected);
+  black.rating -= ELO_K * (scored - expected);
+  for (uint32_t id : {result.white, result.black}) {
+    User& u = users[id];
+    if (result.outcome == DRAWN)
+      u.draws++;
+    else if ((result.outcome == WHITE_WINS) == (id == result.white))
+      u.wins++;
+    else
+      u.losses++;
+    u.games.push_back(index);
+    ranking->tree.insert(Ranking::keyOf(u, id));
+  }
+}
+
+UserStore::Status UserStore::addUser(std::string_view name, std::string_view password,
+                                     std::string_view avatar) {
+  if (!validName(name) || password.empty() || !validField(password) || !validField(avatar))
+    return INVALID;
+  // hashed before the lock, which must not be held for the slow part
+  std::string hash = hashPassword(password);
+  if (hash.empty())
+    return IO_ERROR;
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  if (byName.count(name))
+    return EXISTS;
+  std::string record = userRecord(std::string(name), hash, std::string(avatar));
+  if (append(record) != OK)
+    return IO_ERROR;
+  liveBytes += record.size() + 1;
+  users.emplace_back(std::string(name), std::move(hash), std::string(avatar));
+  byName.emplace(users.back().name, uint32_t(users.size() - 1));
+  return OK;
+}
+
+UserStore::Status UserStore::checkPassword(std::string_view name, std::string_view password) const {
+  std::string stored;
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    const User* u = find(name);
+    if (!u)
+      return NOT_FOUND;
+    stored = u->password;
+  }
+  return verifyPassword(stored, password) ? OK : BAD_PASSWORD;
+}
+
+UserStore::Status UserStore::setPassword(std::string_view name, std::string_view password) {
+  if (password.empty() || !validField(password))
+    return INVALID;
+  std::string hash = hashPassword(password);
+  if (hash.empty())
+    return IO_ERROR;
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  auto it = byName.find(name);
+  if (it == byName.end())
+    return NOT_FOUND;
+  if (append("P\t" + std::string(name) + "\t" + hash) != OK)
+    return IO_ERROR;
+  User& u = users[it->second];
+  liveBytes += hash.size() - u.password.size();
+  u.password = std::move(hash);
+  compactIfWorthIt();
+  return OK;
+}
+
+UserStore::Status UserStore::setAvatar(std::string_view name, std::string_view avatar) {
+  if (!validField(avatar))
+    return INVALID;
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  auto it = byName.find(name);
+  if (it == byName.end())
+    return NOT_FOUND;
+  if (append("A\t" + std::string(name) + "\t" + std::string(avatar)) != OK)
+    return IO_ERROR;
+  User& u = users[it->second];
+  liveBytes += avatar.size() - u.avatar.size();
+  u.avatar = std::string(avatar);
+  compactIfWorthIt();
+  return OK;
+}
+
+UserStore::Status UserStore::recordResult(std::string_view white, std::string_view black,
+                                          GameOutcome outcome, uint32_t plies, int64_t finishedAt) {
+  if (white == black)
+    return INVALID;
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  auto w = byName.find(white), b = byName.find(black);
+  if (w == byName.end() || b == byName.end())
+    return NOT_FOUND;
+  std::string record = resultRecord(white, black, outcome, plies, finishedAt);
+  if (append(record) != OK)
+    return IO_ERROR;
+  liveBytes += record.size() + 1;
+  applyResult(StoredResult{w->second, b->second, outcome, plies, finishedAt});
+  return OK;
+}
+
+uint32_t UserStore::rankOf(uint32_t id) const {
+  const User& u = users[id];
+  if (!Ranking::ranked(u))
+    return 0;
+  return uint32_t(ranking->tree.order_of_key(Ranking::keyOf(u, id))) + 1;
+}
+
+UserStats UserStore::statsOf(uint32_t id) const {
+  const User& u = users[id];
+  return UserStats{u.name, u.avatar, u.wins, u.losses, u.draws, rankOf(id), int(std::lround(u.rating))};
+}
+
+bool UserStore::stats(std::string_view name, UserStats& out) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  auto it = byName.find(name);
+  if (it == byName.end())
+    return false;
+  out = statsOf(it->second);
+  return true;
+}
+
+std::vector<UserStats> UserStore::leaderboard(size_t count, size_t offset) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  std::vector<UserStats> top;
+  auto it = ranking->tree.find_by_order(offset);
+  for (size_t rank = offset + 1; it != ranking->tree.end() && top.size() < count; ++it, ++rank) {
+    const User& u = users[it->id];
+    top.push_back(UserStats{u.name, u.avatar, u.wins, u.losses, u.draws, uint32_t(rank),
+                            int(std::lround(u.rating))});
+  }
+  return top;
+}
+
+std::vector<GameResult> UserStore::recentGames(std::string_view name, size_t count) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  std::vector<GameResult> games;
+  const User* u = find(name);
+  if (!u)
+    return games;
+  for (auto it = u->games.rbegin(); it != u->games.rend() && games.size() < count; ++it) {
+    const StoredResult& r = results[*it];
+    games.push_back(GameResult{users[r.white].name, users[r.black].name, r.outcome, r.plies, r.finishedAt});
+  }
+  return games;
+}
+
+size_t UserStore::userCount() const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return users.size();
+}
+
+size_t UserStore::importUsersCsv(const std::string& csvPath) {
+  std::ifstream in(csvPath);
+  std::string line;
+  size_t added = 0;
+  bool header = true;
+  while (std::getline(in, line)) {
+    if (header) {
+      header = false;
+      continue;
+    }
+    size_t first = line.find(',');
+    if (first == std::string::npos)
+      continue;
+    size_t second = line.find(',', first + 1);
+    std::string_view view(line);
+    std::string_view password = view.substr(first + 1, second == std::string::npos ? std::string::npos
+                                                                                    : second - first - 1);
+    std::string_view avatar = second == std::string::npos ? std::string_view() : view.substr(second + 1);
+    if (addUser(view.substr(0, first), password, avatar) == OK)
+      added++;
+  }
+  return added;
+}
+
+bool UserStore::compact() {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  return compactLocked();
+}
+
+void UserStore::compactIfWorthIt() {
+  uint64_t dead = logBytes - liveBytes;
+  if (dead >= MIN_DEAD_BYTES && dead > liveBytes)
+    compactLocked();
+}
+
+bool UserStore::compactLocked() {
+  std::string out;
+  for (const User& u : users)
+    out += userRecord(u.name, u.password, u.avatar) + "\n";
+  for (const StoredResult& r : results)
+    out += resultRecord(users[r.white].name, users[r.black].name, r.outcome, r.plies, r.finishedAt) + "\n";
+
+  std::string tmp = path + ".tmp";
+  int tmpFd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (tmpFd < 0)
+    return false;
+  if (!writeAll(tmpFd, out.data(), out.size()) || fsync(tmpFd) != 0 || rename(tmp.c_str(), path.c_str()) != 0) {
+    close(tmpFd);
+    unlink(tmp.c_str());
+    return false;
+  }
+  close(tmpFd);
+  // a crash before the directory entry is durable could bring back the old
+  // log; nothing is lost either way, so a failed sync is not an error
+  syncDirectory(path);
+
+  // the old descriptor still appends to the replaced file; without a new
+  // one, later changes fail instead of going there
+  close(fd);
+  fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+  logBytes = out.size();
+  liveBytes = out.size();
+  return fd >= 0;
+}
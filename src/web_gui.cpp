@@ -2,25 +2,51 @@
 // Minimal click-to-move Web GUI (no external libs) using ROW,COL with your Board.
 // UI coordinates = (row, col). Engine calls = (row, col) to match your terminal.
 
-#include <arpa/inet.h>
-#include <netinet/in.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <signal.h>
 #include <unistd.h>
 #include <execinfo.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <string>
 #include <sstream>
 #include <vector>
 #include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <thread>
 
 #include "../header/board.hpp"
 #include "../header/piece.hpp"
 #include "../header/revealBoard.hpp"
 #include "../header/game.hpp"
+#include "../header/broadcaster.hpp"
+#include "../header/staticFiles.hpp"
+#include "../header/httpRequest.hpp"
+#include "../header/httpServer.hpp"
+#include "../header/search.hpp"
+#include "../header/metrics.hpp"
+#include "../header/logger.hpp"
+#include "../header/trace.hpp"
+#include "../header/userStore.hpp"
+#include "../header/gameHost.hpp"
+#include "../header/lobby.hpp"
+#include "../header/gameArchive.hpp"
+#include "../header/puzzleDb.hpp"
+#include "../header/puzzleVerify.hpp"
+#include "../header/fen.hpp"
+#include "../header/analyzer.hpp"
+#include "../header/enginePool.hpp"
+#include "../header/layoutTable.hpp"
+#include "../header/sha256.hpp"
 
 // -------- crash handler (helps if something goes wrong) --------
 static void segv_handler(int sig){
@@ -185,6 +211,9 @@ function redraw(){
   }
 }
 
+// ?room=id picks the game; without it this is the open practice room
+const ROOM = new URLSearchParams(location.search).get('room') || '0';
+
 async function GET_json(url){
   const r=await fetch(url);
   return r.json();
@@ -195,8 +224,7 @@ function updateTurnHud(){
   setTurn(`Turn: ${nice}`);
 }
 
-async function loadState(){
-  const data = await GET_json('/state');   // {pieces:[...], turn:"WHITE/BLACK", state:"..."}
+function applyState(data){
   if (Array.isArray(data)) {
     // fallback (shouldn't happen now, but just in case)
     pieces = data;
@@ -209,13 +237,23 @@ async function loadState(){
   redraw();
 }
 
+async function loadState(){
+  applyState(await GET_json(`/state?room=${ROOM}`));   // {pieces:[...], turn:"WHITE/BLACK", state:"..."}
+}
+
+// pushed on every move, so spectators (and the other player) follow live
+function watchState(){
+  const es = new EventSource(`/events?room=${ROOM}`);
+  es.onmessage = ev => applyState(JSON.parse(ev.data));
+}
+
 async function loadMoves(sr,sc){
-  legal=await GET_json(`/moves?sr=${sr}&sc=${sc}`);
+  legal=await GET_json(`/moves?room=${ROOM}&sr=${sr}&sc=${sc}`);
   redraw();
 }
 
 async function postMove(sr,sc,dr,dc){
-  const r=await fetch(`/move?sr=${sr}&sc=${sc}&dr=${dr}&dc=${dc}`,{method:'POST'});
+  const r=await fetch(`/move?room=${ROOM}&sr=${sr}&sc=${sc}&dr=${dr}&dc=${dc}`,{method:'POST'});
   const j=await r.json();
   setStatus(j.ok ? `Moved: (${sr},${sc}) → (${dr},${dc})` :
                    `Illegal: (${sr},${sc}) → (${dr},${dc})`);
@@ -290,7 +328,7 @@ cvs.addEventListener('click', async ev=>{
   redraw();
 });
 
-window.addEventListener('load', loadState);
+window.addEventListener('load', ()=>{ loadState(); watchState(); });
 </script>
 </html>)HTML";
 
@@ -300,25 +338,9 @@ static std::string http_ok(const char* mime){
   o<<"HTTP/1.1 200 OK\r\nContent-Type: "<<mime<<"\r\nConnection: close\r\n\r\n";
   return o.str();
 }
-static std::string http_bad(){
-  return "HTTP/1.1 400 Bad Request\r\nConnection: close\r\n\r\n";
-}
-static std::string url_decode(const std::string& s){
-  std::string o;
-  o.reserve(s.size());
-  for (size_t i=0;i<s.size();++i){
-    if (s[i]=='%' && i+2<s.size()){
-      int v=strtol(s.substr(i+1,2).c_str(),nullptr,16);
-      o.push_back(char(v));
-      i+=2;
-    } else if (s[i]=='+') o.push_back(' ');
-    else o.push_back(s[i]);
-  }
-  return o;
-}
-static bool safe_send(int fd, const std::string& x){
-  ssize_t left = (ssize_t)x.size();
-  const char* p = x.c_str();
+static bool safe_send(int fd, const char* p, size_t len){
+  TRACE_SCOPE("safe_send");
+  ssize_t left = (ssize_t)len;
   while (left > 0) {
     ssize_t n = send(fd, p, left, 0);
     if (n < 0) return false;
@@ -327,165 +349,936 @@ static bool safe_send(int fd, const std::string& x){
   }
   return true;
 }
-static int qparam_int(const std::string& q, const std::string& key){
-  size_t p=q.find(key+"=");
-  if(p==std::string::npos) return -999;
-  size_t e=q.find('&',p);
-  std::string v=(e==std::string::npos)?
-    q.substr(p+key.size()+1):
-    q.substr(p+key.size()+1,e-(p+key.size()+1));
-  return std::atoi(url_decode(v).c_str());
+static bool safe_send(int fd, const std::string& x){
+  return safe_send(fd, x.data(), x.size());
+}
+static bool send_json(int fd, const char* status, const std::string& body, const std::string& headers=""){
+  return safe_send(fd, std::string("HTTP/1.1 ")+status+"\r\nContent-Type: application/json\r\n"+
+                       headers+"Connection: close\r\n\r\n"+body);
+}
+static std::string json_string(const std::string& s){
+  std::string o="\"";
+  for(char ch : s){
+    if(ch=='"'||ch=='\\') o+='\\';
+    if((unsigned char)ch>=0x20) o+=ch;
+  }
+  return o+"\"";
 }
+// Board + turn + state as JSON. Serialized once per state change into the
+// shared frame below, never per request.
+static std::string state_json(Board& board, Game& game){
+  std::ostringstream js;
+  js<<"{\"pieces\":[";
+  bool first=true;
+  for(int r=0;r<8;++r){
+    for(int c2=0;c2<8;++c2){
+      if(!board.isOccupied(r,c2)) continue;
+      if(!first) js<<","; first=false;
 
-int main(){
-  signal(SIGPIPE, SIG_IGN);
-  struct sigaction sa{};
-  sa.sa_handler = segv_handler;
-  sigemptyset(&sa.sa_mask);
-  sa.sa_flags = SA_RESETHAND;
-  sigaction(SIGSEGV, &sa, nullptr);
+      PieceType t=board.getPieceType(r,c2);
+      PieceColor col=board.getColor(r,c2);
+      bool hidden = (!board.pieceMoved(r,c2) && t != KING);
 
-  RevealBoard board;
-  Game game(&board);
-
-  // socket setup
-  int s=socket(AF_INET,SOCK_STREAM,0);
-  if(s<0){perror("socket"); return 1;}
-  int opt=1;
-  setsockopt(s,SOL_SOCKET,SO_REUSEADDR,&opt,sizeof(opt));
-  sockaddr_in addr{};
-  addr.sin_family=AF_INET;
-  addr.sin_addr.s_addr=htonl(INADDR_ANY);
-  addr.sin_port=htons(8080);
-  if(bind(s,(sockaddr*)&addr,sizeof(addr))<0){perror("bind"); return 1;}
-  if(listen(s,16)<0){perror("listen"); return 1;}
-  fprintf(stderr,
-          "Web GUI on http://localhost:8080  (ssh -L 8080:localhost:8080 <you>@<host>)\n");
+      const char* tn =
+        (t==PAWN  ? "PAWN"  :
+         t==KNIGHT? "KNIGHT":
+         t==BISHOP? "BISHOP":
+         t==ROOK  ? "ROOK"  :
+         t==QUEEN ? "QUEEN" : "KING");
+      const char* cn = (col==WHITE? "WHITE":"BLACK");
 
+      js<<"{\"r\":"<<r
+        <<",\"c\":"<<c2
+        <<",\"type\":\""<<tn<<"\""
+        <<",\"color\":\""<<cn<<"\""
+        <<",\"hidden\":"<<(hidden?"true":"false")
+        <<"}";
+    }
+  }
+  // add current turn + game state
+  PieceColor turn = game.getCurrentTurn();
+  GameState gs = game.getGameState();
+  const char* turnStr = (turn==WHITE? "WHITE":"BLACK");
+  const char* stateStr =
+    (gs==INPROGRESS? "INPROGRESS" :
+     gs==CHECK     ? "CHECK"      :
+     gs==CHECKMATE ? "CHECKMATE"  :
+     gs==DRAW      ? "DRAW"       : "UNKNOWN");
+  DrawReason dr = game.getDrawReason();
+  const char* reasonStr =
+    (dr==STALEMATE            ? "STALEMATE"            :
+     dr==REPETITION           ? "REPETITION"           :
+     dr==FIFTY_MOVES          ? "FIFTY_MOVES"          :
+     dr==INSUFFICIENT_MATERIAL? "INSUFFICIENT_MATERIAL": "NONE");
+
+  js<<"],\"turn\":\""<<turnStr<<"\",\"state\":\""<<stateStr
+    <<"\",\"drawReason\":\""<<reasonStr<<"\",\"ply\":"<<game.getPly()
+    <<",\"length\":"<<game.getLength()<<"}";
+  return js.str();
+}
+
+// The state wrapped as one Server-Sent Event. /state serves the JSON inside
+// it, so both endpoints share the same buffer.
+static const size_t kSsePrefix = 6;  // "data: "
+static const size_t kSseSuffix = 2;  // "\n\n"
+static Frame state_frame(Room& room){
+  std::string js=state_json(room.board, room.game);
+  js.pop_back();
+  js+=",\"room\":"+std::to_string(room.id)+",\"white\":"+json_string(room.white)+
+      ",\"black\":"+json_string(room.black)+"}";
+  return makeFrame("data: "+js+"\n\n");
+}
+
+// ---------- accounts ----------
+// Form fields (body or query): username, password, avatar. Sessions are an
+// in-memory sid cookie, as in web/server.js, kept by the token's SHA-256 so
+// neither memory nor disk holds a usable token. With shards the home shard,
+// the only one logging users in and out, also appends each change to
+// data_dir/sessions.log ("+hash user" or "-hash"), which the other shards
+// replay before every lookup (an fstat when nothing changed). Once logouts
+// outnumber live sessions the home shard rewrites the log to a new file and
+// ends the old one with "!", telling replaying shards to reopen it.
+static const size_t kSessionsRewriteMin=1024;
+
+struct Sessions {
+  std::mutex mutex;
+  std::unordered_map<std::string, std::string> userByHash;
+  // "" when this process has the only copy
+  std::string log;
+  bool writer=false;
+  int fd=-1;
+  off_t replayed=0;
+  size_t removed=0;  // "-" lines in the writer's current file
+};
+
+// sessions.mutex held (or not yet shared): writes the live sessions to a new
+// file, renames it over the log and marks the old one as replaced
+static bool sessions_rewrite(Sessions& sessions){
+  std::string tmp=sessions.log+".tmp";
+  int fd=open(tmp.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_APPEND|O_CLOEXEC, 0600);
+  if(fd<0) return false;
+  std::string all;
+  for(auto& [hash, user] : sessions.userByHash) all+="+"+hash+" "+user+"\n";
+  if(write(fd, all.data(), all.size())!=(ssize_t)all.size() || rename(tmp.c_str(), sessions.log.c_str())!=0){
+    close(fd);
+    unlink(tmp.c_str());
+    return false;
+  }
+  if(sessions.fd>=0){
+    if(write(sessions.fd, "!\n", 2)!=2)
+      logLine("[sessions] could not mark the old %s\n", sessions.log.c_str());
+    close(sessions.fd);
+  }
+  sessions.fd=fd;
+  sessions.removed=0;
+  return true;
+}
+
+// the home shard starts a fresh log, ending one left by an earlier run so
+// shards still reading it move over
+static bool sessions_share(Sessions& sessions, const std::string& path, bool writer){
+  sessions.log=path;
+  sessions.writer=writer;
+  if(!writer) return true;
+  sessions.fd=open(path.c_str(), O_WRONLY|O_APPEND|O_CLOEXEC);
+  return sessions_rewrite(sessions);
+}
+
+// sessions.mutex held
+static void sessions_record(Sessions& sessions, const std::string& line){
+  if(!sessions.writer) return;
+  if(write(sessions.fd, line.data(), line.size())!=(ssize_t)line.size())
+    logLine("[sessions] could not append to %s\n", sessions.log.c_str());
+  if(line[0]=='-' && ++sessions.removed>=kSessionsRewriteMin && sessions.removed>sessions.userByHash.size() &&
+     !sessions_rewrite(sessions))
+    logLine("[sessions] could not rewrite %s\n", sessions.log.c_str());
+}
+
+// sessions.mutex held; reads what the home shard appended since last time
+static void sessions_replay(Sessions& sessions){
   for(;;){
-    int c=accept(s,nullptr,nullptr);
-    if(c<0){perror("accept"); continue;}
-
-    char buf[32768];
-    ssize_t n=recv(c,buf,sizeof(buf)-1,0);
-    if(n<=0){ close(c); continue; }
-    buf[n]=0;
-    std::string req(buf);
-
-    // parse request line safely
-    size_t sp1=req.find(' ');
-    size_t sp2=(sp1==std::string::npos)?
-      std::string::npos:req.find(' ',sp1+1);
-    if(sp1==std::string::npos||sp2==std::string::npos){
-      safe_send(c, http_bad()+"Bad request\n");
-      close(c);
-      continue;
+    if(sessions.fd<0){
+      sessions.fd=open(sessions.log.c_str(), O_RDONLY|O_CLOEXEC);
+      if(sessions.fd<0) return;
+      sessions.replayed=0;
+      sessions.userByHash.clear();
     }
-    std::string method=req.substr(0,sp1);
-    std::string full=req.substr(sp1+1,sp2-sp1-1), path=full, query;
-    if(auto qpos=full.find('?'); qpos!=std::string::npos){
-      path=full.substr(0,qpos);
-      query=full.substr(qpos+1);
+    struct stat st;
+    if(fstat(sessions.fd, &st)!=0 || st.st_size<=sessions.replayed) return;
+    std::string bytes(size_t(st.st_size-sessions.replayed), '\0');
+    ssize_t n=pread(sessions.fd, &bytes[0], bytes.size(), sessions.replayed);
+    if(n<=0) return;
+    bytes.resize(size_t(n));
+    // whole lines only; a line being appended is read next time
+    size_t at=0;
+    bool replaced=false;
+    for(size_t end; !replaced && (end=bytes.find('\n', at))!=std::string::npos; at=end+1){
+      std::string_view line(bytes.data()+at, end-at);
+      size_t space=line.find(' ');
+      if(line=="!")
+        replaced=true;
+      else if(line.size()>1 && line[0]=='+' && space!=std::string_view::npos)
+        sessions.userByHash[std::string(line.substr(1, space-1))]=std::string(line.substr(space+1));
+      else if(line.size()>1 && line[0]=='-')
+        sessions.userByHash.erase(std::string(line.substr(1)));
     }
+    sessions.replayed+=off_t(at);
+    if(!replaced) return;
+    close(sessions.fd);
+    sessions.fd=-1;
+  }
+}
 
-    if(method=="GET" && path=="/"){
-      safe_send(c, http_ok("text/html; charset=utf-8")+kIndexHtml);
+static std::string new_token(){
+  unsigned char bytes[16];
+  if(getrandom(bytes, sizeof(bytes), 0)!=(ssize_t)sizeof(bytes)) return "";
+  static const char* hex="0123456789abcdef";
+  std::string t;
+  for(unsigned char b : bytes){ t+=hex[b>>4]; t+=hex[b&15]; }
+  return t;
+}
+
+static std::string session_token(const HttpRequest& req){
+  std::string_view cookie=req.header("Cookie");
+  size_t at=cookie.find("sid=");
+  if(at==std::string_view::npos) return "";
+  cookie.remove_prefix(at+4);
+  return std::string(cookie.substr(0, cookie.find(';')));
+}
+
+static std::string session_user(Sessions& sessions, const HttpRequest& req){
+  std::string token=session_token(req);
+  if(token.empty()) return "";
+  std::string hash=sha256::hex(token);
+  std::lock_guard<std::mutex> lock(sessions.mutex);
+  if(!sessions.log.empty() && !sessions.writer) sessions_replay(sessions);
+  auto it=sessions.userByHash.find(hash);
+  return it==sessions.userByHash.end() ? "" : it->second;
+}
+
+static std::string_view form(const HttpRequest& req){
+  return req.body.empty() ? req.query : req.body;
+}
+
+static bool handle_signup(UserStore& users, int c, const HttpRequest& req){
+  UserStore::Status st=users.addUser(queryText(form(req),"username"), queryText(form(req),"password"),
+                                     queryText(form(req),"avatar"));
+  if(st==UserStore::OK) send_json(c, "200 OK", "{\"message\":\"account created\"}");
+  else if(st==UserStore::EXISTS) send_json(c, "409 Conflict", "{\"message\":\"username taken\"}");
+  else if(st==UserStore::INVALID) send_json(c, "400 Bad Request", "{\"message\":\"missing or invalid fields\"}");
+  else send_json(c, "500 Internal Server Error", "{\"message\":\"could not save\"}");
+  return false;
+}
+
+static bool handle_login(UserStore& users, Sessions& sessions, int c, const HttpRequest& req){
+  std::string name=queryText(form(req),"username");
+  std::string token;
+  if(users.checkPassword(name, queryText(form(req),"password"))==UserStore::OK)
+    token=new_token();
+  if(token.empty()){
+    send_json(c, "401 Unauthorized", "{\"message\":\"invalid credentials\"}");
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(sessions.mutex);
+    std::string hash=sha256::hex(token);
+    sessions.userByHash[hash]=name;
+    sessions_record(sessions, "+"+hash+" "+name+"\n");
+  }
+  send_json(c, "200 OK", "{\"message\":\"logged in\"}", "Set-Cookie: sid="+token+"; Path=/; HttpOnly\r\n");
+  return false;
+}
+
+static bool handle_logout(Sessions& sessions, int c, const HttpRequest& req){
+  {
+    std::lock_guard<std::mutex> lock(sessions.mutex);
+    std::string hash=sha256::hex(session_token(req));
+    if(sessions.userByHash.erase(hash))
+      sessions_record(sessions, "-"+hash+"\n");
+  }
+  send_json(c, "200 OK", "{\"message\":\"logged out\"}", "Set-Cookie: sid=; Path=/; Max-Age=0\r\n");
+  return false;
+}
+
+static std::string stats_json(const UserStats& s){
+  std::ostringstream js;
+  js<<"{\"user\":"<<json_string(s.name)<<",\"avatar\":"<<json_string(s.avatar)
+    <<",\"wins\":"<<s.wins<<",\"losses\":"<<s.losses<<",\"draws\":"<<s.draws<<",\"rank\":"<<s.rank<<",\"rating\":"<<s.rating<<"}";
+  return js.str();
+}
+
+// GET /api/profile?user=name (default: the logged in user)
+static bool handle_profile(UserStore& users, Sessions& sessions, int c, const HttpRequest& req){
+  std::string name=queryText(req.query,"user");
+  if(name.empty()) name=session_user(sessions, req);
+  UserStats stats;
+  if(!users.stats(name, stats)){
+    send_json(c, "404 Not Found", "{\"user\":null}");
+    return false;
+  }
+  static const char* outcomes[]={"1-0","0-1","1/2"};
+  std::ostringstream js;
+  js<<"{\"stats\":"<<stats_json(stats)<<",\"games\":[";
+  bool first=true;
+  for(const GameResult& g : users.recentGames(name, 20)){
+    if(!first) js<<",";
+    first=false;
+    js<<"{\"white\":"<<json_string(g.white)<<",\"black\":"<<json_string(g.black)
+      <<",\"result\":\""<<outcomes[g.outcome]<<"\",\"plies\":"<<g.plies<<",\"finishedAt\":"<<g.finishedAt<<"}";
+  }
+  js<<"]}";
+  send_json(c, "200 OK", js.str());
+  return false;
+}
+
+// GET /api/leaderboard?n=10&offset=0 (n <= 100)
+static bool handle_leaderboard(UserStore& users, int c, const HttpRequest& req){
+  int n=10, offset=0;
+  queryInt(req.query,"n",n);
+  queryInt(req.query,"offset",offset);
+  std::string js="[";
+  for(const UserStats& s : users.leaderboard(std::max(0, std::min(n, 100)), std::max(0, offset))){
+    if(js.size()>1) js+=",";
+    js+=stats_json(s);
+  }
+  send_json(c, "200 OK", js+"]");
+  return false;
+}
+
+// ---------- archive ----------
+static const char* outcome_text(GameOutcome o){
+  static const char* text[]={"1-0","0-1","1/2"};
+  return text[o];
+}
+
+// GET /api/games?user=name&n=20&before=id: the user's archived games, newest
+// first; page with before = the last id seen
+static bool handle_games(GameArchive& archive, int c, const HttpRequest& req){
+  std::string user=queryText(req.query,"user");
+  int n=20, before=-1;
+  queryInt(req.query,"n",n);
+  queryInt(req.query,"before",before);
+  std::ostringstream js;
+  js<<"[";
+  bool first=true;
+  for(uint64_t id : archive.gamesOf(user, std::max(0, std::min(n, 100)), before<0 ? UINT64_MAX : (uint64_t)before)){
+    GameArchive::Summary s;
+    if(!archive.summary(id, s)) continue;
+    if(!first) js<<",";
+    first=false;
+    js<<"{\"id\":"<<s.id<<",\"white\":"<<json_string(s.white)<<",\"black\":"<<json_string(s.black)
+      <<",\"result\":\""<<outcome_text(s.outcome)<<"\",\"plies\":"<<s.plies<<",\"finishedAt\":"<<s.finishedAt<<"}";
+  }
+  js<<"]";
+  send_json(c, "200 OK", js.str());
+  return false;
+}
+
+// GET /api/game?id=n: the starting layout (piece letters for the 15 hidden
+// squares of each side) and the moves as [sr,sc,dr,dc]
+static bool handle_game(GameArchive& archive, int c, const HttpRequest& req){
+  int id=-1;
+  ArchivedGame g;
+  if(!queryInt(req.query,"id",id) || id<0 || !archive.read((uint64_t)id, g)){
+    send_json(c, "404 Not Found", "{\"game\":null}");
+    return false;
+  }
+  auto layout=[](const PieceType* types){
+    std::string s;
+    for(int i=0;i<RevealLayout::SQUARES;i++) s+="PNBRQK"[types[i]];
+    return s;
+  };
+  std::ostringstream js;
+  js<<"{\"id\":"<<id<<",\"white\":"<<json_string(g.white)<<",\"black\":"<<json_string(g.black)
+    <<",\"result\":\""<<outcome_text(g.outcome)<<"\",\"finishedAt\":"<<g.finishedAt
+    <<",\"layout\":{\"white\":\""<<layout(g.layout.white)<<"\",\"black\":\""<<layout(g.layout.black)<<"\"},\"moves\":[";
+  for(size_t i=0;i<g.moves.size();i++){
+    if(i) js<<",";
+    js<<"["<<g.moves[i].from/8<<","<<g.moves[i].from%8<<","<<g.moves[i].to/8<<","<<g.moves[i].to%8<<"]";
+  }
+  js<<"]}";
+  send_json(c, "200 OK", js.str());
+  return false;
+}
+
+// ---------- analysis ----------
+// engine score for JSON: {"cp":n} or {"mate":n}, n > 0 when the side to move mates
+static std::string score_json(int score){
+  if(std::abs(score)>=MATE_SCORE-MAX_PLY){
+    int plies=MATE_SCORE-std::abs(score);
+    return "{\"mate\":"+std::to_string(score>0 ? (plies+1)/2 : -(plies/2))+"}";
+  }
+  return "{\"cp\":"+std::to_string(score)+"}";
+}
+
+static std::string move_json(Move m){
+  return "["+std::to_string(m.from/8)+","+std::to_string(m.from%8)+","+std::to_string(m.to/8)+","+std::to_string(m.to%8)+"]";
+}
+
+// GET /analysis/<game id>: 202 {"status":"queued"|"running"} until done
+// (an unanalyzed archived game is queued by asking), then every move with
+// the engine's best lines, its score and a mark
+static bool handle_analysis(Analyzer& analyzer, const GameArchive& archive, int c, const HttpRequest& req){
+  static const char* marks[]={"","inaccuracy","mistake","blunder"};
+  std::string_view idText=req.path.substr(std::string_view("/analysis/").size());
+  char* end=nullptr;
+  std::string idString(idText);
+  unsigned long long id=strtoull(idString.c_str(), &end, 10);
+  if(idString.empty() || *end || id>=archive.size()){
+    send_json(c, "404 Not Found", "{\"status\":\"unknown\"}");
+    return false;
+  }
+  std::shared_ptr<const GameAnalysis> result;
+  Analyzer::State state=analyzer.status(id, result);
+  if(state==Analyzer::UNKNOWN){
+    if(!analyzer.submit(id)){
+      send_json(c, "503 Service Unavailable", "{\"status\":\"busy\"}", "Retry-After: 10\r\n");
+      return false;
     }
-    else if(method=="GET" && path=="/state"){
-      std::ostringstream js;
-      js<<"{\"pieces\":[";
-      bool first=true;
-      for(int r=0;r<8;++r){
-        for(int c2=0;c2<8;++c2){
-          if(!board.isOccupied(r,c2)) continue;
-          if(!first) js<<","; first=false;
-
-          PieceType t=board.getPieceType(r,c2);
-          PieceColor col=board.getColor(r,c2);
-          bool hidden = (!board.pieceMoved(r,c2) && t != KING);
-
-          const char* tn =
-            (t==PAWN  ? "PAWN"  :
-             t==KNIGHT? "KNIGHT":
-             t==BISHOP? "BISHOP":
-             t==ROOK  ? "ROOK"  :
-             t==QUEEN ? "QUEEN" : "KING");
-          const char* cn = (col==WHITE? "WHITE":"BLACK");
-
-          js<<"{\"r\":"<<r
-            <<",\"c\":"<<c2
-            <<",\"type\":\""<<tn<<"\""
-            <<",\"color\":\""<<cn<<"\""
-            <<",\"hidden\":"<<(hidden?"true":"false")
-            <<"}";
-        }
-      }
-      // add current turn + game state
-      PieceColor turn = game.getCurrentTurn();
-      GameState gs = game.getGameState();
-      const char* turnStr = (turn==WHITE? "WHITE":"BLACK");
-      const char* stateStr =
-        (gs==INPROGRESS? "INPROGRESS" :
-         gs==CHECK     ? "CHECK"      :
-         gs==CHECKMATE ? "CHECKMATE"  :
-         gs==DRAW      ? "DRAW"       : "UNKNOWN");
-
-      js<<"],\"turn\":\""<<turnStr<<"\",\"state\":\""<<stateStr<<"\"}";
-      safe_send(c, http_ok("application/json")+js.str());
+    state=Analyzer::QUEUED;
+  }
+  if(state==Analyzer::QUEUED || state==Analyzer::RUNNING){
+    send_json(c, "202 Accepted", std::string("{\"status\":\"")+(state==Analyzer::QUEUED ? "queued" : "running")+"\"}");
+    return false;
+  }
+  if(state==Analyzer::FAILED){
+    send_json(c, "404 Not Found", "{\"status\":\"failed\"}");
+    return false;
+  }
+  std::ostringstream js;
+  js<<"{\"status\":\"done\",\"id\":"<<id<<",\"depth\":"<<result->depth<<",\"moves\":[";
+  for(size_t i=0;i<result->moves.size();i++){
+    const MoveAnnotation& a=result->moves[i];
+    if(i) js<<",";
+    js<<"{\"move\":"<<move_json(a.played)<<",\"score\":"<<score_json(a.scorePlayed)
+      <<",\"loss\":"<<a.loss<<",\"mark\":\""<<marks[a.mark]<<"\",\"best\":[";
+    for(int k=0;k<a.before.count;k++)
+      js<<(k ? "," : "")<<"{\"move\":"<<move_json(a.before.lines[k].move)<<",\"score\":"<<score_json(a.before.lines[k].score)<<"}";
+    js<<"]}";
+  }
+  js<<"],\"final\":"<<score_json(result->last.score)<<"}";
+  send_json(c, "200 OK", js.str());
+  return false;
+}
+
+// ---------- puzzles ----------
+// Stateless: the client sends the puzzle id and the ply it is answering.
+
+// GET /api/puzzle?id=n (default: a random one)
+static bool handle_puzzle(const PuzzleDb& puzzles, int c, const HttpRequest& req){
+  int id=-1;
+  if(!queryInt(req.query,"id",id)){
+    uint32_t r=0;
+    if(puzzles.size() && getrandom(&r, sizeof(r), 0)==(ssize_t)sizeof(r)) id=(int)(r%puzzles.size());
+  }
+  if(id<0 || (size_t)id>=puzzles.size()){
+    send_json(c, "404 Not Found", "{\"puzzle\":null}");
+    return false;
+  }
+  const PuzzleRecord& p=puzzles[id];
+  std::unique_ptr<Board> board(p.board());
+  std::ostringstream js;
+  js<<"{\"id\":"<<id<<",\"fen\":"<<json_string(boardToFen(*board, p.turn(), 0, 1))
+    <<",\"variant\":\""<<(p.variant()==REVEAL_VARIANT ? "reveal" : "standard")<<"\",\"mateIn\":"<<int(p.mateIn)
+    <<",\"plies\":"<<int(p.plies)<<",\"rating\":"<<p.rating<<"}";
+  send_json(c, "200 OK", js.str());
+  return false;
+}
+
+// POST /api/puzzle/move?id=n&ply=k&sr&sc&dr&dc (k even): answers correct,
+// and if so the opponent's reply or solved
+static bool handle_puzzle_move(const PuzzleDb& puzzles, int c, const HttpRequest& req){
+  int id=-1, ply=-1, sr=-1, sc=-1, dr=-1, dc=-1;
+  bool parsed = queryInt(req.query,"id",id) && queryInt(req.query,"ply",ply) &&
+                queryInt(req.query,"sr",sr) && queryInt(req.query,"sc",sc) &&
+                queryInt(req.query,"dr",dr) && queryInt(req.query,"dc",dc);
+  if(!parsed || id<0 || (size_t)id>=puzzles.size() || sr<0||sr>7||sc<0||sc>7||dr<0||dr>7||dc<0||dc>7){
+    send_json(c, "400 Bad Request", "{\"correct\":false}");
+    return false;
+  }
+  const PuzzleRecord& p=puzzles[id];
+  bool correct=acceptsMove(p, ply, Move(sr*8+sc, dr*8+dc));
+  std::ostringstream js;
+  js<<"{\"correct\":"<<(correct?"true":"false");
+  if(correct){
+    bool solved = ply+1>=p.plies;
+    js<<",\"solved\":"<<(solved?"true":"false");
+    if(!solved){
+      Move r=p.solution[ply+1];
+      js<<",\"reply\":["<<r.from/8<<","<<r.from%8<<","<<r.to/8<<","<<r.to%8<<"]";
     }
-    else if(method=="GET" && path=="/moves"){
-      int sr=qparam_int(query,"sr"), sc=qparam_int(query,"sc");
-      fprintf(stderr, "[/moves] row,col = %d,%d\n", sr, sc);
-
-      std::ostringstream js;
-      js<<"[";
-      if(sr>=0&&sr<8&&sc>=0&&sc<8){
-        if(!board.isOccupied(sr,sc)){
-          fprintf(stderr, "  not occupied at (%d,%d)\n", sr, sc);
-        }else{
-          PieceType t=board.getPieceType(sr,sc);
-          PieceColor col=board.getColor(sr,sc);
-          fprintf(stderr, "  piece type=%d color=%d\n", (int)t, (int)col);
-
-          auto moves = board.validMoves(sr,sc); // vector<Position> with x=row, y=col
-          fprintf(stderr, "  validMoves returned %zu\n", moves.size());
-          bool firstM=true;
-          for(const auto& m : moves){
-            int mr = m.x;   // row
-            int mc = m.y;   // col
-            if(!firstM) js<<","; firstM=false;
-            js<<"{\"r\":"<<mr<<",\"c\":"<<mc<<"}";
-          }
-        }
+  }
+  js<<"}";
+  send_json(c, "200 OK", js.str());
+  return false;
+}
+
+// ---------- rooms ----------
+// Game routes take ?room=id (default 0, the open practice room). Handlers
+// run on worker threads, so a room is only touched with its mutex held;
+// frames are published while it is held so streams see states in the order
+// moves were made.
+
+// the room named by the request, or null after answering 404
+static std::shared_ptr<Room> find_room(GameHost& host, int c, const HttpRequest& req){
+  int id=0;
+  queryInt(req.query,"room",id);
+  std::shared_ptr<Room> room = id>=0 ? host.find(uint32_t(id)) : nullptr;
+  if(!room) send_json(c, "404 Not Found", "{\"message\":\"no such room\"}");
+  return room;
+}
+
+
+static bool handle_index(int c, const HttpRequest&){
+  safe_send(c, http_ok("text/html; charset=utf-8")+kIndexHtml);
+  return false;
+}
+
+static bool handle_state(Room& room, int c, const HttpRequest&){
+  Frame frame;
+  {
+    std::lock_guard<std::mutex> lock(room.mutex);
+    frame=room.state;
+  }
+  safe_send(c, http_ok("application/json"));
+  safe_send(c, frame->data()+kSsePrefix, frame->size()-kSsePrefix-kSseSuffix);
+  return false;
+}
+
+static bool handle_moves(Room& room, int c, const HttpRequest& req){
+  int sr=-1, sc=-1;
+  queryInt(req.query,"sr",sr);
+  queryInt(req.query,"sc",sc);
+
+  std::ostringstream js;
+  js<<"[";
+  if(sr>=0&&sr<8&&sc>=0&&sc<8){
+    std::lock_guard<std::mutex> lock(room.mutex);
+    if(!room.board.isOccupied(sr,sc)){
+      logLine("[/moves] (%d,%d) not occupied\n", sr, sc);
+    }else{
+      PieceType t=room.board.getPieceType(sr,sc);
+      PieceColor col=room.board.getColor(sr,sc);
+
+      auto moves = room.board.validMoves(sr,sc); // vector<Position> with x=row, y=col
+      logLine("[/moves] (%d,%d) type=%d color=%d -> %zu moves\n", sr, sc, (int)t, (int)col, moves.size());
+      bool firstM=true;
+      for(const auto& m : moves){
+        int mr = m.x;   // row
+        int mc = m.y;   // col
+        if(!firstM) js<<","; firstM=false;
+        js<<"{\"r\":"<<mr<<",\"c\":"<<mc<<"}";
       }
-      js<<"]";
-      safe_send(c, http_ok("application/json")+js.str());
     }
-    else if(method=="POST" && path=="/move"){
-      int sr=qparam_int(query,"sr"), sc=qparam_int(query,"sc");
-      int dr=qparam_int(query,"dr"), dc=qparam_int(query,"dc");
-      fprintf(stderr, "[/move] (%d,%d) -> (%d,%d)\n", sr,sc,dr,dc);
-
-      bool ok=false;
-      if(sr>=0&&sr<8&&sc>=0&&sc<8&&dr>=0&&dr<8&&dc>=0&&dc<8){
-        ok = game.makeMove(sr,sc,dr,dc);
-        if (ok)
-          fprintf(stderr, "  -> ok\n");
-        else
-          fprintf(stderr, "  -> rejected (wrong side or illegal)\n");
-      } else {
-        fprintf(stderr, "  -> rejected (invalid coords)\n");
+  }
+  js<<"]";
+  safe_send(c, http_ok("application/json")+js.str());
+  return false;
+}
+
+// In a matched room only the player to move may move; the result is saved
+// once the game ends. In a single player room the human moves (a guest's
+// room takes moves from anyone) and the engine answers from the pool.
+static bool handle_move(HttpServer& server, GameHost& host, UserStore& users, GameArchive& archive,
+                        Analyzer& analyzer, EnginePool& engines, Sessions& sessions, Room& room,
+                        int c, const HttpRequest& req){
+  int sr=-1, sc=-1, dr=-1, dc=-1;
+  bool parsed = queryInt(req.query,"sr",sr) && queryInt(req.query,"sc",sc) &&
+                queryInt(req.query,"dr",dr) && queryInt(req.query,"dc",dc);
+  std::string user = room.open() ? "" : session_user(sessions, req);
+
+  bool ok=false, finished=false;
+  ArchivedGame record;
+  if(parsed&&sr>=0&&sr<8&&sc>=0&&sc<8&&dr>=0&&dr<8&&dc>=0&&dc<8){
+    std::lock_guard<std::mutex> lock(room.mutex);
+    PieceColor turn=room.game.getCurrentTurn();
+    const std::string& player = (turn==WHITE ? room.white : room.black);
+    bool mine = room.open() || (room.engine ? turn!=room.engine->color && (player.empty() || user==player)
+                                            : user==player);
+    ok = mine && room.game.makeMove(sr,sc,dr,dc);
+    if (ok) {
+      logLine("[/move] room %u (%d,%d) -> (%d,%d) ok\n", room.id, sr,sc,dr,dc);
+      host.refresh(room);
+      server.publish(room.state, room.id);
+      if(room.engine && !room.game.isGameOver())
+        engines.engineToMove(room.shared_from_this());
+      // single player games are casual: neither rated nor archived
+      if(!room.open() && !room.engine && room.game.isGameOver() && !room.resultRecorded){
+        room.resultRecorded=true;
+        finished=true;
+        record.white=room.white;
+        record.black=room.black;
+        record.layout=room.board.layout();
+        record.moves=room.game.getMoves();
+        if(room.game.getGameState()==CHECKMATE)
+          record.outcome = (room.game.getCurrentTurn()==WHITE) ? BLACK_WINS : WHITE_WINS;
       }
-      safe_send(c, http_ok("application/json")+
-                   std::string("{\"ok\":")+(ok?"true":"false")+"}");
     }
+    else
+      logLine("[/move] room %u (%d,%d) -> (%d,%d) rejected (%s)\n", room.id, sr,sc,dr,dc,
+              mine ? "wrong side or illegal" : "not your move");
+  } else {
+    logLine("[/move] room %u (%d,%d) -> (%d,%d) rejected (invalid coords)\n", room.id, sr,sc,dr,dc);
+  }
+  // outside the room lock: both stores sync to disk
+  if(finished){
+    record.finishedAt=(int64_t)time(nullptr);
+    users.recordResult(record.white, record.black, record.outcome, (uint32_t)record.moves.size(), record.finishedAt);
+    int64_t id=archive.append(record);
+    if(id<0) logLine("[/move] room %u: game not archived\n", room.id);
     else{
-      safe_send(c,
-        "HTTP/1.1 404 Not Found\r\nConnection: close\r\n\r\nNot Found");
+      logLine("[/move] room %u archived as game %lld\n", room.id, (long long)id);
+      analyzer.submit((uint64_t)id);
     }
+  }
+  safe_send(c, http_ok("application/json")+
+               std::string("{\"ok\":")+(ok?"true":"false")+"}");
+  return false;
+}
+
+// Takebacks and review in casual rooms: POST /undo, /redo and /jump?ply=N
+// (0..length), each O(1) per ply on the room's own board. Open rooms step
+// one ply; single player rooms step between the human's turns, and the
+// engine moves again if a jump leaves it to move. Rated rooms get 403.
+static bool handle_navigate(HttpServer& server, GameHost& host, EnginePool& engines, Sessions& sessions,
+                            Room& room, int c, const HttpRequest& req){
+  if(!room.open() && !room.engine){
+    send_json(c, "403 Forbidden", "{\"ok\":false}");
+    return false;
+  }
+  std::string user = room.open() ? "" : session_user(sessions, req);
+  int target=-1;
+  queryInt(req.query,"ply",target);
 
-    close(c);
+  bool ok=false;
+  int ply;
+  {
+    std::lock_guard<std::mutex> lock(room.mutex);
+    if(room.engine){
+      const std::string& human = (room.engine->color==WHITE ? room.black : room.white);
+      if(!human.empty() && user!=human){
+        send_json(c, "403 Forbidden", "{\"ok\":false}");
+        return false;
+      }
+    }
+    Game& game=room.game;
+    auto engineTurn=[&]{ return room.engine && game.getCurrentTurn()==room.engine->color; };
+    if(req.path=="/undo"){
+      ok=game.undo();
+      while(ok && engineTurn() && game.undo()) {}
+    }else if(req.path=="/redo"){
+      ok=game.redo();
+      while(ok && engineTurn() && game.redo()) {}
+    }else{
+      ok=game.jumpTo(target);
+    }
+    if(ok){
+      logLine("[%.*s] room %u now at ply %d of %d\n", (int)req.path.size(), req.path.data(), room.id,
+              game.getPly(), game.getLength());
+      host.refresh(room);
+      server.publish(room.state, room.id);
+      if(engineTurn() && !game.isGameOver()) engines.engineToMove(room.shared_from_this());
+      else if(room.engine) room.engine->search.stop();
+    }
+    ply=game.getPly();
   }
+  send_json(c, "200 OK", std::string("{\"ok\":")+(ok?"true":"false")+",\"ply\":"+std::to_string(ply)+"}");
+  return false;
+}
+
+// Engine suggestion for the side to move: GET /engine?movetime=ms (<= 5000).
+// Searches a snapshot, so the room is only locked while copying it. Open
+// rooms only; matched games get no hints.
+static bool handle_engine(Room& room, int c, const HttpRequest& req){
+  if(!room.open()){
+    send_json(c, "403 Forbidden", "{\"ok\":false}");
+    return false;
+  }
+  static const metrics::Counter nodes("engine_nodes_total", "Positions searched for /engine.");
+  static thread_local Search search(16);
+  int movetime=500;
+  queryInt(req.query,"movetime",movetime);
+  SearchLimits limits;
+  limits.movetime=std::max(10, std::min(movetime, 5000));
+
+  std::unique_ptr<Board> board;
+  PositionHistory history;
+  PieceColor side;
+  int halfmoveClock;
+  {
+    std::lock_guard<std::mutex> lock(room.mutex);
+    board.reset(room.board.clone());
+    history=room.game.getHistory();
+    side=room.game.getCurrentTurn();
+    halfmoveClock=room.game.getHalfmoveClock();
+  }
+  SearchReport last;
+  Move best=search.run(*board, side, halfmoveClock, history, limits,
+                       [&](const SearchReport& r){ last=r; });
+  nodes.add(search.nodesSearched());
+
+  std::ostringstream js;
+  if(best.from==best.to) js<<"{\"ok\":false}";
+  else js<<"{\"ok\":true,\"sr\":"<<best.from/8<<",\"sc\":"<<best.from%8
+         <<",\"dr\":"<<best.to/8<<",\"dc\":"<<best.to%8
+         <<",\"score\":"<<last.score<<",\"depth\":"<<last.depth<<",\"nodes\":"<<last.nodes<<"}";
+  safe_send(c, http_ok("application/json")+js.str());
+  return false;
+}
+
+// ---------- single player ----------
+static EngineConfig engineConfig;
+
+// POST /api/engine-game?color=white|black&movetime=ms (100..10000, default
+// 1000): a room against the engine, the caller playing color
+static bool handle_engine_game(GameHost& host, EnginePool& engines, Sessions& sessions, int c, const HttpRequest& req){
+  std::string color=queryText(req.query,"color");
+  int movetime=1000;
+  queryInt(req.query,"movetime",movetime);
+  PieceColor human = (color=="black") ? BLACK : WHITE;
+  std::string user=session_user(sessions, req);
+  auto seat=std::make_shared<EngineSeat>(human==WHITE ? BLACK : WHITE, std::max(100, std::min(movetime, 10000)),
+                                         engineConfig.hashMegabytes);
+  std::shared_ptr<Room> room = (human==WHITE) ? host.create(user, "engine", seat) : host.create("engine", user, seat);
+  if(seat->color==WHITE){
+    std::lock_guard<std::mutex> lock(room->mutex);
+    engines.engineToMove(room);
+  }
+  logLine("[engine] room %u: %s plays %s, layout %llu\n", room->id, user.empty() ? "guest" : user.c_str(),
+          human==WHITE ? "white" : "black", (unsigned long long)room->board.layout().index());
+  send_json(c, "200 OK", "{\"room\":"+std::to_string(room->id)+",\"color\":\""+(human==WHITE?"WHITE":"BLACK")+"\"}");
+  return false;
+}
+
+// ---------- matchmaking ----------
+// POST /api/queue joins, POST /api/queue/leave leaves, GET /api/queue polls:
+// {"state":"waiting"} until a room is made for the player.
+static bool handle_queue_join(Lobby& lobby, UserStore& users, Sessions& sessions, int c, const HttpRequest& req){
+  std::string user=session_user(sessions, req);
+  UserStats stats;
+  if(user.empty() || !users.stats(user, stats)){
+    send_json(c, "401 Unauthorized", "{\"message\":\"log in first\"}");
+    return false;
+  }
+  if(lobby.join(user, stats.rating)) send_json(c, "200 OK", "{\"state\":\"waiting\"}");
+  else send_json(c, "409 Conflict", "{\"message\":\"already waiting\"}");
+  return false;
+}
+
+static bool handle_queue_leave(Lobby& lobby, Sessions& sessions, int c, const HttpRequest& req){
+  bool left=lobby.leave(session_user(sessions, req));
+  send_json(c, "200 OK", std::string("{\"left\":")+(left?"true":"false")+"}");
+  return false;
+}
+
+static bool handle_queue_poll(Lobby& lobby, Sessions& sessions, int c, const HttpRequest& req){
+  LobbyMatch match;
+  Lobby::State st=lobby.poll(session_user(sessions, req), match);
+  if(st==Lobby::MATCHED)
+    send_json(c, "200 OK", "{\"state\":\"matched\",\"room\":"+std::to_string(match.room)+
+                           ",\"color\":\""+(match.color==WHITE?"WHITE":"BLACK")+
+                           "\",\"opponent\":"+json_string(match.opponent)+"}");
+  else
+    send_json(c, "200 OK", st==Lobby::WAITING ? "{\"state\":\"waiting\"}" : "{\"state\":\"idle\"}");
+  return false;
+}
+
+static bool handle_metrics(int c, const HttpRequest&){
+  safe_send(c, http_ok("text/plain; version=0.0.4")+metrics::render());
+  return false;
+}
+
+// Spans from every thread that ended in the last ms milliseconds (<= 10000),
+// as Chrome trace JSON: GET /debug/trace?ms=500. Only with ENABLE_TRACE.
+static bool handle_trace(int c, const HttpRequest& req){
+  int ms=500;
+  queryInt(req.query,"ms",ms);
+  safe_send(c, http_ok("application/json")+trace::chromeJson(std::max(1, std::min(ms, 10000))));
+  return false;
+}
+
+// ---------- shards ----------
+// web_gui ... k/n is process k of n sharing the port (see HttpServer). A
+// room belongs to the shard GameHost::shardOf names; accounts, the lobby
+// (and so rated rooms), the archive and analysis belong to the home shard,
+// the only one writing the data dir. Everything else, single player rooms
+// included, is served where it lands.
+static const int kHomeShard = 0;
+
+static int owner_shard(const HttpRequest& req, int shards){
+  std::string_view p=req.path;
+  if(p=="/events" || p=="/state" || p=="/moves" || p=="/move" || p=="/undo" || p=="/redo" ||
+     p=="/jump" || p=="/engine"){
+    int id=0;
+    queryInt(req.query,"room",id);
+    return id>=0 ? (int)GameHost::shardOf(uint32_t(id), shards) : -1;
+  }
+  if(p=="/api/engine-game" || p=="/api/me" || p.rfind("/api/puzzle",0)==0) return -1;
+  if(p.rfind("/api/",0)==0 || p.rfind("/analysis/",0)==0) return kHomeShard;
+  return -1;
+}
+
+// usage: web_gui [public_dir] [data_dir] [k/n]
+//   (defaults web/public and web/data, relative to the cwd; an existing
+//    data_dir/users.csv from web/server.js is imported on first start;
+//    data_dir/puzzles.bin from puzzle_tool is served when present;
+//    k/n runs this as shard k of n processes on one port, all given the
+//    same data_dir, e.g. 0/4 1/4 2/4 3/4; rooms without a request for
+//    ROOM_IDLE_SECONDS, default 600, hibernate until the next one, 0 never)
+int main(int argc, char** argv){
+  signal(SIGPIPE, SIG_IGN);
+  struct sigaction sa{};
+  sa.sa_handler = segv_handler;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESETHAND;
+  sigaction(SIGSEGV, &sa, nullptr);
+
+  // every spectator holds a socket open
+  rlimit lim{};
+  if(getrlimit(RLIMIT_NOFILE,&lim)==0){
+    lim.rlim_cur=lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE,&lim);
+  }
+
+  HttpServerConfig config;
+  if(argc>3 && (sscanf(argv[3], "%d/%d", &config.shard, &config.shards)!=2 ||
+                config.shards<1 || config.shard<0 || config.shard>=config.shards)){
+    fprintf(stderr, "bad shard %s, expected k/n with 0 <= k < n\n", argv[3]);
+    return 1;
+  }
+  const bool home = (config.shard==kHomeShard);
+  static GameHost host(state_frame, config.shard, config.shards);
+  if(GameHost::shardOf(0, config.shards)==uint32_t(config.shard))
+    host.create();   // room 0: open practice board
+  const char* idle=getenv("ROOM_IDLE_SECONDS");
+  int roomIdleSeconds = idle ? atoi(idle) : 600;
+  if(roomIdleSeconds>0)
+    host.hibernateAfter(std::chrono::seconds(roomIdleSeconds));
+  static StaticFiles assets;
+  const char* publicDir = (argc>1) ? argv[1] : "web/public";
+  logLine("Serving %zu static files from %s\n", assets.load(publicDir), publicDir);
+  const std::string dataDir = (argc>2) ? argv[2] : "web/data";
+  mkdir(dataDir.c_str(), 0700);
+  // opened by the home shard only; the others never run their handlers
+  static UserStore users(dataDir+"/users.log");
+  static GameArchive archive(dataDir+"/games.bin");
+  std::string error;
+  if(home){
+    if(!users.open(error)){
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    if(users.userCount()==0)
+      users.importUsersCsv(dataDir+"/users.csv");
+    logLine("%zu users in %s/users.log\n", users.userCount(), dataDir.c_str());
+    if(!archive.open(error)){
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    logLine("%zu games in %s/games.bin\n", archive.size(), dataDir.c_str());
+  }
+  // a quarter of the cores at most, and only their idle time
+  AnalyzerConfig analysis;
+  analysis.workers=home ? std::max(1u, std::thread::hardware_concurrency()/4) : 1;
+  static Analyzer analyzer(archive, analysis);
+  // optional; build one with puzzle_tool
+  static PuzzleDb puzzles;
+  if(puzzles.open(dataDir+"/puzzles.bin", error))
+    logLine("%zu puzzles in %s/puzzles.bin\n", puzzles.size(), dataDir.c_str());
+  // optional; build one with layout_tool. Rooms made from here on skip
+  // layouts whose either side scores more than this from the median.
+  const int fairLayoutCp=150;
+  static LayoutTable layouts;
+  if(layouts.open(dataDir+"/layouts.bin", error)){
+    layouts.setLimit(fairLayoutCp);
+    RevealBoard::setLayoutTable(&layouts);
+    logLine("layouts from %s/layouts.bin, limit %d cp around %d\n", dataDir.c_str(), fairLayoutCp, layouts.median());
+  }
+  static Sessions sessions;
+  if(config.shards>1 && !sessions_share(sessions, dataDir+"/sessions.log", home)){
+    perror((dataDir+"/sessions.log").c_str());
+    return 1;
+  }
+  static Lobby lobby([](const std::string& white, const std::string& black){
+    auto room=host.create(white, black);
+    logLine("[lobby] room %u: %s vs %s, layout %llu\n", room->id, white.c_str(), black.c_str(),
+            (unsigned long long)room->board.layout().index());
+    return room->id;
+  });
+
+  static HttpServer server(config);
+  static const int shards=config.shards;
+  if(shards>1)
+    server.placement([](const HttpRequest& req){ return owner_shard(req, shards); });
+  // engine moves and pondering for single player rooms, on half the cores
+  // (split between the shards)
+  int cores=(int)std::max(2u, std::thread::hardware_concurrency()/unsigned(config.shards));
+  engineConfig.threads=std::max(2, cores/2);
+  engineConfig.ponderSlots=std::max(1, cores/4);
+  static EnginePool engines([](Room& room){
+    host.refresh(room);
+    server.publish(room.state, room.id);
+  }, engineConfig);
+  server.route("GET", "/", LANE_NORMAL, handle_index);
+  // live state stream for players and spectators
+  server.route("GET", "/events", LANE_LOOP, [](int c, const HttpRequest& req){
+    auto room=find_room(host, c, req);
+    if(!room) return false;
+    safe_send(c, "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                 "Cache-Control: no-cache\r\nConnection: keep-alive\r\n\r\n");
+    Frame frame;
+    {
+      std::lock_guard<std::mutex> lock(room->mutex);
+      frame=room->state;
+    }
+    server.subscribe(c, frame, room->id);
+    return true;
+  });
+  server.route("GET", "/state", LANE_NORMAL, [](int c, const HttpRequest& req){
+    auto room=find_room(host, c, req); return room && handle_state(*room, c, req); });
+  server.route("GET", "/moves", LANE_NORMAL, [](int c, const HttpRequest& req){
+    auto room=find_room(host, c, req); return room && handle_moves(*room, c, req); });
+  server.route("POST", "/move", LANE_NORMAL, [](int c, const HttpRequest& req){
+    auto room=find_room(host, c, req); return room && handle_move(server, host, users, archive, analyzer, engines, sessions, *room, c, req); });
+  for(const char* path : {"/undo", "/redo", "/jump"})
+    server.route("POST", path, LANE_NORMAL, [](int c, const HttpRequest& req){
+      auto room=find_room(host, c, req); return room && handle_navigate(server, host, engines, sessions, *room, c, req); });
+  server.route("GET", "/engine", LANE_ENGINE, [](int c, const HttpRequest& req){
+    auto room=find_room(host, c, req); return room && handle_engine(*room, c, req); });
+  server.route("POST", "/api/engine-game", LANE_NORMAL, [](int c, const HttpRequest& req){ return handle_engine_game(host, engines, sessions, c, req); });
+  server.route("POST", "/api/queue", LANE_NORMAL, [](int c, const HttpRequest& req){ return handle_queue_join(lobby, users, sessions, c, req); });
+  server.route("POST", "/api/queue/leave", LANE_NORMAL, [](int c, const HttpRequest& req){ return handle_queue_leave(lobby, sessions, c, req); });
+  server.route("GET", "/api/queue", LANE_NORMAL, [](int c, const HttpRequest& req){ return handle_queue_poll(lobby, sessions, c, req); });
+  server.route("POST", "/api/signup", LANE_NORMAL, [](int c, const HttpRequest& req){ return handle_signup(users, c, req); });
+  server.route("POST", "/api/login", LANE_NORMAL, [](int c, const HttpRequest& req){ return handle_login(users, sessions, c, req); });
+  server.route("POST", "/api/logout", LANE_NORMAL, [](int c, const HttpRequest& req){ return handle_logout(sessions, c, req); });
+  server.route("GET", "/api/me", LANE_NORMAL, [](int c, const HttpRequest& req){
+    std::string user=session_user(sessions, req);
+    if(user.empty()) send_json(c, "401 Unauthorized", "{\"user\":null}");
+    else send_json(c, "200 OK", "{\"user\":"+json_string(user)+"}");
+    return false;
+  });
+  server.route("GET", "/api/profile", LANE_NORMAL, [](int c, const HttpRequest& req){ return handle_profile(users, sessions, c, req); });
+  server.route("GET", "/api/leaderboard", LANE_NORMAL, [](int c, const HttpRequest& req){ return handle_leaderboard(users, c, req); });
+  server.route("GET", "/api/games", LANE_NORMAL, [](int c, const HttpRequest& req){ return handle_games(archive, c, req); });
+  server.route("GET", "/api/game", LANE_NORMAL, [](int c, const HttpRequest& req){ return handle_game(archive, c, req); });
+  server.route("GET", "/analysis/*", LANE_NORMAL, [](int c, const HttpRequest& req){ return handle_analysis(analyzer, archive, c, req); });
+  server.route("GET", "/api/puzzle", LANE_NORMAL, [](int c, const HttpRequest& req){ return handle_puzzle(puzzles, c, req); });
+  server.route("POST", "/api/puzzle/move", LANE_NORMAL, [](int c, const HttpRequest& req){ return handle_puzzle_move(puzzles, c, req); });
+  server.route("GET", "/metrics", LANE_NORMAL, handle_metrics);
+  if(trace::ENABLED)
+    server.route("GET", "/debug/trace", LANE_NORMAL, handle_trace);
+  server.fallback([](int c, const HttpRequest& req){
+    bool head = (req.method=="HEAD");
+    if((req.method=="GET" || head) && assets.has(req.path))
+      assets.serve(c, req.path, head, req.header("Accept-Encoding"), req.header("If-None-Match"));
+    else
+      safe_send(c, "HTTP/1.1 404 Not Found\r\nConnection: close\r\n\r\nNot Found");
+    return false;
+  });
 
-  return 0;
+  if(shards>1) logLine("Shard %d of %d\n", config.shard, shards);
+  logLine("Web GUI on http://localhost:%d  (ssh -L %d:localhost:%d <you>@<host>)\n",
+          config.port, config.port, config.port);
+  return server.run();
 }